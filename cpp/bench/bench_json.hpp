@@ -0,0 +1,149 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <utility>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <stdexcept>
+
+namespace v3d::bench {
+
+// Just enough JSON for benchmark reports: a writer that emits values as they come, and a
+// reader into a small tree (objects keep their key order; numbers are doubles).
+struct Json {
+    enum class Kind { Null, Bool, Number, String, Array, Object } kind = Kind::Null;
+    bool b = false;
+    double num = 0.0;
+    std::string str;
+    std::vector<Json> items;                          // Array
+    std::vector<std::pair<std::string, Json>> fields; // Object
+
+    const Json* find(const std::string& key) const {
+        for(const auto& f : fields) if(f.first == key) return &f.second;
+        return nullptr;
+    }
+    double number(const std::string& key, double fallback = 0.0) const {
+        const Json* v = find(key);
+        return v && v->kind == Kind::Number ? v->num : fallback;
+    }
+    std::string string(const std::string& key) const {
+        const Json* v = find(key);
+        return v && v->kind == Kind::String ? v->str : std::string();
+    }
+};
+
+inline void json_skip_ws(const char*& p, const char* e){ while(p < e && std::isspace((unsigned char)*p)) ++p; }
+
+inline std::string json_parse_string(const char*& p, const char* e){
+    if(p >= e || *p != '"') throw std::runtime_error("JSON: expected string");
+    std::string s;
+    for(++p; p < e && *p != '"'; ++p){
+        if(*p != '\\'){ s += *p; continue; }
+        if(++p >= e) break;
+        switch(*p){
+        case 'n': s += '\n'; break;
+        case 't': s += '\t'; break;
+        case 'u': p += 4; s += '?'; break;   // reports are ASCII
+        default: s += *p;
+        }
+    }
+    if(p >= e) throw std::runtime_error("JSON: unterminated string");
+    ++p;
+    return s;
+}
+
+inline Json json_parse_value(const char*& p, const char* e){
+    json_skip_ws(p, e);
+    if(p >= e) throw std::runtime_error("JSON: unexpected end");
+    Json v;
+    auto literal = [&](const char* word){
+        for(const char* w = word; *w; ++w, ++p) if(p >= e || *p != *w) throw std::runtime_error("JSON: bad literal");
+    };
+    if(*p == '{'){
+        v.kind = Json::Kind::Object; ++p;
+        json_skip_ws(p, e);
+        if(p < e && *p == '}'){ ++p; return v; }
+        for(;;){
+            json_skip_ws(p, e);
+            std::string key = json_parse_string(p, e);
+            json_skip_ws(p, e);
+            if(p >= e || *p != ':') throw std::runtime_error("JSON: expected ':'");
+            ++p;
+            v.fields.emplace_back(std::move(key), json_parse_value(p, e));
+            json_skip_ws(p, e);
+            if(p < e && *p == ','){ ++p; continue; }
+            if(p < e && *p == '}'){ ++p; return v; }
+            throw std::runtime_error("JSON: expected ',' or '}'");
+        }
+    }
+    if(*p == '['){
+        v.kind = Json::Kind::Array; ++p;
+        json_skip_ws(p, e);
+        if(p < e && *p == ']'){ ++p; return v; }
+        for(;;){
+            v.items.push_back(json_parse_value(p, e));
+            json_skip_ws(p, e);
+            if(p < e && *p == ','){ ++p; continue; }
+            if(p < e && *p == ']'){ ++p; return v; }
+            throw std::runtime_error("JSON: expected ',' or ']'");
+        }
+    }
+    if(*p == '"'){ v.kind = Json::Kind::String; v.str = json_parse_string(p, e); return v; }
+    if(*p == 't'){ literal("true"); v.kind = Json::Kind::Bool; v.b = true; return v; }
+    if(*p == 'f'){ literal("false"); v.kind = Json::Kind::Bool; return v; }
+    if(*p == 'n'){ literal("null"); return v; }
+    char* end = nullptr;
+    const std::string tail(p, (size_t)std::min<std::ptrdiff_t>(e - p, 64));
+    v.num = std::strtod(tail.c_str(), &end);
+    if(end == tail.c_str()) throw std::runtime_error("JSON: unexpected character");
+    v.kind = Json::Kind::Number;
+    p += end - tail.c_str();
+    return v;
+}
+
+inline Json parse_json(const std::string& text){
+    const char* p = text.data();
+    const char* e = p + text.size();
+    Json v = json_parse_value(p, e);
+    json_skip_ws(p, e);
+    if(p != e) throw std::runtime_error("JSON: trailing characters");
+    return v;
+}
+
+inline Json read_json_file(const std::string& path){
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if(!f) throw std::runtime_error("cannot open " + path);
+    std::string text;
+    char buf[1 << 16];
+    for(size_t n; (n = std::fread(buf, 1, sizeof buf, f)) > 0; ) text.append(buf, n);
+    std::fclose(f);
+    return parse_json(text);
+}
+
+// Streaming writer; commas and indentation follow the nesting
+struct JsonWriter {
+    std::string out;
+    std::vector<bool> first{true};
+
+    void sep(){ if(!first.back()) out += ','; first.back() = false; out += '\n'; out.append(2*(first.size()-1), ' '); }
+    void key(const char* k){ sep(); out += '"'; out += k; out += "\": "; first.back() = true; pending_ = true; }
+    void open(char c){ item(); out += c; first.push_back(true); }
+    void close(char c){ const bool empty = first.back(); first.pop_back(); if(!empty){ out += '\n'; out.append(2*(first.size()-1), ' '); } out += c; }
+    void begin_object(){ open('{'); }
+    void end_object(){ close('}'); }
+    void begin_array(){ open('['); }
+    void end_array(){ close(']'); }
+    void value(double x){ item(); char b[32]; std::snprintf(b, sizeof b, "%.6g", x); out += std::isfinite(x) ? b : "null"; }
+    void value(long long x){ item(); out += std::to_string(x); }
+    void value(const std::string& s){ item(); out += '"'; for(char c : s){ if(c == '"' || c == '\\') out += '\\'; out += c; } out += '"'; }
+    template<class T> void field(const char* k, const T& v){ key(k); value(v); }
+
+private:
+    bool pending_ = false;   // a key was just written: the value follows it on the same line
+    void item(){ if(pending_){ pending_ = false; first.back() = false; return; } if(first.size() > 1) sep(); }
+};
+
+} // namespace v3d::bench
@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <string>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "../core/vec.hpp"
+#include "../core/lattice.hpp"
+#include "../containers/box_container.hpp"
+#include "../containers/triclinic_pbc.hpp"
+
+namespace v3d::bench {
+
+// Synthetic atom sets for the benchmarks, at unit nearest-neighbor distance:
+//  - FCC, BCC: crystals with 1% thermal jitter (perfect lattices are all degenerate vertices);
+//  - Liquid: simple cubic sites displaced by up to ±0.4 spacing (disordered, no close pairs);
+//  - Slab: the liquid in the middle third of the cell along c (vacuum above and below).
+// The box cell has walls on all sides; the triclinic cell is skewed and periodic (a, b only
+// for the slab).
+enum class Structure { FCC, BCC, Liquid, Slab };
+enum class CellShape { Box, Triclinic };
+
+inline const char* structure_name(Structure s){
+    switch(s){
+    case Structure::FCC: return "fcc";
+    case Structure::BCC: return "bcc";
+    case Structure::Liquid: return "liquid";
+    case Structure::Slab: return "slab";
+    }
+    return "?";
+}
+inline const char* cell_name(CellShape c){ return c == CellShape::Box ? "box" : "triclinic"; }
+
+inline Structure parse_structure(const std::string& s){
+    if(s == "fcc") return Structure::FCC;
+    if(s == "bcc") return Structure::BCC;
+    if(s == "liquid") return Structure::Liquid;
+    if(s == "slab") return Structure::Slab;
+    throw std::runtime_error("unknown structure " + s + " (fcc, bcc, liquid, slab)");
+}
+inline CellShape parse_cell(const std::string& s){
+    if(s == "box") return CellShape::Box;
+    if(s == "triclinic") return CellShape::Triclinic;
+    throw std::runtime_error("unknown cell " + s + " (box, triclinic)");
+}
+
+struct SyntheticSystem {
+    Structure structure = Structure::FCC;
+    CellShape cell = CellShape::Box;
+    std::vector<Vec3> pos;
+    BoxBounds bounds{};                          // box cell
+    Lattice lattice{1, 1, 1, 90, 90, 90};        // triclinic cell
+    std::array<bool,3> periodic{true, true, true};
+
+    size_t size() const { return pos.size(); }
+    BoxContainer box() const { BoxContainer B(bounds); B.add_atoms(pos); return B; }
+    TriclinicPBC pbc() const { TriclinicPBC P(lattice, periodic); P.add_atoms(pos); return P; }
+};
+
+// About `atoms` atoms (the nearest whole number of unit cells per side)
+inline SyntheticSystem make_system(Structure s, CellShape c, size_t atoms, uint64_t seed = 1){
+    std::vector<Vec3> basis;
+    double spacing = 1.0, jitter = 0.01;   // unit-cell edge, displacement (in nn distances)
+    switch(s){
+    // sites sit at least a quarter spacing inside the unit cell, so box walls do not touch them
+    case Structure::FCC: basis = {{0.25,0.25,0.25}, {0.25,0.75,0.75}, {0.75,0.25,0.75}, {0.75,0.75,0.25}}; spacing = std::sqrt(2.0); break;
+    case Structure::BCC: basis = {{0.25,0.25,0.25}, {0.75,0.75,0.75}}; spacing = 2.0 / std::sqrt(3.0); break;
+    case Structure::Liquid: case Structure::Slab: basis = {{0.5,0.5,0.5}}; jitter = 0.4; break;
+    }
+    const bool slab = s == Structure::Slab;
+    // slabs are four times wider than thick
+    const double per_side = slab ? std::cbrt(4.0 * (double)atoms / (double)basis.size()) : std::cbrt((double)atoms / (double)basis.size());
+    const int n = std::max(1, (int)std::lround(per_side));
+    const int nz = slab ? std::max(1, (int)std::lround((double)atoms / (double)basis.size() / ((double)n*n))) : n;
+    const double zspan = slab ? 3.0 : 1.0;   // cell height in units of the atom layer height
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> U(-1.0, 1.0);
+    SyntheticSystem S;
+    S.structure = s; S.cell = c;
+    const double L = n * spacing, Lz = nz * spacing * zspan;
+    std::vector<Vec3> frac;
+    frac.reserve((size_t)n*n*nz*basis.size());
+    for(int x=0; x<n; ++x) for(int y=0; y<n; ++y) for(int z=0; z<nz; ++z) for(const Vec3& b : basis){
+        const double dx = jitter / spacing;
+        Vec3 f{ (x + b.x + dx*U(rng)) / n, (y + b.y + dx*U(rng)) / n, (z + b.z + dx*U(rng)) / nz };
+        if(slab) f.z = (1.0 + f.z) / zspan;
+        frac.push_back(f);
+    }
+    if(c == CellShape::Box){
+        S.bounds = BoxBounds{ Vec3{0,0,0}, Vec3{L, L, Lz} };
+        for(Vec3 f : frac){
+            for(int k=0; k<3; ++k) f[k] = std::clamp(f[k], 0.0, 1.0);
+            S.pos.push_back(Vec3{ f.x*L, f.y*L, f.z*Lz });
+        }
+    } else {
+        S.lattice = Lattice(L, L, Lz, 80.0, 95.0, 105.0);
+        S.periodic = { true, true, !slab };
+        for(const Vec3& f : frac) S.pos.push_back(S.lattice.A * f);
+    }
+    return S;
+}
+
+} // namespace v3d::bench
@@ -0,0 +1,402 @@
+// voronoi3d_bench: times the hot paths separately on synthetic systems and writes a JSON report.
+//
+//   voronoi3d_bench [--systems fcc,bcc,liquid,slab] [--cells box,triclinic]
+//                   [--sizes 1000,10000,100000] [--stages plan_neighbors,...] [--repeat 3]
+//                   [--threads 0] [--min-M 0.25] [--out report.json]
+//                   [--compare baseline.json [--input report.json] [--tolerance 0.10]]
+//
+// Every stage reports its best time over --repeat runs as ns per atom, with planes per cell
+// (rows per atom for the planners) and the peak RSS of each case; tessellate_pairs also reports
+// the heap allocations per cell of a warm run (counted by the operator new below). --compare checks ns/atom of
+// every stage against a saved report (the current run, or --input) and exits with status 1 if
+// any grew by more than --tolerance.
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <atomic>
+#include <new>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#elif !defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+#include "../core/config.hpp"
+#include "../core/neighbor.hpp"
+#include "../core/tessellate.hpp"
+#include "../core/tessellate_caps.hpp"
+#include "../core/tessellate_stream.hpp"
+#include "../core/mesh_builder.hpp"
+#include "../core/plane_kernels.hpp"
+#include "../core/profiling.hpp"
+#include "synthetic.hpp"
+#include "bench_json.hpp"
+
+using namespace v3d;
+using namespace v3d::bench;
+
+// Every allocation of the process is counted, so stages can report allocations per cell
+static std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(std::size_t n){
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"   // free() pairs with the malloc() above
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+const char* const kStages[] = {
+    "plan_neighbors", "plan_neighbors_half", "tessellate_pairs", "tessellate_pairs_half",
+    "tessellate_pairs_chunked", "tessellate_pairs_with_caps", "halfspace_intersection",
+    "stitch_global", "stitch_global_topological",
+};
+
+struct Options {
+    std::vector<Structure> systems{Structure::FCC, Structure::BCC, Structure::Liquid, Structure::Slab};
+    std::vector<CellShape> cells{CellShape::Box, CellShape::Triclinic};
+    std::vector<size_t> sizes{1000, 10000, 100000};
+    std::vector<std::string> stages{std::begin(kStages), std::end(kStages)};
+    int repeat = 3;
+    int threads = 0;
+    double min_M = 0.25;
+    double tolerance = 0.10;
+    std::string out, compare, input;
+};
+
+std::vector<std::string> split_list(const std::string& s){
+    std::vector<std::string> v;
+    for(size_t a = 0; a <= s.size(); ){
+        const size_t b = std::min(s.find(',', a), s.size());
+        if(b > a) v.push_back(s.substr(a, b - a));
+        a = b + 1;
+    }
+    return v;
+}
+
+Options parse_options(int argc, char** argv){
+    Options o;
+    for(int k=1; k<argc; ++k){
+        const std::string a = argv[k];
+        auto next = [&]() -> std::string {
+            if(k+1 >= argc) throw std::runtime_error(a + " needs a value");
+            return argv[++k];
+        };
+        if(a == "--systems"){ o.systems.clear(); for(const auto& s : split_list(next())) o.systems.push_back(parse_structure(s)); }
+        else if(a == "--cells"){ o.cells.clear(); for(const auto& s : split_list(next())) o.cells.push_back(parse_cell(s)); }
+        else if(a == "--sizes"){ o.sizes.clear(); for(const auto& s : split_list(next())) o.sizes.push_back((size_t)std::stod(s)); }
+        else if(a == "--stages"){
+            o.stages = split_list(next());
+            for(const auto& s : o.stages)
+                if(std::find(std::begin(kStages), std::end(kStages), s) == std::end(kStages)) throw std::runtime_error("unknown stage " + s);
+        }
+        else if(a == "--repeat") o.repeat = std::max(1, std::stoi(next()));
+        else if(a == "--threads") o.threads = std::stoi(next());
+        else if(a == "--min-M") o.min_M = std::stod(next());
+        else if(a == "--tolerance") o.tolerance = std::stod(next());
+        else if(a == "--out") o.out = next();
+        else if(a == "--compare") o.compare = next();
+        else if(a == "--input") o.input = next();
+        else if(a == "--help" || a == "-h"){
+            std::printf("usage: voronoi3d_bench [--systems fcc,bcc,liquid,slab] [--cells box,triclinic] [--sizes N,...]\n"
+                        "                       [--stages name,...] [--repeat R] [--threads T] [--min-M m] [--out FILE]\n"
+                        "                       [--compare BASELINE [--input FILE] [--tolerance 0.10]]\nstages:");
+            for(const char* s : kStages) std::printf(" %s", s);
+            std::printf("\n");
+            std::exit(0);
+        }
+        else throw std::runtime_error("unknown option " + a);
+    }
+    return o;
+}
+
+// Peak resident set size of the process in MiB. On Linux the peak is reset per case.
+void reset_peak_rss(){
+#if defined(__linux__)
+    if(std::FILE* f = std::fopen("/proc/self/clear_refs", "w")){ std::fputs("5", f); std::fclose(f); }
+#endif
+}
+
+double peak_rss_mb(){
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof pmc)) return (double)pmc.PeakWorkingSetSize / 1048576.0;
+    return 0.0;
+#elif defined(__linux__)
+    double kb = 0.0;
+    if(std::FILE* f = std::fopen("/proc/self/status", "r")){
+        char line[256];
+        while(std::fgets(line, sizeof line, f)) if(std::sscanf(line, "VmHWM: %lf kB", &kb) == 1) break;
+        std::fclose(f);
+    }
+    return kb / 1024.0;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (double)ru.ru_maxrss / 1048576.0;   // bytes on macOS
+#endif
+}
+
+// Best wall time of `repeat` runs, in seconds
+double best_of(int repeat, const std::function<void()>& run){
+    double best = 1e300;
+    for(int r=0; r<repeat; ++r){
+        const auto t0 = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+struct StageResult { std::string name; double seconds = 0, ns_per_atom = 0, planes_per_cell = 0, rows_per_atom = 0, allocs_per_cell = -1; };
+
+double mean_rows_used(const std::vector<CellResult>& cells){
+    double s = 0;
+    for(const auto& c : cells) s += c.rows_used;
+    return cells.empty() ? 0.0 : s / (double)cells.size();
+}
+
+// All stages of one container (BoxContainer or TriclinicPBC)
+template<class Container>
+std::vector<StageResult> run_case(const Container& c, const Options& o, const Config& cfg){
+    constexpr bool is_box = std::is_same_v<Container, BoxContainer>;
+    const size_t N = c.pos.size();
+    auto wanted = [&](const char* s){ return std::find(o.stages.begin(), o.stages.end(), s) != o.stages.end(); };
+    std::vector<StageResult> out;
+    auto record = [&](const char* name, double sec){
+        StageResult r; r.name = name; r.seconds = sec; r.ns_per_atom = sec * 1e9 / (double)std::max<size_t>(N, 1);
+        out.push_back(r);
+        std::fprintf(stderr, "  %-28s %10.1f ns/atom\n", name, r.ns_per_atom);
+        return &out.back();
+    };
+
+    // the full table and its cells feed the later stages, so they are always built
+    NeighborTable T;
+    const double t_plan = best_of(o.repeat, [&]{ T = plan_neighbors(c, cfg); });
+    if(wanted("plan_neighbors")) record("plan_neighbors", t_plan)->rows_per_atom = (double)T.size() / (double)N;
+    const std::vector<double> M(T.size(), 0.5);
+    std::vector<CellResult> cells;
+    const double t_tess = best_of(o.repeat, [&]{ cells = tessellate_pairs(c, T, M, cfg); });
+    if(wanted("plan_neighbors_half")){
+        HalfNeighborTable H;
+        const double t = best_of(o.repeat, [&]{ H = plan_neighbors<HalfNeighborTable>(c, cfg); });
+        record("plan_neighbors_half", t)->rows_per_atom = (double)H.size() / (double)N;
+        if(wanted("tessellate_pairs_half")){
+            const std::vector<double> Mh(H.size(), 0.5);
+            std::vector<CellResult> hc;
+            const double th = best_of(o.repeat, [&]{ hc = tessellate_pairs(c, H, Mh, cfg); });
+            record("tessellate_pairs_half", th)->planes_per_cell = mean_rows_used(hc);
+        }
+    }
+    if(wanted("tessellate_pairs")){
+        StageResult* r = record("tessellate_pairs", t_tess);
+        r->planes_per_cell = mean_rows_used(cells);
+        // the workspaces are warm by now: what is left is the copy of each result (see take_cell)
+        cells.clear();
+        const uint64_t a0 = g_allocations.load();
+        cells = tessellate_pairs(c, T, M, cfg);
+        r->allocs_per_cell = (double)(g_allocations.load() - a0) / (double)std::max<size_t>(N, 1);
+        std::fprintf(stderr, "  %-28s %10.2f allocations/cell\n", "", r->allocs_per_cell);
+    }
+    if(wanted("tessellate_pairs_chunked")){
+        double used = 0;
+        const double t = best_of(o.repeat, [&]{
+            used = 0;
+            tessellate_pairs_chunked(c, T, M, cfg, 4096, [&](std::vector<CellResult>& chunk){ for(const auto& x : chunk) used += x.rows_used; });
+        });
+        record("tessellate_pairs_chunked", t)->planes_per_cell = used / (double)N;
+    }
+    if constexpr (is_box){
+        if(wanted("tessellate_pairs_with_caps")){
+            CapOptions opt;
+            opt.enabled = true; opt.radius = 1.0; opt.auto_surface_margin = 1.0;
+            std::vector<CellResult> cc;
+            const double t = best_of(o.repeat, [&]{ cc = tessellate_pairs_with_caps(c, T, M, opt, cfg); });
+            record("tessellate_pairs_with_caps", t)->planes_per_cell = mean_rows_used(cc);
+        }
+    }
+    if(wanted("halfspace_intersection")){
+        // seed planes plus the nearest planes clipping used (at most kMaxPlanes: the reference
+        // intersection is quartic in the plane count), for up to 64 cells spread over the system
+        constexpr int kMaxPlanes = 48;
+        const size_t stride = std::max<size_t>(1, N / 64);
+        std::vector<std::vector<PlaneWithTag>> lists;
+        const AtomRows A = atom_rows(T, N);
+        std::vector<int> rows;
+        double planes = 0;
+        for(size_t i=0; i<N; i+=stride){
+            rows_nearest_first(T, A, (int)i, rows);
+            std::vector<PlaneWithTag> L;
+            if constexpr (is_box) seed_planes(box_seed(c.bounds), L);
+            else seed_planes(pbc_seed(c, (int)i, rows.empty() ? 0.0 : std::sqrt(T.r2[(size_t)rows.back()])), L);
+            for(int k=0; k<cells[i].rows_used && k<(int)rows.size() && (int)L.size()<kMaxPlanes; ++k){
+                PlaneWithTag H; double reach;
+                if(neighbor_plane(c.pos[i], T, M, rows[(size_t)k], cfg, H, reach)) L.push_back(H);
+            }
+            planes += (double)L.size();
+            lists.push_back(std::move(L));
+        }
+        Polyhedron P; HalfspaceScratch S;
+        const double t = best_of(o.repeat, [&]{ for(const auto& L : lists) halfspace_intersection(L, cfg, P, S); });
+        StageResult* r = record("halfspace_intersection", t * (double)N / (double)lists.size());   // per cell
+        r->planes_per_cell = planes / (double)lists.size();
+    }
+    for(const char* name : {"stitch_global", "stitch_global_topological"}){
+        if(!wanted(name)) continue;
+        Config sc = cfg;
+        sc.stitch_mode = std::string(name) == "stitch_global" ? StitchMode::Geometric : StitchMode::Topological;
+        std::vector<Polyhedron> polys; std::vector<int> ids; std::vector<double> vols; std::vector<Vec3> cents;
+        for(const auto& x : cells){ polys.push_back(x.poly); ids.push_back(x.atom_id); vols.push_back(x.volume); cents.push_back(x.centroid); }
+        GlobalMesh G;
+        const double t = best_of(o.repeat, [&]{ G = stitch_global(T, polys, ids, vols, cents, c.pos, sc); });
+        double faces = 0;
+        for(const auto& gc : G.cells) faces += (double)gc.face_ids.size();
+        record(name, t)->planes_per_cell = G.cells.empty() ? 0.0 : faces / (double)G.cells.size();   // faces per cell
+    }
+    auto rank = [](const StageResult& r){ return std::find(std::begin(kStages), std::end(kStages), r.name) - std::begin(kStages); };
+    std::stable_sort(out.begin(), out.end(), [&](const StageResult& a, const StageResult& b){ return rank(a) < rank(b); });
+    return out;
+}
+
+void write_stage(JsonWriter& w, const StageResult& r){
+    w.begin_object();
+    w.field("stage", r.name);
+    w.field("seconds", r.seconds);
+    w.field("ns_per_atom", r.ns_per_atom);
+    if(r.planes_per_cell > 0) w.field("planes_per_cell", r.planes_per_cell);
+    if(r.rows_per_atom > 0) w.field("rows_per_atom", r.rows_per_atom);
+    if(r.allocs_per_cell >= 0) w.field("allocs_per_cell", r.allocs_per_cell);
+    w.end_object();
+}
+
+std::string run_benchmarks(const Options& o){
+    Config cfg;
+    cfg.min_M = o.min_M;
+    cfg.num_threads = o.threads;
+    JsonWriter w;
+    w.begin_object();
+    w.field("format", std::string("voronoi3d_bench/1"));
+    w.field("threads", (long long)o.threads);
+    w.field("min_M", o.min_M);
+    w.field("repeat", (long long)o.repeat);
+    w.field("simd_lanes", (long long)kPlaneLanes);
+#ifdef V3D_OPENMP
+    w.field("openmp", 1LL);
+#else
+    w.field("openmp", 0LL);
+#endif
+    w.key("cases");
+    w.begin_array();
+    for(Structure s : o.systems) for(CellShape cs : o.cells) for(size_t n : o.sizes){
+        const SyntheticSystem sys = make_system(s, cs, n);
+        std::fprintf(stderr, "%s/%s N=%zu\n", structure_name(s), cell_name(cs), sys.size());
+        reset_peak_rss();
+#ifdef V3D_PROFILE
+        const ProfileStats before = profile_snapshot();
+#endif
+        const std::vector<StageResult> stages = cs == CellShape::Box ? run_case(sys.box(), o, cfg) : run_case(sys.pbc(), o, cfg);
+        w.begin_object();
+        w.field("system", std::string(structure_name(s)));
+        w.field("cell", std::string(cell_name(cs)));
+        w.field("atoms", (long long)sys.size());
+        w.field("peak_rss_mb", peak_rss_mb());
+        w.key("stages");
+        w.begin_array();
+        for(const auto& r : stages) write_stage(w, r);
+        w.end_array();
+#ifdef V3D_PROFILE
+        // phase totals over all stages and repeats of the case
+        const ProfileStats after = profile_snapshot();
+        w.key("profile");
+        w.begin_object();
+        for(size_t k=0; k<kProfilePhases; ++k) w.field(profile_phase_name((ProfilePhase)k), after.seconds[k] - before.seconds[k]);
+        for(size_t k=0; k<kProfileCounters; ++k) w.field(profile_counter_name((ProfileCounter)k), (long long)(after.counts[k] - before.counts[k]));
+        w.end_object();
+#endif
+        w.end_object();
+    }
+    w.end_array();
+    w.end_object();
+    w.out += '\n';
+    return w.out;
+}
+
+// Stages of `cur` whose ns/atom exceeds the baseline's by more than `tol`; cases are matched by
+// system, cell and atom count, stages by name. Returns the number of regressions.
+int compare_reports(const Json& base, const Json& cur, double tol){
+    const Json* bc = base.find("cases");
+    const Json* cc = cur.find("cases");
+    if(!bc || !cc) throw std::runtime_error("not a voronoi3d_bench report");
+    int regressions = 0, compared = 0;
+    for(const Json& c : cc->items){
+        const Json* match = nullptr;
+        for(const Json& b : bc->items)
+            if(b.string("system") == c.string("system") && b.string("cell") == c.string("cell") && b.number("atoms") == c.number("atoms")) match = &b;
+        if(!match) continue;
+        const Json* bs = match->find("stages");
+        const Json* cs = c.find("stages");
+        if(!bs || !cs) continue;
+        for(const Json& st : cs->items){
+            for(const Json& bt : bs->items){
+                if(bt.string("stage") != st.string("stage")) continue;
+                const double before = bt.number("ns_per_atom"), after = st.number("ns_per_atom");
+                if(before <= 0) continue;
+                const double change = after / before - 1.0;
+                const bool bad = change > tol;
+                regressions += bad; ++compared;
+                std::printf("%-8s %-10s %8.0f %-28s %10.1f -> %10.1f ns/atom %+6.1f%%%s\n",
+                            c.string("system").c_str(), c.string("cell").c_str(), c.number("atoms"), st.string("stage").c_str(),
+                            before, after, 100.0 * change, bad ? "  REGRESSION" : "");
+            }
+        }
+        const double rb = match->number("peak_rss_mb"), ra = c.number("peak_rss_mb");
+        if(rb > 0 && ra > 0)
+            std::printf("%-8s %-10s %8.0f %-28s %10.1f -> %10.1f MiB\n", c.string("system").c_str(), c.string("cell").c_str(),
+                        c.number("atoms"), "peak_rss", rb, ra);
+    }
+    std::printf("%d of %d stages regressed by more than %.0f%%\n", regressions, compared, 100.0 * tol);
+    return regressions;
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    try {
+        const Options o = parse_options(argc, argv);
+        std::string report;
+        if(o.input.empty()){
+            report = run_benchmarks(o);
+            if(!o.out.empty()){
+                std::FILE* f = std::fopen(o.out.c_str(), "wb");
+                if(!f) throw std::runtime_error("cannot write " + o.out);
+                std::fwrite(report.data(), 1, report.size(), f);
+                std::fclose(f);
+            } else if(o.compare.empty()){
+                std::fwrite(report.data(), 1, report.size(), stdout);
+            }
+        }
+        if(o.compare.empty()) return 0;
+        const Json base = read_json_file(o.compare);
+        const Json cur = o.input.empty() ? parse_json(report) : read_json_file(o.input);
+        return compare_reports(base, cur, o.tolerance) > 0 ? 1 : 0;
+    } catch(const std::exception& e){
+        std::fprintf(stderr, "voronoi3d_bench: %s\n", e.what());
+        return 2;
+    }
+}
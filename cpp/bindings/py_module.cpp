@@ -2,16 +2,28 @@
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 
+#include <cstring>
+#include <string>
+
 #include "../core/config.hpp"
 #include "../core/vec.hpp"
 #include "../core/lattice.hpp"
 #include "../containers/box_container.hpp"
 #include "../containers/triclinic_pbc.hpp"
 #include "../core/neighbor.hpp"
+#include "../core/neighbor_planner.hpp"
 #include "../core/polyhedron.hpp"
 #include "../core/tessellate.hpp"
 #include "../core/mesh_builder.hpp"
 #include "../core/tessellate_caps.hpp"
+#include "../core/tessellation_result.hpp"
+#include "../core/tessellate_stream.hpp"
+#include "../core/incremental.hpp"
+#include "../core/batch.hpp"
+#include "../core/profiling.hpp"
+#include "../io/trajectory_reader.hpp"
+#include "../io/mesh_file.hpp"
+#include <functional>
 
 namespace py = pybind11;
 using namespace v3d;
@@ -25,7 +37,315 @@ static py::array_t<double> vec3_list_to_numpy(const std::vector<Vec3>& V){
     return arr;
 }
 
+// Read-only NumPy view of a contiguous column owned by `owner` (kept alive as the array base)
+template<class Scalar>
+static py::array column_view(const Scalar* data, size_t rows, size_t cols, py::handle owner){
+    std::vector<py::ssize_t> shape{(py::ssize_t)rows}, strides{(py::ssize_t)(sizeof(Scalar)*cols)};
+    if(cols > 1){ shape.push_back((py::ssize_t)cols); strides.push_back((py::ssize_t)sizeof(Scalar)); }
+    py::array arr(py::dtype::of<Scalar>(), shape, strides, data, owner);
+    py::detail::array_proxy(arr.ptr())->flags &= ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+    return arr;
+}
+
+static_assert(sizeof(Vec3) == 3*sizeof(double), "Vec3 must be three packed doubles");
+static_assert(sizeof(Vec3f) == 3*sizeof(float), "Vec3f must be three packed floats");
+static_assert(sizeof(std::array<int32_t,3>) == 3*sizeof(int32_t), "image triples must be packed");
+
+template<class Scalar>
+using CArray = py::array_t<Scalar, py::array::c_style | py::array::forcecast>;
+
+// Bulk-copy a C-contiguous (rows x cols) array into a vector of packed records
+template<class Rec, class Scalar>
+static void copy_column(std::vector<Rec>& dst, const CArray<Scalar>& src, size_t rows, size_t cols, const char* name){
+    const bool ok = cols == 1 ? (src.ndim()==1 && (size_t)src.shape(0)==rows)
+                              : (src.ndim()==2 && (size_t)src.shape(0)==rows && (size_t)src.shape(1)==cols);
+    if(!ok) throw std::runtime_error(std::string(name) + (cols == 1 ? " must have shape (E,)" : " must have shape (E," + std::to_string(cols) + ")"));
+    dst.resize(rows);
+    if(rows) std::memcpy((void*)dst.data(), src.data(), rows*cols*sizeof(Scalar));
+}
+
+// Python iterator over spatially ordered chunks of a tessellation (see tessellate_pairs_chunked).
+// `build` owns copies of M, the config and the row index; the container and table are kept
+// alive by the Python object.
+struct TessellationStream {
+    std::function<void(const int32_t*, size_t, std::vector<CellResult>&)> build;
+    std::vector<int32_t> order;
+    size_t chunk_size = 1, next = 0;
+    std::vector<CellResult> cells;
+
+    size_t num_chunks() const { return (order.size() + chunk_size - 1) / chunk_size; }
+};
+
+template<class Container>
+static TessellationStream make_stream(const Container& c, const NeighborTable& T, std::vector<double> M,
+                                      const Config& cfg, size_t chunk_size){
+    TessellationStream S;
+    S.order = morton_order(c.pos);
+    S.chunk_size = std::max<size_t>(chunk_size, 1);
+    S.build = [&c, &T, M = std::move(M), cfg, A = atom_rows(T, c.pos.size())](const int32_t* ids, size_t n, std::vector<CellResult>& out){
+        tessellate_atoms(c, T, A, M, cfg, ids, n, out);
+    };
+    return S;
+}
+
+// Tessellate and stitch into one global mesh (no GIL needed)
+template<class Container, class Table>
+static GlobalMesh global_mesh_of(const Container& c, const Table& T, const std::vector<double>& M, const Config& cfg){
+    auto cells = tessellate_pairs(c, T, M, cfg);
+    std::vector<Polyhedron> polys; polys.reserve(cells.size());
+    std::vector<int> atom_ids; atom_ids.reserve(cells.size());
+    std::vector<double> vols; vols.reserve(cells.size());
+    std::vector<Vec3> cents; cents.reserve(cells.size());
+    for(auto& c : cells){ polys.push_back(std::move(c.poly)); atom_ids.push_back(c.atom_id); vols.push_back(c.volume); cents.push_back(c.centroid); }
+    return stitch_global(T, polys, atom_ids, vols, cents, c.pos, cfg);
+}
+
+// Table and result classes for one storage precision (double: NeighborTable / TessellationResult,
+// float: the F32 variants); float columns come out as float32 views. Half tables (one row per
+// pair) have no rev column.
+template<class Real, bool Half = false>
+static void bind_neighbor_table(py::module_& m, const char* name){
+    using Table = BasicNeighborTable<Real, Half>;
+    auto cls = py::class_<Table, std::shared_ptr<Table>>(m, name);
+    cls
+        .def_property_readonly("size", &Table::size)
+        .def_property_readonly("i", [](py::object self){ const auto& T = self.cast<const Table&>(); return column_view(T.i.data(), T.i.size(), 1, self); })
+        .def_property_readonly("j", [](py::object self){ const auto& T = self.cast<const Table&>(); return column_view(T.j.data(), T.j.size(), 1, self); })
+        .def_property_readonly("img", [](py::object self){ const auto& T = self.cast<const Table&>(); return column_view(T.img.empty() ? nullptr : T.img[0].data(), T.img.size(), 3, self); })
+        .def_property_readonly("disp", [](py::object self){ const auto& T = self.cast<const Table&>(); return column_view(T.disp.empty() ? nullptr : &T.disp[0].x, T.disp.size(), 3, self); })
+        .def_property_readonly("r2", [](py::object self){ const auto& T = self.cast<const Table&>(); return column_view(T.r2.data(), T.r2.size(), 1, self); })
+        .def_property_readonly("offsets", [](py::object self){ const auto& T = self.cast<const Table&>(); return column_view(T.offsets.data(), T.offsets.size(), 1, self); })
+        .def_static("from_arrays", [](CArray<int32_t> i, CArray<int32_t> j, CArray<int32_t> img, CArray<Real> disp, py::object r2, long long num_atoms){
+            const size_t E = i.ndim()==1 ? (size_t)i.shape(0) : 0;
+            Table T;
+            copy_column(T.i, i, E, 1, "i");
+            copy_column(T.j, j, E, 1, "j");
+            copy_column(T.img, img, E, 3, "img");
+            copy_column(T.disp, disp, E, 3, "disp");
+            if(r2.is_none()){
+                T.r2.resize(E);
+                for(size_t r=0;r<E;++r) T.r2[r] = (Real)Vec3(T.disp[r]).norm2();
+            } else {
+                copy_column(T.r2, r2.cast<CArray<Real>>(), E, 1, "r2");
+            }
+            size_t N = 0;
+            if(num_atoms >= 0) N = (size_t)num_atoms;
+            else {
+                for(int32_t a : T.i) N = std::max(N, (size_t)a + 1);
+                if constexpr (Half) for(int32_t a : T.j) N = std::max(N, (size_t)a + 1);
+            }
+            build_offsets(T, N); // left empty if rows are not grouped by ascending i
+            if constexpr (Half) by_atom_index(T, N, 0, T.by_atom_offsets, T.by_atom);
+            else T.rev = reverse_rows(T);
+            return T;
+        }, py::arg("i"), py::arg("j"), py::arg("img"), py::arg("disp"), py::arg("r2") = py::none(), py::arg("num_atoms") = -1,
+           "Build a table from NumPy columns (bulk copies); r2 defaults to |disp|^2.");
+    if constexpr (!Half)
+        cls.def_property_readonly("rev", [](py::object self){ const auto& T = self.cast<const Table&>(); return column_view(T.rev.data(), T.rev.size(), 1, self); });
+}
+
+template<class Real>
+static void bind_tessellation_result(py::module_& m, const char* name){
+    using Result = BasicTessellationResult<Real>;
+    py::class_<Result>(m, name)
+        .def_property_readonly("num_cells", &Result::num_cells)
+        .def_property_readonly("num_faces", &Result::num_faces)
+        .def_property_readonly("vertices", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.vertices.empty() ? nullptr : &R.vertices[0].x, R.vertices.size(), 3, self); })
+        .def_property_readonly("cell_vertex_offsets", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.cell_vertex_offsets.data(), R.cell_vertex_offsets.size(), 1, self); })
+        .def_property_readonly("face_vertex_indices", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.face_vertex_indices.data(), R.face_vertex_indices.size(), 1, self); })
+        .def_property_readonly("face_offsets", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.face_offsets.data(), R.face_offsets.size(), 1, self); })
+        .def_property_readonly("cell_face_offsets", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.cell_face_offsets.data(), R.cell_face_offsets.size(), 1, self); })
+        .def_property_readonly("face_tag", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.face_tag.data(), R.face_tag.size(), 1, self); })
+        .def_property_readonly("face_area", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.face_area.data(), R.face_area.size(), 1, self); })
+        .def_property_readonly("face_normal", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.face_normal.empty() ? nullptr : &R.face_normal[0].x, R.face_normal.size(), 3, self); })
+        .def_property_readonly("atom_id", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.atom_id.data(), R.atom_id.size(), 1, self); })
+        .def_property_readonly("volume", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.volume.data(), R.volume.size(), 1, self); })
+        .def_property_readonly("centroid", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.centroid.empty() ? nullptr : &R.centroid[0].x, R.centroid.size(), 3, self); })
+        .def_property_readonly("rows_used", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.rows_used.data(), R.rows_used.size(), 1, self); })
+        .def_property_readonly("rows_skipped", [](py::object self){ const auto& R = self.cast<const Result&>(); return column_view(R.rows_skipped.data(), R.rows_skipped.size(), 1, self); })
+        .def("save", [](const Result& R, const std::string& path, bool compress){ write_tessellation_result(path, R, compress); },
+             py::arg("path"), py::arg("compress") = false, py::call_guard<py::gil_scoped_release>(), "Write the columns to a binary mesh file (see load_mesh_file).")
+        .def("__len__", &Result::num_cells)
+        .def("__getitem__", [](const Result& R, py::ssize_t k){
+            const py::ssize_t n = (py::ssize_t)R.num_cells();
+            if(k < 0) k += n;
+            if(k < 0 || k >= n) throw py::index_error("cell index out of range");
+            const size_t c = (size_t)k;
+            const int64_t v0 = R.cell_vertex_offsets[c], v1 = R.cell_vertex_offsets[c+1];
+            py::dict d;
+            d["atom_id"] = R.atom_id[c];
+            d["volume"] = R.volume[c];
+            d["centroid"] = py::make_tuple(R.centroid[c].x, R.centroid[c].y, R.centroid[c].z);
+            d["rows_used"] = R.rows_used[c];
+            d["rows_skipped"] = R.rows_skipped[c];
+            d["vertices"] = vec3_list_to_numpy(std::vector<Vec3>(R.vertices.begin()+v0, R.vertices.begin()+v1));
+            py::list faces;
+            for(int64_t f=R.cell_face_offsets[c]; f<R.cell_face_offsets[c+1]; ++f){
+                py::list L;
+                for(int64_t q=R.face_offsets[(size_t)f]; q<R.face_offsets[(size_t)f+1]; ++q) L.append(R.face_vertex_indices[(size_t)q] - v0);
+                faces.append(L);
+            }
+            d["faces"] = faces;
+            return d;
+        });
+}
+
+// Storage precision selected by a NumPy dtype argument (None: float64)
+static bool wants_float32(const py::object& dtype){
+    if(dtype.is_none()) return false;
+    const py::dtype dt = py::dtype::from_args(dtype);
+    if(dt.kind() != 'f' || (dt.itemsize() != 4 && dt.itemsize() != 8)) throw std::runtime_error("dtype must be float32 or float64");
+    return dt.itemsize() == 4;
+}
+
+// flatten_cells for a Python result, timed as the python_conversion phase
+template<class Real = double>
+static BasicTessellationResult<Real> result_columns(const std::vector<CellResult>& cells){
+    V3D_PROFILE_SCOPE(PythonConversion);
+    BasicTessellationResult<Real> R = flatten_cells<Real>(cells);
+    V3D_PROFILE_COUNT(BytesAllocated, capacity_bytes(R.vertices, R.cell_vertex_offsets, R.face_vertex_indices, R.face_offsets,
+                                                     R.cell_face_offsets, R.face_tag, R.face_area, R.face_normal, R.atom_id,
+                                                     R.volume, R.centroid, R.rows_used, R.rows_skipped));
+    return R;
+}
+
+// Cells of every atom, flattened at the table's storage precision
+template<class Container, class Real, bool Half>
+static BasicTessellationResult<Real> tessellate_pairs_columns(const Container& c, const BasicNeighborTable<Real,Half>& T, const CArray<double>& M_arr, const Config& cfg){
+    if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
+    if((size_t)M_arr.shape(0) != T.i.size()) throw std::runtime_error("M length must equal neighbor table size");
+    std::vector<double> M(M_arr.data(), M_arr.data() + T.i.size());
+    V3D_PROFILE_CALL();
+    py::gil_scoped_release nogil;
+    return result_columns<Real>(tessellate_pairs(c, T, M, cfg));
+}
+
+// symmetrize_M over a table, as a new float64 array
+template<class Real>
+static py::array_t<double> symmetrize_M_array(const BasicNeighborTable<Real>& T, const CArray<double>& M_arr, int num_threads){
+    if(M_arr.ndim()!=1 || (size_t)M_arr.shape(0) != T.size()) throw std::runtime_error("M length must equal neighbor table size");
+    std::vector<double> M(M_arr.data(), M_arr.data() + T.size());
+    py::array_t<double> out((py::ssize_t)T.size());
+    double* o = out.mutable_data();
+    {
+        py::gil_scoped_release nogil;
+        const std::vector<double> S = symmetrize_M(T, M, num_threads);
+        std::copy(S.begin(), S.end(), o);
+    }
+    return out;
+}
+
+// Global mesh of a tessellation as a dict of NumPy columns (see tessellate_pairs_global_mesh)
+static py::dict global_mesh_to_dict(const GlobalMesh& GM);
+
+template<class Container, class Table>
+static py::dict global_mesh_dict(const Container& c, const Table& T, const py::array_t<double, py::array::c_style | py::array::forcecast>& M_arr, const Config& cfg){
+    if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
+    if((size_t)M_arr.shape(0) != T.i.size()) throw std::runtime_error("M length must equal neighbor table size");
+    std::vector<double> M(T.i.size());
+    auto Mb = M_arr.unchecked<1>();
+    for(py::ssize_t k=0;k<M_arr.shape(0);++k) M[(size_t)k] = Mb(k);
+    V3D_PROFILE_CALL();
+    GlobalMesh GM;
+    {
+        py::gil_scoped_release nogil;
+        GM = global_mesh_of(c, T, M, cfg);
+    }
+    return global_mesh_to_dict(GM);
+}
+
+// The dict of tessellate_pairs_global_mesh (also read back by read_global_mesh)
+static py::dict global_mesh_to_dict(const GlobalMesh& GM){
+    V3D_PROFILE_SCOPE(PythonConversion);
+    py::dict out;
+    out["vertices"] = vec3_list_to_numpy(GM.vertices);
+    // edges
+    py::array_t<int> E_arr({(py::ssize_t)GM.edges.size(), (py::ssize_t)2});
+    auto Eb = E_arr.mutable_unchecked<2>();
+    for(py::ssize_t e=0;e<(py::ssize_t)GM.edges.size();++e){ Eb(e,0)=GM.edges[e][0]; Eb(e,1)=GM.edges[e][1]; }
+    out["edges"] = E_arr;
+    // faces
+    py::list loops;
+    py::array_t<int> Fi({(py::ssize_t)GM.faces.size()});
+    py::array_t<int> Fj({(py::ssize_t)GM.faces.size()});
+    py::array_t<int> Fimg({(py::ssize_t)GM.faces.size(), (py::ssize_t)3});
+    py::array_t<double> Farea({(py::ssize_t)GM.faces.size()});
+    py::array_t<double> Fcent({(py::ssize_t)GM.faces.size(), (py::ssize_t)3});
+    py::array_t<double> Fnorm({(py::ssize_t)GM.faces.size(), (py::ssize_t)3});
+    auto Fi_b=Fi.mutable_unchecked<1>(); auto Fj_b=Fj.mutable_unchecked<1>();
+    auto Fimg_b=Fimg.mutable_unchecked<2>(); auto Farea_b=Farea.mutable_unchecked<1>();
+    auto Fcent_b=Fcent.mutable_unchecked<2>(); auto Fnorm_b=Fnorm.mutable_unchecked<2>();
+    for(py::ssize_t f=0; f<(py::ssize_t)GM.faces.size(); ++f){
+        py::list L;
+        for(int vid : GM.faces[f].loop) L.append(vid);
+        loops.append(L);
+        Fi_b(f) = GM.faces[f].i; Fj_b(f) = GM.faces[f].j;
+        Fimg_b(f,0)=GM.faces[f].img[0]; Fimg_b(f,1)=GM.faces[f].img[1]; Fimg_b(f,2)=GM.faces[f].img[2];
+        Farea_b(f) = GM.faces[f].area;
+        Fcent_b(f,0)=GM.faces[f].centroid.x; Fcent_b(f,1)=GM.faces[f].centroid.y; Fcent_b(f,2)=GM.faces[f].centroid.z;
+        Fnorm_b(f,0)=GM.faces[f].normal_ij.x; Fnorm_b(f,1)=GM.faces[f].normal_ij.y; Fnorm_b(f,2)=GM.faces[f].normal_ij.z;
+    }
+    py::dict Fdict;
+    Fdict["loops"] = loops; Fdict["i"] = Fi; Fdict["j"] = Fj;
+    Fdict["img"] = Fimg; Fdict["area"] = Farea;
+    Fdict["centroid"] = Fcent; Fdict["normal_ij"] = Fnorm;
+    out["faces"] = Fdict;
+    // cells
+    py::array_t<int> Cid({(py::ssize_t)GM.cells.size()});
+    py::array_t<double> Cvol({(py::ssize_t)GM.cells.size()});
+    py::array_t<double> Ccent({(py::ssize_t)GM.cells.size(), (py::ssize_t)3});
+    auto Cid_b=Cid.mutable_unchecked<1>(); auto Cvol_b=Cvol.mutable_unchecked<1>(); auto Ccent_b=Ccent.mutable_unchecked<2>();
+    py::list Cfaces;
+    for(py::ssize_t ci=0; ci<(py::ssize_t)GM.cells.size(); ++ci){
+        Cid_b(ci)=GM.cells[ci].atom_id; Cvol_b(ci)=GM.cells[ci].volume;
+        Ccent_b(ci,0)=GM.cells[ci].centroid.x; Ccent_b(ci,1)=GM.cells[ci].centroid.y; Ccent_b(ci,2)=GM.cells[ci].centroid.z;
+        py::list lf; for(int fid : GM.cells[ci].face_ids) lf.append(fid); Cfaces.append(lf);
+    }
+    py::dict Cdict; Cdict["atom_id"]=Cid; Cdict["volume"]=Cvol; Cdict["centroid"]=Ccent; Cdict["face_ids"]=Cfaces;
+    out["cells"] = Cdict;
+    return out;
+}
+
+// Block of a mesh file as a new array of its stored type, shaped (rows,) or (rows, cols)
+template<class Scalar>
+static py::array mesh_file_column(const MeshFile& F, const MeshFileBlock& B){
+    std::vector<Scalar> v;
+    {
+        py::gil_scoped_release nogil;
+        v = F.column<Scalar>(B.name);
+    }
+    std::vector<py::ssize_t> shape{(py::ssize_t)B.rows};
+    if(B.cols > 1) shape.push_back((py::ssize_t)B.cols);
+    py::array_t<Scalar> arr(shape);
+    if(!v.empty()) std::memcpy(arr.mutable_data(), v.data(), v.size()*sizeof(Scalar));
+    return arr;
+}
+
+static py::array mesh_file_column(const MeshFile& F, const std::string& name){
+    const MeshFileBlock& B = F.block(name);
+    if(B.dtype == 'f' && B.itemsize == 8) return mesh_file_column<double>(F, B);
+    if(B.dtype == 'f' && B.itemsize == 4) return mesh_file_column<float>(F, B);
+    if(B.dtype == 'i' && B.itemsize == 4) return mesh_file_column<int32_t>(F, B);
+    if(B.dtype == 'i' && B.itemsize == 8) return mesh_file_column<int64_t>(F, B);
+    throw std::runtime_error("block " + name + " has an unsupported type");
+}
+
+// Global mesh of a box tessellation written to a binary mesh file (see save_global_mesh)
+template<class Table>
+static void save_global_mesh_file(const BoxContainer& box, const Table& T, const CArray<double>& M_arr, const Config& cfg, const std::string& path, bool compress){
+    if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
+    if((size_t)M_arr.shape(0) != T.i.size()) throw std::runtime_error("M length must equal neighbor table size");
+    std::vector<double> M(M_arr.data(), M_arr.data() + M_arr.shape(0));
+    V3D_PROFILE_CALL();
+    py::gil_scoped_release nogil;
+    write_global_mesh(path, global_mesh_of(box, T, M, cfg), compress);
+}
+
 PYBIND11_MODULE(_core, m) {
+    py::enum_<StitchMode>(m, "StitchMode")
+        .value("Geometric", StitchMode::Geometric)
+        .value("Topological", StitchMode::Topological);
+
     py::class_<Config>(m, "Config")
         .def(py::init<>())
         .def_readwrite("eps_pos", &Config::eps_pos)
@@ -33,7 +353,9 @@ PYBIND11_MODULE(_core, m) {
         .def_readwrite("min_face_area", &Config::min_face_area)
         .def_readwrite("min_M", &Config::min_M)
         .def_readwrite("reach_factor", &Config::reach_factor)
-        .def_readwrite("neighbor_skin", &Config::neighbor_skin);
+        .def_readwrite("neighbor_skin", &Config::neighbor_skin)
+        .def_readwrite("num_threads", &Config::num_threads)
+        .def_readwrite("stitch_mode", &Config::stitch_mode);
 
     py::class_<Vec3>(m, "Vec3")
         .def(py::init<double,double,double>())
@@ -60,135 +382,122 @@ PYBIND11_MODULE(_core, m) {
         .def("add_atoms", &TriclinicPBC::add_atoms)
         .def_readonly("pos", &TriclinicPBC::pos);
 
-    py::class_<NeighborTable>(m, "NeighborTable")
-        .def_property_readonly("size", &NeighborTable::size)
-        .def_readonly("i", &NeighborTable::i)
-        .def_readonly("j", &NeighborTable::j)
-        .def_readonly("img", &NeighborTable::img)
-        .def_readonly("disp", &NeighborTable::disp)
-        .def_readonly("r2", &NeighborTable::r2);
+    // Columns are read-only NumPy views sharing the table's storage
+    bind_neighbor_table<double>(m, "NeighborTable");
+    bind_neighbor_table<float>(m, "NeighborTableF32");
+    bind_neighbor_table<double, true>(m, "HalfNeighborTable");
+    bind_neighbor_table<float, true>(m, "HalfNeighborTableF32");
 
-    m.def("plan_neighbors", [](const BoxContainer& box, const Config& cfg){ return plan_neighbors(box, cfg); });
-    m.def("plan_neighbors", [](const TriclinicPBC& pbc, const Config& cfg){ return plan_neighbors(pbc, cfg); });
+    // Stateful planner: update() returns the current table, rebuilt only when atoms moved too
+    // far for the skin; refreshed tables are the same object, modified in place
+    py::class_<NeighborPlanner>(m, "NeighborPlanner")
+        .def(py::init<const Config&>(), py::arg("cfg"))
+        .def("update", [](NeighborPlanner& P, const BoxContainer& box){
+            { V3D_PROFILE_CALL(); py::gil_scoped_release nogil; P.update(box); }
+            return P.table_ptr();
+        }, py::arg("box"))
+        .def("update", [](NeighborPlanner& P, const TriclinicPBC& pbc){
+            { V3D_PROFILE_CALL(); py::gil_scoped_release nogil; P.update(pbc); }
+            return P.table_ptr();
+        }, py::arg("pbc"))
+        .def("reset", &NeighborPlanner::reset)
+        .def_property_readonly("table", &NeighborPlanner::table_ptr)
+        .def_property_readonly("last_rebuilt", &NeighborPlanner::last_rebuilt)
+        .def_property_readonly("frames", [](const NeighborPlanner& P){ return P.stats().frames; })
+        .def_property_readonly("rebuilds", [](const NeighborPlanner& P){ return P.stats().rebuilds; })
+        .def_property_readonly("refreshes", [](const NeighborPlanner& P){ return P.stats().refreshes; })
+        .def_property_readonly("max_displacement", [](const NeighborPlanner& P){ return P.stats().max_displacement; });
 
-    m.def("tessellate_pairs", [](const BoxContainer& box, const NeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg){
-        if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
-        if((size_t)M_arr.shape(0) != T.i.size()) throw std::runtime_error("M length must equal neighbor table size");
-        std::vector<double> M(T.i.size());
-        auto Mb = M_arr.unchecked<1>();
-        for(py::ssize_t k=0;k<M_arr.shape(0);++k) M[(size_t)k] = Mb(k);
-        auto cells = tessellate_pairs(box, T, M, cfg);
-        py::list out;
-        for(const auto& c : cells){
-            py::dict d;
-            d["atom_id"] = c.atom_id;
-            d["volume"] = c.volume;
-            d["centroid"] = py::make_tuple(c.centroid.x, c.centroid.y, c.centroid.z);
-            d["centroid"] = py::make_tuple(c.centroid.x, c.centroid.y, c.centroid.z);
-            d["vertices"] = vec3_list_to_numpy(c.poly.V);
-            py::list faces;
-            for(const auto& loop : c.poly.F){
-                py::list L;
-                for(int idx : loop) L.append(idx);
-                faces.append(L);
-            }
-            d["faces"] = faces;
-            out.append(d);
-        }
-        return out;
-    });
+    // Columnar tessellation output; columns are read-only views, and indexing yields the
+    // per-cell dict of earlier versions (atom_id, volume, centroid, vertices, faces, ...)
+    bind_tessellation_result<double>(m, "TessellationResult");
+    bind_tessellation_result<float>(m, "TessellationResultF32");
 
-    m.def("tessellate_pairs", [](const TriclinicPBC& pbc, const NeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg){
-        if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
-        if((size_t)M_arr.shape(0) != T.i.size()) throw std::runtime_error("M length must equal neighbor table size");
-        std::vector<double> M(T.i.size());
-        auto Mb = M_arr.unchecked<1>();
-        for(py::ssize_t k=0;k<M_arr.shape(0);++k) M[(size_t)k] = Mb(k);
-        auto cells = tessellate_pairs(pbc, T, M, cfg);
-        py::list out;
-        for(const auto& c : cells){
-            py::dict d;
-            d["atom_id"] = c.atom_id;
-            d["volume"] = c.volume;
-            d["centroid"] = py::make_tuple(c.centroid.x, c.centroid.y, c.centroid.z);
-            d["vertices"] = vec3_list_to_numpy(c.poly.V);
-            py::list faces;
-            for(const auto& loop : c.poly.F){
-                py::list L;
-                for(int idx : loop) L.append(idx);
-                faces.append(L);
-            }
-            d["faces"] = faces;
-            out.append(d);
-        }
-        return out;
-    });
+    m.def("plan_neighbors", [](const BoxContainer& box, const Config& cfg, py::object dtype, bool half) -> py::object {
+        const bool f32 = wants_float32(dtype);
+        V3D_PROFILE_CALL();
+        if(half) return f32 ? py::cast(plan_neighbors<HalfNeighborTableF32>(box, cfg)) : py::cast(plan_neighbors<HalfNeighborTable>(box, cfg));
+        return f32 ? py::cast(plan_neighbors<NeighborTableF32>(box, cfg)) : py::cast(plan_neighbors(box, cfg));
+    }, py::arg("box"), py::arg("cfg"), py::arg("dtype") = py::none(), py::arg("half") = false,
+       "Plan the neighbor table; dtype=numpy.float32 stores disp and r2 in single precision, half=True "
+       "stores each pair once (HalfNeighborTable: M is given for the stored orientation, the reverse takes 1 - M). "
+       "Cells of a half table tag their faces with oriented rows: 2h for stored row h seen from atom i[h], "
+       "2h+1 for the same row seen from j[h].");
+    m.def("plan_neighbors", [](const TriclinicPBC& pbc, const Config& cfg, py::object dtype, bool half) -> py::object {
+        const bool f32 = wants_float32(dtype);
+        V3D_PROFILE_CALL();
+        if(half) return f32 ? py::cast(plan_neighbors<HalfNeighborTableF32>(pbc, cfg)) : py::cast(plan_neighbors<HalfNeighborTable>(pbc, cfg));
+        return f32 ? py::cast(plan_neighbors<NeighborTableF32>(pbc, cfg)) : py::cast(plan_neighbors(pbc, cfg));
+    }, py::arg("pbc"), py::arg("cfg"), py::arg("dtype") = py::none(), py::arg("half") = false);
 
-    m.def("tessellate_pairs_global_mesh", [](const BoxContainer& box, const NeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg){
-        if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
-        if((size_t)M_arr.shape(0) != T.i.size()) throw std::runtime_error("M length must equal neighbor table size");
-        std::vector<double> M(T.i.size());
-        auto Mb = M_arr.unchecked<1>();
-        for(py::ssize_t k=0;k<M_arr.shape(0);++k) M[(size_t)k] = Mb(k);
-        auto cells = tessellate_pairs(box, T, M, cfg);
-        // collect polys and ids
-        std::vector<Polyhedron> polys; polys.reserve(cells.size());
-        std::vector<int> atom_ids; atom_ids.reserve(cells.size());
-        std::vector<double> vols; vols.reserve(cells.size());
-        std::vector<Vec3> atom_pos = box.pos;
-        for(const auto& c : cells){ polys.push_back(c.poly); atom_ids.push_back(c.atom_id); vols.push_back(c.volume); }
-        std::vector<Vec3> cents; cents.reserve(cells.size()); for(const auto& c : cells) cents.push_back(c.centroid);
-        auto GM = stitch_global(T, polys, atom_ids, vols, cents, atom_pos, cfg);
-        // build Python dict
-        py::dict out;
-        out["vertices"] = vec3_list_to_numpy(GM.vertices);
-        // edges
-        py::array_t<int> E_arr({(py::ssize_t)GM.edges.size(), (py::ssize_t)2});
-        auto Eb = E_arr.mutable_unchecked<2>();
-        for(py::ssize_t e=0;e<(py::ssize_t)GM.edges.size();++e){ Eb(e,0)=GM.edges[e][0]; Eb(e,1)=GM.edges[e][1]; }
-        out["edges"] = E_arr;
-        // faces
-        py::list loops;
-        py::array_t<int> Fi({(py::ssize_t)GM.faces.size()});
-        py::array_t<int> Fj({(py::ssize_t)GM.faces.size()});
-        py::array_t<int> Fimg({(py::ssize_t)GM.faces.size(), (py::ssize_t)3});
-        py::array_t<double> Farea({(py::ssize_t)GM.faces.size()});
-        py::array_t<double> Fcent({(py::ssize_t)GM.faces.size(), (py::ssize_t)3});
-        py::array_t<double> Fnorm({(py::ssize_t)GM.faces.size(), (py::ssize_t)3});
-        auto Fi_b=Fi.mutable_unchecked<1>(); auto Fj_b=Fj.mutable_unchecked<1>();
-        auto Fimg_b=Fimg.mutable_unchecked<2>(); auto Farea_b=Farea.mutable_unchecked<1>();
-        auto Fcent_b=Fcent.mutable_unchecked<2>(); auto Fnorm_b=Fnorm.mutable_unchecked<2>();
-        for(py::ssize_t f=0; f<(py::ssize_t)GM.faces.size(); ++f){
-            py::list L;
-            for(int vid : GM.faces[f].loop) L.append(vid);
-            loops.append(L);
-            Fi_b(f) = GM.faces[f].i; Fj_b(f) = GM.faces[f].j;
-            Fimg_b(f,0)=GM.faces[f].img[0]; Fimg_b(f,1)=GM.faces[f].img[1]; Fimg_b(f,2)=GM.faces[f].img[2];
-            Farea_b(f) = GM.faces[f].area;
-            Fcent_b(f,0)=GM.faces[f].centroid.x; Fcent_b(f,1)=GM.faces[f].centroid.y; Fcent_b(f,2)=GM.faces[f].centroid.z;
-            Fnorm_b(f,0)=GM.faces[f].normal_ij.x; Fnorm_b(f,1)=GM.faces[f].normal_ij.y; Fnorm_b(f,2)=GM.faces[f].normal_ij.z;
-        }
-        py::dict Fdict;
-        Fdict["loops"] = loops; Fdict["i"] = Fi; Fdict["j"] = Fj;
-        Fdict["img"] = Fimg; Fdict["area"] = Farea;
-        Fdict["centroid"] = Fcent; Fdict["normal_ij"] = Fnorm;
-        out["faces"] = Fdict;
-        // cells
-        py::array_t<int> Cid({(py::ssize_t)GM.cells.size()});
-        py::array_t<double> Cvol({(py::ssize_t)GM.cells.size()});
-        py::array_t<double> Ccent({(py::ssize_t)GM.cells.size(), (py::ssize_t)3});
-        auto Cid_b=Cid.mutable_unchecked<1>(); auto Cvol_b=Cvol.mutable_unchecked<1>(); auto Ccent_b=Ccent.mutable_unchecked<2>();
-        py::list Cfaces;
-        for(py::ssize_t ci=0; ci<(py::ssize_t)GM.cells.size(); ++ci){
-            Cid_b(ci)=GM.cells[ci].atom_id; Cvol_b(ci)=GM.cells[ci].volume;
-            Ccent_b(ci,0)=GM.cells[ci].centroid.x; Ccent_b(ci,1)=GM.cells[ci].centroid.y; Ccent_b(ci,2)=GM.cells[ci].centroid.z;
-            py::list lf; for(int fid : GM.cells[ci].face_ids) lf.append(fid); Cfaces.append(lf);
+    m.def("symmetrize_M", [](const NeighborTable& T, CArray<double> M, int num_threads){ return symmetrize_M_array(T, M, num_threads); },
+          py::arg("table"), py::arg("M"), py::arg("num_threads") = 0,
+          "M' with M'[rev] = 1 - M' for every row that has a reverse row (pairs averaged), using table.rev.");
+    m.def("symmetrize_M", [](const NeighborTableF32& T, CArray<double> M, int num_threads){ return symmetrize_M_array(T, M, num_threads); },
+          py::arg("table"), py::arg("M"), py::arg("num_threads") = 0);
+    m.def("symmetrize_M", [](CArray<int32_t> i, CArray<int32_t> j, CArray<int32_t> img, CArray<double> M, int num_threads){
+        const size_t E = i.ndim()==1 ? (size_t)i.shape(0) : 0;
+        NeighborTable T;   // rows are paired by i, j, img alone
+        copy_column(T.i, i, E, 1, "i");
+        copy_column(T.j, j, E, 1, "j");
+        copy_column(T.img, img, E, 3, "img");
+        return symmetrize_M_array(T, M, num_threads);
+    }, py::arg("i"), py::arg("j"), py::arg("img"), py::arg("M"), py::arg("num_threads") = 0);
+
+    // The result takes the storage precision of the table (TessellationResultF32 for float32)
+    m.def("tessellate_pairs", [](const BoxContainer& box, const NeighborTable& T, CArray<double> M_arr, const Config& cfg){ return tessellate_pairs_columns(box, T, M_arr, cfg); });
+    m.def("tessellate_pairs", [](const TriclinicPBC& pbc, const NeighborTable& T, CArray<double> M_arr, const Config& cfg){ return tessellate_pairs_columns(pbc, T, M_arr, cfg); });
+    m.def("tessellate_pairs", [](const BoxContainer& box, const NeighborTableF32& T, CArray<double> M_arr, const Config& cfg){ return tessellate_pairs_columns(box, T, M_arr, cfg); });
+    m.def("tessellate_pairs", [](const TriclinicPBC& pbc, const NeighborTableF32& T, CArray<double> M_arr, const Config& cfg){ return tessellate_pairs_columns(pbc, T, M_arr, cfg); });
+    m.def("tessellate_pairs", [](const BoxContainer& box, const HalfNeighborTable& T, CArray<double> M_arr, const Config& cfg){ return tessellate_pairs_columns(box, T, M_arr, cfg); });
+    m.def("tessellate_pairs", [](const TriclinicPBC& pbc, const HalfNeighborTable& T, CArray<double> M_arr, const Config& cfg){ return tessellate_pairs_columns(pbc, T, M_arr, cfg); });
+    m.def("tessellate_pairs", [](const BoxContainer& box, const HalfNeighborTableF32& T, CArray<double> M_arr, const Config& cfg){ return tessellate_pairs_columns(box, T, M_arr, cfg); });
+    m.def("tessellate_pairs", [](const TriclinicPBC& pbc, const HalfNeighborTableF32& T, CArray<double> M_arr, const Config& cfg){ return tessellate_pairs_columns(pbc, T, M_arr, cfg); });
+
+    m.def("tessellate_pairs_global_mesh", [](const BoxContainer& box, const NeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg){ return global_mesh_dict(box, T, M_arr, cfg); });
+    m.def("tessellate_pairs_global_mesh", [](const BoxContainer& box, const HalfNeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg){ return global_mesh_dict(box, T, M_arr, cfg); });
+    m.def("tessellate_pairs_global_mesh", [](const TriclinicPBC& pbc, const NeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg){ return global_mesh_dict(pbc, T, M_arr, cfg); });
+    m.def("tessellate_pairs_global_mesh", [](const TriclinicPBC& pbc, const HalfNeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg){ return global_mesh_dict(pbc, T, M_arr, cfg); });
+
+
+    // Same mesh, written to a binary mesh file without building Python objects
+    m.def("save_global_mesh", [](const BoxContainer& box, const NeighborTable& T, CArray<double> M_arr, const Config& cfg, const std::string& path, bool compress){
+        save_global_mesh_file(box, T, M_arr, cfg, path, compress);
+    }, py::arg("box"), py::arg("T"), py::arg("M"), py::arg("cfg"), py::arg("path"), py::arg("compress") = false);
+    m.def("save_global_mesh", [](const BoxContainer& box, const HalfNeighborTable& T, CArray<double> M_arr, const Config& cfg, const std::string& path, bool compress){
+        save_global_mesh_file(box, T, M_arr, cfg, path, compress);
+    }, py::arg("box"), py::arg("T"), py::arg("M"), py::arg("cfg"), py::arg("path"), py::arg("compress") = false);
+
+    m.def("read_global_mesh", [](const std::string& path){
+        GlobalMesh GM;
+        {
+            py::gil_scoped_release nogil;
+            GM = read_global_mesh(path);
         }
-        py::dict Cdict; Cdict["atom_id"]=Cid; Cdict["volume"]=Cvol; Cdict["centroid"]=Ccent; Cdict["face_ids"]=Cfaces;
-        out["cells"] = Cdict;
-        return out;
-    });
+        return global_mesh_to_dict(GM);
+    }, py::arg("path"), "The dict of tessellate_pairs_global_mesh, read back from a file written by save_global_mesh");
+#ifdef V3D_ZLIB
+    m.attr("mesh_compression_enabled") = true;
+#else
+    m.attr("mesh_compression_enabled") = false;
+#endif
 
+    // Mesh file read through cpp/io/mesh_file.hpp: blocks come back as new arrays, compressed
+    // ones inflated (load_mesh_file maps raw blocks without copying instead)
+    py::class_<MeshFile>(m, "MeshFile")
+        .def(py::init<const std::string&>(), py::arg("path"))
+        .def_property_readonly("kind", [](const MeshFile& F) -> py::object {
+            if(F.kind() == MeshFileKind::GlobalMesh) return py::str("global_mesh");
+            if(F.kind() == MeshFileKind::TessellationResult) return py::str("tessellation_result");
+            return py::int_((uint32_t)F.kind());
+        })
+        .def_property_readonly("blocks", [](const MeshFile& F){
+            std::vector<std::string> names;
+            for(const auto& B : F.blocks()) names.push_back(B.name);
+            return names;
+        })
+        .def("compressed", [](const MeshFile& F, const std::string& name){ return F.block(name).codec == BlockCodec::Zlib; }, py::arg("name"))
+        .def("column", [](const MeshFile& F, const std::string& name){ return mesh_file_column(F, name); }, py::arg("name"));
 
     py::class_<CapOptions>(m, "CapOptions")
         .def(py::init<>())
@@ -204,24 +513,234 @@ PYBIND11_MODULE(_core, m) {
         std::vector<double> M(T.i.size());
         auto Mb = M_arr.unchecked<1>();
         for(py::ssize_t k=0;k<M_arr.shape(0);++k) M[(size_t)k] = Mb(k);
-        auto cells = tessellate_pairs_with_caps(box, T, M, opt, cfg);
-        py::list out;
-        for(const auto& c : cells){
-            py::dict d;
-            d["atom_id"] = c.atom_id;
-            d["volume"] = c.volume;
-            d["centroid"] = py::make_tuple(c.centroid.x, c.centroid.y, c.centroid.z);
-            d["vertices"] = vec3_list_to_numpy(c.poly.V);
-            py::list faces;
-            for(const auto& loop : c.poly.F){
-                py::list L;
-                for(int idx : loop) L.append(idx);
-                faces.append(L);
-            }
-            d["faces"] = faces;
-            out.append(d);
+        V3D_PROFILE_CALL();
+        TessellationResult R;
+        {
+            py::gil_scoped_release nogil;
+            R = result_columns(tessellate_pairs_with_caps(box, T, M, opt, cfg));
         }
-        return out;
+        return R;
     });
 
+    py::class_<TessellationStream>(m, "TessellationStream")
+        .def("__iter__", [](TessellationStream& S) -> TessellationStream& { return S; }, py::return_value_policy::reference_internal)
+        .def("__next__", [](TessellationStream& S){
+            if(S.next >= S.order.size()) throw py::stop_iteration();
+            V3D_PROFILE_CALL();
+            TessellationResult R;
+            {
+                py::gil_scoped_release nogil;
+                const size_t n = std::min(S.chunk_size, S.order.size() - S.next);
+                S.build(S.order.data() + S.next, n, S.cells);
+                S.next += n;
+                R = result_columns(S.cells);
+            }
+            return R;
+        })
+        .def("__len__", &TessellationStream::num_chunks)
+        .def_property_readonly("order", [](py::object self){
+            const auto& S = self.cast<const TessellationStream&>();
+            return column_view(S.order.data(), S.order.size(), 1, self);
+        });
+
+    m.def("tessellate_pairs_stream", [](const BoxContainer& box, const NeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg, size_t chunk_size){
+        if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
+        if((size_t)M_arr.shape(0) != T.i.size()) throw std::runtime_error("M length must equal neighbor table size");
+        std::vector<double> M(M_arr.data(), M_arr.data() + M_arr.shape(0));
+        return make_stream(box, T, std::move(M), cfg, chunk_size);
+    }, py::arg("box"), py::arg("T"), py::arg("M"), py::arg("cfg"), py::arg("chunk_size") = 65536,
+       py::keep_alive<0,1>(), py::keep_alive<0,2>());
+
+    m.def("tessellate_pairs_stream", [](const TriclinicPBC& pbc, const NeighborTable& T, py::array_t<double, py::array::c_style | py::array::forcecast> M_arr, const Config& cfg, size_t chunk_size){
+        if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
+        if((size_t)M_arr.shape(0) != T.i.size()) throw std::runtime_error("M length must equal neighbor table size");
+        std::vector<double> M(M_arr.data(), M_arr.data() + M_arr.shape(0));
+        return make_stream(pbc, T, std::move(M), cfg, chunk_size);
+    }, py::arg("pbc"), py::arg("T"), py::arg("M"), py::arg("cfg"), py::arg("chunk_size") = 65536,
+       py::keep_alive<0,1>(), py::keep_alive<0,2>());
+
+    // Persistent tessellation for sparse M updates; keeps the container and table alive
+    py::class_<IncrementalTessellation>(m, "IncrementalTessellation")
+        .def(py::init([](const BoxContainer& box, const NeighborTable& T, CArray<double> M_arr, const Config& cfg){
+            if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
+            std::vector<double> M(M_arr.data(), M_arr.data() + M_arr.shape(0));
+            py::gil_scoped_release nogil;
+            return new IncrementalTessellation(box, T, std::move(M), cfg);
+        }), py::arg("box"), py::arg("T"), py::arg("M"), py::arg("cfg"), py::keep_alive<1,2>(), py::keep_alive<1,3>())
+        .def(py::init([](const TriclinicPBC& pbc, const NeighborTable& T, CArray<double> M_arr, const Config& cfg){
+            if(M_arr.ndim()!=1) throw std::runtime_error("M must be a 1D float64 array");
+            std::vector<double> M(M_arr.data(), M_arr.data() + M_arr.shape(0));
+            py::gil_scoped_release nogil;
+            return new IncrementalTessellation(pbc, T, std::move(M), cfg);
+        }), py::arg("pbc"), py::arg("T"), py::arg("M"), py::arg("cfg"), py::keep_alive<1,2>(), py::keep_alive<1,3>())
+        .def("update", [](IncrementalTessellation& S, CArray<int64_t> rows, CArray<double> values, bool symmetric){
+            if(rows.ndim()!=1 || values.ndim()!=1) throw std::runtime_error("rows and values must be 1D arrays");
+            std::vector<int64_t> r(rows.data(), rows.data() + rows.shape(0));
+            std::vector<double> v(values.data(), values.data() + values.shape(0));
+            V3D_PROFILE_CALL();
+            py::gil_scoped_release nogil;
+            return S.update(r, v, symmetric);
+        }, py::arg("rows"), py::arg("values"), py::arg("symmetric") = true,
+           "Set M[rows] = values (and the reverse rows to 1 - values if symmetric); returns the rebuilt cells. "
+           "Invalid rows or values raise before anything changes.")
+        .def("result", [](const IncrementalTessellation& S){
+            V3D_PROFILE_CALL();
+            py::gil_scoped_release nogil;
+            return result_columns(S.cells());
+        })
+        .def_property_readonly("M", [](py::object self){ const auto& S = self.cast<const IncrementalTessellation&>(); return column_view(S.M().data(), S.M().size(), 1, self); })
+        .def_property_readonly("volume", [](py::object self){ const auto& S = self.cast<const IncrementalTessellation&>(); return column_view(S.volume().data(), S.volume().size(), 1, self); })
+        .def_property_readonly("reverse_rows", [](py::object self){ const auto& S = self.cast<const IncrementalTessellation&>(); return column_view(S.reverse().data(), S.reverse().size(), 1, self); })
+        .def_property_readonly("cells_rebuilt", &IncrementalTessellation::cells_rebuilt);
+
+    // Trajectory batches: F x N summaries as views, per-frame results when keep_cells was set
+    py::class_<FrameBatchResult>(m, "FrameBatchResult")
+        .def_readonly("num_frames", &FrameBatchResult::num_frames)
+        .def_readonly("num_atoms", &FrameBatchResult::num_atoms)
+        .def_property_readonly("volume", [](py::object self){ const auto& B = self.cast<const FrameBatchResult&>(); return column_view(B.volume.data(), B.num_frames, B.num_atoms, self); })
+        .def_property_readonly("surface_area", [](py::object self){ const auto& B = self.cast<const FrameBatchResult&>(); return column_view(B.surface_area.data(), B.num_frames, B.num_atoms, self); })
+        .def_property_readonly("num_faces", [](py::object self){ const auto& B = self.cast<const FrameBatchResult&>(); return column_view(B.num_faces.data(), B.num_frames, B.num_atoms, self); })
+        .def("__len__", [](const FrameBatchResult& B){ return B.frames.size(); })
+        .def("__getitem__", [](const FrameBatchResult& B, py::ssize_t k) -> const TessellationResult& {
+            const py::ssize_t n = (py::ssize_t)B.frames.size();
+            if(k < 0) k += n;
+            if(k < 0 || k >= n) throw py::index_error("frame index out of range (keep_cells=False keeps no frames)");
+            return B.frames[(size_t)k];
+        }, py::return_value_policy::reference_internal);
+
+    m.def("tessellate_frames", [](const BoxBounds& bounds, CArray<double> xyz, const Config& cfg, double M, bool keep_cells){
+        if(xyz.ndim()!=3 || xyz.shape(2)!=3) throw std::runtime_error("positions must have shape (F,N,3)");
+        const size_t F = (size_t)xyz.shape(0), N = (size_t)xyz.shape(1);
+        V3D_PROFILE_CALL();
+        py::gil_scoped_release nogil;
+        return tessellate_frames(bounds, xyz.data(), F, N, M, cfg, keep_cells);
+    }, py::arg("bounds"), py::arg("positions"), py::arg("cfg"), py::arg("M") = 0.5, py::arg("keep_cells") = false);
+
+    m.def("tessellate_frames", [](const std::vector<Lattice>& lattices, std::array<bool,3> periodic, CArray<double> xyz, const Config& cfg, double M, bool keep_cells){
+        if(xyz.ndim()!=3 || xyz.shape(2)!=3) throw std::runtime_error("positions must have shape (F,N,3)");
+        const size_t F = (size_t)xyz.shape(0), N = (size_t)xyz.shape(1);
+        if(lattices.size() != 1 && lattices.size() != F) throw std::runtime_error("need one lattice, or one per frame");
+        V3D_PROFILE_CALL();
+        py::gil_scoped_release nogil;
+        return tessellate_frames(lattices, periodic, xyz.data(), F, N, M, cfg, keep_cells);
+    }, py::arg("lattices"), py::arg("periodic"), py::arg("positions"), py::arg("cfg"), py::arg("M") = 0.5, py::arg("keep_cells") = false);
+
+    py::enum_<TrajectoryFormat>(m, "TrajectoryFormat")
+        .value("Auto", TrajectoryFormat::Auto)
+        .value("ExtXYZ", TrajectoryFormat::ExtXYZ)
+        .value("LammpsText", TrajectoryFormat::LammpsText)
+        .value("LammpsBinary", TrajectoryFormat::LammpsBinary);
+
+    py::class_<TrajectoryFrame>(m, "TrajectoryFrame")
+        .def_readonly("timestep", &TrajectoryFrame::timestep)
+        .def_readonly("has_cell", &TrajectoryFrame::has_cell)
+        .def_readonly("origin", &TrajectoryFrame::origin)
+        .def_readonly("periodic", &TrajectoryFrame::periodic)
+        .def_property_readonly("positions", [](py::object self){ const auto& F = self.cast<const TrajectoryFrame&>(); return column_view(F.pos.empty() ? nullptr : &F.pos[0].x, F.pos.size(), 3, self); })
+        .def_property_readonly("cell", [](const TrajectoryFrame& F){   // rows are the cell vectors
+            py::array_t<double> H({3, 3});
+            auto h = H.mutable_unchecked<2>();
+            const Vec3 c[3] = {F.cell.c0, F.cell.c1, F.cell.c2};
+            for(int r=0;r<3;++r) for(int q=0;q<3;++q) h(r,q) = c[r][q];
+            return H;
+        })
+        .def("lattice", [](const TrajectoryFrame& F){
+            if(!F.has_cell) throw std::runtime_error("frame has no cell");
+            return lattice_of_cell(F.cell);
+        });
+
+    // Memory-mapped trajectory files; frames are indexed on open and parsed on access
+    py::class_<TrajectoryReader>(m, "TrajectoryReader")
+        .def(py::init<const std::string&, TrajectoryFormat, int>(), py::arg("path"), py::arg("format") = TrajectoryFormat::Auto, py::arg("num_threads") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("__len__", &TrajectoryReader::num_frames)
+        .def_property_readonly("format", &TrajectoryReader::format)
+        .def_property_readonly("path", &TrajectoryReader::path)
+        .def("num_atoms", &TrajectoryReader::num_atoms)
+        .def("read", &TrajectoryReader::read, py::call_guard<py::gil_scoped_release>())
+        .def("__getitem__", [](const TrajectoryReader& R, py::ssize_t k){
+            const py::ssize_t n = (py::ssize_t)R.num_frames();
+            if(k < 0) k += n;
+            if(k < 0 || k >= n) throw py::index_error("frame index out of range");
+            py::gil_scoped_release nogil;
+            return R.read((size_t)k);
+        })
+        .def("box", &TrajectoryReader::box, py::call_guard<py::gil_scoped_release>(), "Frame k as a BoxContainer spanning its cell (or its atoms)")
+        .def("pbc", &TrajectoryReader::pbc, py::call_guard<py::gil_scoped_release>(), "Frame k as a TriclinicPBC of its cell");
+
+    // Per-phase counters of one call (builds with VORONOI3D_PROFILE); seconds are summed over threads
+    py::class_<ProfileStats>(m, "ProfileStats")
+        .def_readonly("wall", &ProfileStats::wall)
+        .def_property_readonly("seconds", [](const ProfileStats& S){
+            py::dict d;
+            for(size_t k=0; k<kProfilePhases; ++k) d[profile_phase_name((ProfilePhase)k)] = S.seconds[k];
+            return d;
+        })
+        .def_property_readonly("counts", [](const ProfileStats& S){
+            py::dict d;
+            for(size_t k=0; k<kProfileCounters; ++k) d[profile_counter_name((ProfileCounter)k)] = S.counts[k];
+            return d;
+        })
+        .def_property_readonly("planes_per_cell", &ProfileStats::planes_per_cell)
+        .def("__repr__", [](const ProfileStats& S){
+            std::string r = "ProfileStats(wall=" + std::to_string(S.wall);
+            for(size_t k=0; k<kProfilePhases; ++k) if(S.seconds[k] > 0) r += std::string(", ") + profile_phase_name((ProfilePhase)k) + "=" + std::to_string(S.seconds[k]);
+            for(size_t k=0; k<kProfileCounters; ++k) if(S.counts[k] > 0) r += std::string(", ") + profile_counter_name((ProfileCounter)k) + "=" + std::to_string(S.counts[k]);
+            return r + ")";
+        });
+
+#ifdef V3D_PROFILE
+    m.attr("profiling_enabled") = true;
+#else
+    m.attr("profiling_enabled") = false;
+#endif
+    m.def("last_profile", []() -> py::object {
+#ifdef V3D_PROFILE
+        return py::cast(last_profile());
+#else
+        return py::none();
+#endif
+    }, "Counters of the last plan/tessellate/stitch call made by this thread, covering only that call's own work (None unless built with VORONOI3D_PROFILE)");
+
+    // The plane kernels of cpp/core/plane_kernels.hpp (SIMD when built with VORONOI3D_NATIVE), so
+    // tests can hold them to the scalar formula; planes are rows (nx, ny, nz, d)
+    m.attr("plane_kernel_lanes") = (int)kPlaneLanes;
+    m.def("_signed_distances", [](CArray<double> plane, CArray<double> V){
+        if(plane.ndim()!=1 || plane.shape(0)!=4) throw std::runtime_error("plane must have shape (4,)");
+        std::vector<Vec3> pts;
+        copy_column(pts, V, V.ndim()==2 ? (size_t)V.shape(0) : 0, 3, "V");
+        const Plane H{Vec3{plane.at(0), plane.at(1), plane.at(2)}, plane.at(3)};
+        py::array_t<double> sd((py::ssize_t)pts.size());
+        signed_distances(H, pts.data(), pts.size(), sd.mutable_data());
+        return sd;
+    }, py::arg("plane"), py::arg("V"));
+    m.def("_any_plane_above", [](CArray<double> planes, CArray<double> x, double eps){
+        std::vector<std::array<double,4>> rows;
+        copy_column(rows, planes, planes.ndim()==2 ? (size_t)planes.shape(0) : 0, 4, "planes");
+        if(x.ndim()!=1 || x.shape(0)!=3) throw std::runtime_error("x must have shape (3,)");
+        PlaneSoA S;
+        S.assign(rows, [](const std::array<double,4>& r){ return Plane{Vec3{r[0], r[1], r[2]}, r[3]}; });
+        return any_plane_above(S, Vec3{x.at(0), x.at(1), x.at(2)}, eps);
+    }, py::arg("planes"), py::arg("x"), py::arg("eps"));
+    // The fallback cell builder on its own: the polyhedron n·x <= d of the plane rows, each face
+    // tagged with the index of its row
+    m.def("_halfspace_intersection", [](CArray<double> planes, const Config& cfg){
+        std::vector<std::array<double,4>> rows;
+        copy_column(rows, planes, planes.ndim()==2 ? (size_t)planes.shape(0) : 0, 4, "planes");
+        std::vector<PlaneWithTag> H(rows.size());
+        for(size_t k=0; k<rows.size(); ++k) H[k] = { Plane{Vec3{rows[k][0], rows[k][1], rows[k][2]}, rows[k][3]}, (int)k };
+        const Polyhedron P = halfspace_intersection(H, cfg);
+        py::dict d;
+        d["volume"] = polyhedron_volume_centroid(P).first;
+        d["vertices"] = vec3_list_to_numpy(P.V);
+        py::list faces;
+        for(size_t f=0; f<P.num_faces(); ++f){
+            py::list L;
+            for(int v : P.face(f)) L.append(v);
+            faces.append(L);
+        }
+        d["faces"] = faces;
+        d["face_tag"] = std::vector<int>(P.face_tag.begin(), P.face_tag.end());
+        return d;
+    }, py::arg("planes"), py::arg("cfg"));
 }
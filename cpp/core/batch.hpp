@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <future>
+#include "vec.hpp"
+#include "config.hpp"
+#include "lattice.hpp"
+#include "neighbor.hpp"
+#include "tessellate.hpp"
+#include "tessellation_result.hpp"
+#include "parallel.hpp"
+#include "profiling.hpp"
+#include "../containers/box_container.hpp"
+#include "../containers/triclinic_pbc.hpp"
+
+namespace v3d {
+
+// Per-frame, per-atom summaries of a trajectory (row-major F x N), plus the full columnar
+// result of every frame when requested
+struct FrameBatchResult {
+    size_t num_frames = 0, num_atoms = 0;
+    std::vector<double> volume;
+    std::vector<double> surface_area;   // total face area of the cell
+    std::vector<int32_t> num_faces;
+    std::vector<TessellationResult> frames;  // empty unless keep_cells
+};
+
+// Tessellate frames 0..F-1 of N atoms each with a uniform M. make(f) returns the container of
+// frame f. Planning frame f+1 (container + plan_neighbors, serial) runs on a second thread while
+// frame f is tessellated (parallel over atoms, cfg.num_threads).
+template<class MakeContainer>
+inline FrameBatchResult tessellate_frames(size_t F, size_t N, MakeContainer&& make, double M,
+                                          const Config& cfg, bool keep_cells){
+    using Container = decltype(make(size_t{0}));
+    struct Planned { Container c; NeighborTable T; };
+    FrameBatchResult B;
+    B.num_frames = F; B.num_atoms = N;
+    B.volume.assign(F*N, 0.0); B.surface_area.assign(F*N, 0.0); B.num_faces.assign(F*N, 0);
+    if(keep_cells) B.frames.resize(F);
+    if(F == 0) return B;
+    V3D_PROFILE_CONTEXT(caller);
+    auto plan = [&](size_t f){
+        V3D_PROFILE_WORKER(caller);
+        Container c = make(f);
+        NeighborTable T = plan_neighbors(c, cfg);
+        return Planned{std::move(c), std::move(T)};
+    };
+    std::future<Planned> next = std::async(std::launch::async, plan, size_t{0});
+    std::vector<double> Mv;
+    for(size_t f=0; f<F; ++f){
+        Planned cur = next.get();
+        if(f+1 < F) next = std::async(std::launch::async, plan, f+1);
+        Mv.assign(cur.T.size(), M);
+        std::vector<CellResult> cells = tessellate_pairs(cur.c, cur.T, Mv, cfg);
+        parallel_for(cells.size(), cfg.num_threads, [&](size_t k){
+            const CellResult& c = cells[k];
+            if(c.atom_id < 0 || (size_t)c.atom_id >= N) return;
+            const size_t at = f*N + (size_t)c.atom_id;
+            double area = 0.0;
+            for(double a : c.poly.face_area) area += a;
+            B.volume[at] = c.volume;
+            B.surface_area[at] = area;
+            B.num_faces[at] = (int32_t)c.poly.num_faces();
+        });
+        if(keep_cells) B.frames[f] = flatten_cells(cells);
+    }
+    return B;
+}
+
+// Frames of a fixed box; xyz holds F*N*3 doubles (frame-major)
+inline FrameBatchResult tessellate_frames(const BoxBounds& bounds, const double* xyz, size_t F, size_t N,
+                                          double M, const Config& cfg, bool keep_cells = false){
+    return tessellate_frames(F, N, [&](size_t f){
+        BoxContainer box(bounds);
+        box.pos.resize(N);
+        const double* p = xyz + f*N*3;
+        for(size_t i=0; i<N; ++i) box.pos[i] = Vec3{p[3*i], p[3*i+1], p[3*i+2]};
+        return box;
+    }, M, cfg, keep_cells);
+}
+
+// Periodic frames, one lattice per frame (or a single lattice for all frames)
+inline FrameBatchResult tessellate_frames(const std::vector<Lattice>& lattices, std::array<bool,3> periodic,
+                                          const double* xyz, size_t F, size_t N,
+                                          double M, const Config& cfg, bool keep_cells = false){
+    return tessellate_frames(F, N, [&](size_t f){
+        TriclinicPBC pbc(lattices[lattices.size() == 1 ? 0 : f], periodic);
+        pbc.pos.resize(N);
+        const double* p = xyz + f*N*3;
+        for(size_t i=0; i<N; ++i) pbc.pos[i] = Vec3{p[3*i], p[3*i+1], p[3*i+2]};
+        return pbc;
+    }, M, cfg, keep_cells);
+}
+
+} // namespace v3d
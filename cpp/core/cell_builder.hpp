@@ -2,10 +2,14 @@
 #include <vector>
 #include <cstdint>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
 #include "vec.hpp"
 #include "plane.hpp"
+#include "plane_kernels.hpp"
 #include "polyhedron.hpp"
 #include "config.hpp"
+#include "profiling.hpp"
 
 namespace v3d {
 struct CellLocal {
@@ -14,8 +18,266 @@ struct CellLocal {
     std::vector<int> neighbor_index; // index into neighbor table rows producing each face
 };
 
+// Parallelepiped seed: for each axis k the slab lo[k] <= n[k]·x <= hi[k].
+// The lower face is the half-space -n·x <= -lo (tag_lo), the upper one n·x <= hi (tag_hi).
+struct SeedBox {
+    Vec3 n[3] = { Vec3{1,0,0}, Vec3{0,1,0}, Vec3{0,0,1} };
+    double lo[3]{}, hi[3]{};
+    int tag_lo[3] = {-1,-1,-1};
+    int tag_hi[3] = {-1,-1,-1};
+};
+
+inline void seed_planes(const SeedBox& S, std::vector<PlaneWithTag>& out){
+    for(int k=0;k<3;++k){
+        out.push_back({ Plane{S.n[k]*-1.0, -S.lo[k]}, S.tag_lo[k] });
+        out.push_back({ Plane{S.n[k], S.hi[k]}, S.tag_hi[k] });
+    }
+}
+
+// Seed polyhedron of a SeedBox with outward CCW faces, written into P (reusing its buffers).
+// Returns false (P empty) if the normals are degenerate.
+inline bool make_seed(const SeedBox& S, Polyhedron& P){
+    P.clear();
+    double M[3][3] = {
+        {S.n[0].x, S.n[0].y, S.n[0].z},
+        {S.n[1].x, S.n[1].y, S.n[1].z},
+        {S.n[2].x, S.n[2].y, S.n[2].z}
+    };
+    for(int c=0;c<8;++c){
+        double b[3], x[3];
+        for(int k=0;k<3;++k) b[k] = (c>>k & 1) ? S.hi[k] : S.lo[k];
+        if(!solve3x3(M, b, x)){ P.clear(); return false; }
+        P.V.push_back(Vec3{x[0], x[1], x[2]});
+    }
+    for(int k=0;k<3;++k){
+        const int a = (k+1)%3, b = (k+2)%3;
+        for(int side=0; side<2; ++side){
+            const int base = side << k;
+            int loop[4] = { base, base | (1<<a), base | (1<<a) | (1<<b), base | (1<<b) };
+            Vec3 outward = side ? S.n[k] : S.n[k]*-1.0;
+            Vec3 cr = (P.V[(size_t)loop[1]] - P.V[(size_t)loop[0]]).cross(P.V[(size_t)loop[2]] - P.V[(size_t)loop[0]]);
+            if(cr.dot(outward) < 0) std::reverse(loop, loop+4);
+            P.add_face(loop, side ? S.tag_hi[k] : S.tag_lo[k]);
+        }
+    }
+    return true;
+}
+
+inline Polyhedron make_seed(const SeedBox& S){
+    Polyhedron P;
+    make_seed(S, P);
+    return P;
+}
+
+enum class ClipStatus { Unchanged, Clipped, Failed };
+
+// Scratch buffers of clip_by_plane; `next` is swapped with the clipped polyhedron, so after a
+// few calls every buffer has reached its working size and clipping stops allocating.
+struct ClipScratch {
+    struct Cross { int a, b, id; };
+    struct Seg { int from, to; };
+    std::vector<double> sd;
+    std::vector<Cross> crossings;
+    std::vector<Seg> segs;
+    std::vector<int> remap;
+    Polyhedron next;
+};
+
+// Clip a convex polyhedron by the half-space n·x <= d, in place.
+// Faces are clipped polygon by polygon (outward CCW order is preserved); each face crossing the
+// plane contributes one directed edge of the new face, and those edges are chained into the
+// loop that receives `tag`. Vertices within eps of the plane are reused instead of duplicated.
+// Cost is linear in the current size of the polyhedron.
+inline ClipStatus clip_by_plane(Polyhedron& P, const Plane& H, int tag, const Config& cfg, ClipScratch& S){
+    const size_t nv = P.V.size();
+    if(nv == 0) return ClipStatus::Unchanged;
+    const double eps = std::max(1e-9, cfg.eps_pos*10);
+    auto& sd = S.sd;
+    sd.resize(nv);
+    signed_distances(H, P.V.data(), nv, sd.data());
+    bool any_out = false, any_deep = false;
+    for(size_t v=0; v<nv; ++v){
+        if(sd[v] > eps) any_out = true; else if(sd[v] < -eps) any_deep = true;
+    }
+    if(!any_out) return ClipStatus::Unchanged;
+    // nothing, or only a sliver within eps of the plane, is left
+    if(!any_deep){ P.clear(); return ClipStatus::Clipped; }
+
+    auto& crossings = S.crossings;
+    crossings.clear();
+    auto cross = [&](int a, int b)->int { // a inside, b outside
+        if(sd[(size_t)a] >= -eps) return a;
+        for(const auto& c : crossings) if(c.a==a && c.b==b) return c.id;
+        double t = sd[(size_t)a] / (sd[(size_t)a] - sd[(size_t)b]);
+        int id = (int)P.V.size();
+        P.V.push_back(P.V[(size_t)a] + (P.V[(size_t)b] - P.V[(size_t)a]) * t);
+        crossings.push_back({a, b, id});
+        return id;
+    };
+    auto inside = [&](int v){ return (size_t)v >= nv || sd[(size_t)v] <= eps; };
+
+    Polyhedron& Q = S.next;
+    Q.clear();
+    auto& out = Q.face_index;
+    auto& segs = S.segs;
+    segs.clear();
+    for(size_t f=0; f<P.num_faces(); ++f){
+        const auto L = P.face(f);
+        const size_t n = L.size();
+        size_t nout = 0;
+        for(int v : L) if(!inside(v)) ++nout;
+        const int ftag = f < P.face_tag.size() ? P.face_tag[f] : -1;
+        if(nout == n) continue;
+        if(nout == 0){ Q.add_face(L, ftag); continue; }
+        const size_t start = out.size();
+        auto emit = [&](int v){ if(out.size()==start || out.back()!=v) out.push_back(v); };
+        int x_out = -1, x_in = -1;
+        for(size_t k=0; k<n; ++k){
+            const int a = L[k], b = L[(k+1)%n];
+            const bool ain = inside(a), bin = inside(b);
+            if(ain) emit(a);
+            if(ain && !bin){ x_out = cross(a, b); emit(x_out); }
+            if(!ain && bin){ x_in = cross(b, a); emit(x_in); }
+        }
+        while(out.size() > start+1 && out[start]==out.back()) out.pop_back();
+        if(x_out >= 0 && x_in >= 0 && x_out != x_in) segs.push_back({x_in, x_out});
+        if(out.size() >= start+3){ Q.face_offset.push_back((int)out.size()); Q.face_tag.push_back(ftag); }
+        else out.resize(start);
+    }
+    // chain the new face: every clipped face contributes the edge x_in -> x_out. A vertex is
+    // left on each side, so the cut crosses the polyhedron and its loop must close with at
+    // least three edges; fewer means the topology is inconsistent.
+    if(segs.size() < 3) return ClipStatus::Failed;
+    {
+        const size_t start = out.size();
+        int cur = segs[0].from;
+        for(size_t step=0; step<=segs.size(); ++step){
+            out.push_back(cur);
+            int nxt = -1;
+            for(const auto& sg : segs) if(sg.from==cur){ nxt = sg.to; break; }
+            if(nxt < 0) return ClipStatus::Failed;
+            cur = nxt;
+            if(cur == segs[0].from) break;
+        }
+        if(cur != segs[0].from || out.size()-start != segs.size()) return ClipStatus::Failed;
+        Q.face_offset.push_back((int)out.size()); Q.face_tag.push_back(tag);
+    }
+    if(Q.num_faces() < 4){ P.clear(); return ClipStatus::Clipped; }
+
+    // drop vertices that are no longer referenced
+    auto& remap = S.remap;
+    remap.assign(P.V.size(), -1);
+    for(int& v : out){
+        if(remap[(size_t)v] < 0){ remap[(size_t)v] = (int)Q.V.size(); Q.V.push_back(P.V[(size_t)v]); }
+        v = remap[(size_t)v];
+    }
+    std::swap(P, Q);
+    return ClipStatus::Clipped;
+}
+
+inline ClipStatus clip_by_plane(Polyhedron& P, const Plane& H, int tag, const Config& cfg){
+    static thread_local ClipScratch S;
+    return clip_by_plane(P, H, tag, cfg, S);
+}
+
+// Every row is counted once: rows_used + rows_skipped == count
+struct CellStats {
+    int rows_used = 0;    // planes tested against the cell
+    int rows_skipped = 0; // rows without a plane, and planes beyond the security radius (never tested)
+};
+
+// Reusable per-thread state of the cell builders: the cell under construction, clip scratch,
+// the current atom's rows and plane lists. Once warmed up, building a cell does not allocate.
+struct CellWorkspace {
+    Polyhedron poly;
+    ClipScratch clip;
+    std::vector<int> rows;              // neighbor rows of the current atom
+    std::vector<PlaneWithTag> planes;   // caller-provided planes (e.g. caps)
+    std::vector<PlaneWithTag> fallback; // plane list for the halfspace_intersection fallback
+    HalfspaceScratch halfspace;
+};
+
+inline CellWorkspace& thread_workspace(){
+    static thread_local CellWorkspace ws;
+    return ws;
+}
+
+inline double max_vertex_radius2(const Polyhedron& P, const Vec3& c){
+    double R2 = 0.0;
+    for(const auto& v : P.V) R2 = std::max(R2, (v - c).norm2());
+    return R2;
+}
+
+// Clip a seed by planes 0..count-1, produced on demand by plane_at(k, PlaneWithTag&, double& reach)
+// (returning false for rows that yield no plane); the cell is left in ws.poly. `reach` must be
+// a lower bound on the distance from `center` of plane k and of every later plane; once it
+// exceeds the largest vertex distance of the current cell, no remaining plane can cut it and
+// clipping stops (security radius).
+// Face attributes are computed and tiny faces pruned at the end. If the incremental topology
+// ever becomes inconsistent (near-degenerate input), the cell is rebuilt from scratch with
+// halfspace_intersection over the seed planes and all clip planes.
+template<class PlaneAt>
+inline void build_cell(const SeedBox& seed, const Vec3& center, size_t count, PlaneAt&& plane_at,
+                       const Config& cfg, CellWorkspace& ws, CellStats* stats = nullptr){
+    const double eps = std::max(1e-9, cfg.eps_pos*10);
+    V3D_PROFILE_BEGIN(clipping, Clip);
+    Polyhedron& P = ws.poly;
+    bool ok = make_seed(seed, P);
+    double R = std::sqrt(max_vertex_radius2(P, center));
+    CellStats st;
+    size_t k = 0;
+    for(; ok && k<count; ++k){
+        PlaneWithTag H; double reach = 0.0;
+        if(!plane_at(k, H, reach)){ ++st.rows_skipped; continue; }
+        if(reach > R + eps) break;
+        ++st.rows_used;
+        if(H.P.d - H.P.n.dot(center) > R + eps) continue; // this plane alone cannot cut
+        ClipStatus cs = clip_by_plane(P, H.P, H.tag, cfg, ws.clip);
+        if(cs == ClipStatus::Failed) ok = false;
+        else if(cs == ClipStatus::Clipped) R = std::sqrt(max_vertex_radius2(P, center));
+    }
+    st.rows_skipped += (int)(count - std::min(k, count));
+    if(!ok){
+        V3D_PROFILE_COUNT(FallbackCells, 1);
+        auto& all = ws.fallback;
+        all.clear();
+        seed_planes(seed, all);
+        const size_t nseed = all.size();
+        for(size_t q=0; q<count; ++q){
+            PlaneWithTag H; double reach = 0.0;
+            if(plane_at(q, H, reach)) all.push_back(H);
+        }
+        st = CellStats{};
+        st.rows_used = (int)(all.size() - nseed);
+        st.rows_skipped = (int)count - st.rows_used;
+        if(stats) *stats = st;
+        V3D_PROFILE_STOP(clipping);
+        halfspace_intersection(all, cfg, P, ws.halfspace);
+        return;
+    }
+    if(stats) *stats = st;
+    V3D_PROFILE_STOP(clipping);
+    V3D_PROFILE_COUNT(Cells, 1);
+    V3D_PROFILE_COUNT(CellPlanes, st.rows_used);
+    compute_face_attributes(P);
+    prune_tiny_faces(P, cfg);
+}
+
+template<class PlaneAt>
+inline Polyhedron build_cell(const SeedBox& seed, const Vec3& center, size_t count, PlaneAt&& plane_at,
+                             const Config& cfg, CellStats* stats = nullptr){
+    CellWorkspace& ws = thread_workspace();
+    build_cell(seed, center, count, plane_at, cfg, ws, stats);
+    return ws.poly;
+}
+
+// Clip a seed by every plane in turn (no security radius)
+inline Polyhedron build_cell(const SeedBox& seed, const std::vector<PlaneWithTag>& planes, const Config& cfg){
+    return build_cell(seed, Vec3{0,0,0}, planes.size(),
+                      [&](size_t k, PlaneWithTag& H, double& reach){ H = planes[k]; reach = 0.0; return true; }, cfg);
+}
+
 // Build a cell by clipping a seed polyhedron by planes supplied per neighbor row (i.e., per oriented (i,j,image)).
-// NOTE: this is a skeleton; actual clipping will be added in the next drop.
 inline CellLocal build_cell_box_seed(int atom_id,
                                     const Polyhedron& seed,
                                     const std::vector<int>& rows_for_atom,
@@ -33,9 +295,11 @@ inline CellLocal build_cell_box_seed(int atom_id,
         Vec3 n = d; double L = n.norm(); if(L==0) continue; n = n / L;
         Vec3 p = ri[(size_t)atom_id] + d * m;
         Plane H = from_point_normal(p, n);
-        clip_by_plane(C.poly, H, cfg);
-        C.neighbor_index.push_back(row);
+        if(clip_by_plane(C.poly, H, row, cfg) == ClipStatus::Failed){ C.poly.clear(); break; }
     }
+    compute_face_attributes(C.poly);
+    prune_tiny_faces(C.poly, cfg);
+    for(int tag : C.poly.face_tag) C.neighbor_index.push_back(tag);
     return C;
 }
 }
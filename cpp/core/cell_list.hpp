@@ -0,0 +1,136 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "vec.hpp"
+
+namespace v3d {
+
+// Uniform binning of points given in "grid coordinates" u: cartesian for boxes, fractional for
+// lattices. Periodic axes wrap, and visitors report how many periods were crossed (image shift).
+// scale[k] = |du_k/dx| converts a cartesian radius into a grid-coordinate reach along axis k
+// (1 for cartesian axes, norm of the reciprocal vector for fractional ones).
+struct BinGrid {
+    std::array<int,3> n{1,1,1};                 // bins per axis
+    std::array<bool,3> periodic{false,false,false};
+    Vec3 lo{0,0,0};                             // grid-coordinate origin
+    Vec3 width{1,1,1};                          // bin width in grid coordinates
+    Vec3 scale{1,1,1};                          // grid units per cartesian length
+    std::vector<int32_t> start;                 // CSR over bins (size num_bins()+1)
+    std::vector<int32_t> ids;                   // point ids grouped by bin
+    std::vector<std::array<int32_t,3>> bin_of;  // bin triple of each point
+
+    size_t num_bins() const { return (size_t)n[0]*(size_t)n[1]*(size_t)n[2]; }
+    size_t flat(int a, int b, int c) const { return ((size_t)c*(size_t)n[1] + (size_t)b)*(size_t)n[0] + (size_t)a; }
+
+    // Bin-offset half-width along axis k that covers a cartesian radius r
+    int reach(int k, double r) const {
+        double c = std::ceil(r*scale[k]/width[k]);
+        if(!periodic[k]) c = std::min(c, (double)n[k]);
+        return (int)std::min(c, 1e6);
+    }
+
+    // Cartesian radius guaranteed to be fully visited after all rings 0..r around bin b
+    double ring_radius(const std::array<int32_t,3>& b, int r) const {
+        double R = std::numeric_limits<double>::infinity();
+        for(int k=0;k<3;++k){
+            if(!periodic[k] && b[k]-r <= 0 && b[k]+r >= n[k]-1) continue; // axis exhausted
+            R = std::min(R, r*width[k]/scale[k]);
+        }
+        return R;
+    }
+
+    // True once rings 0..r around b cover every bin (non-periodic grids only)
+    bool exhausted(const std::array<int32_t,3>& b, int r) const {
+        for(int k=0;k<3;++k){
+            if(periodic[k]) return false;
+            if(b[k]-r > 0 || b[k]+r < n[k]-1) return false;
+        }
+        return true;
+    }
+
+    // Visit every point in bin b+o, reporting the image shift of the wrapped bin
+    template<class F>
+    void visit_offset(const std::array<int32_t,3>& b, int oa, int ob, int oc, F&& fn) const {
+        int u[3] = { b[0]+oa, b[1]+ob, b[2]+oc };
+        std::array<int32_t,3> shift{0,0,0};
+        for(int k=0;k<3;++k){
+            if(u[k] >= 0 && u[k] < n[k]) continue;
+            if(!periodic[k]) return;
+            int w = (int)std::floor((double)u[k] / (double)n[k]);
+            shift[k] = w; u[k] -= w*n[k];
+        }
+        size_t f = flat(u[0], u[1], u[2]);
+        for(int32_t s = start[f]; s < start[f+1]; ++s) fn(ids[(size_t)s], shift);
+    }
+
+    // Visit all points whose bins lie within the given per-axis offset reach around b
+    template<class F>
+    void visit_block(const std::array<int32_t,3>& b, const std::array<int,3>& c, F&& fn) const {
+        for(int oc=-c[2]; oc<=c[2]; ++oc)
+        for(int ob=-c[1]; ob<=c[1]; ++ob)
+        for(int oa=-c[0]; oa<=c[0]; ++oa) visit_offset(b, oa, ob, oc, fn);
+    }
+
+    // Visit points in the shell of bins at Chebyshev offset exactly r around b
+    template<class F>
+    void visit_ring(const std::array<int32_t,3>& b, int r, F&& fn) const {
+        if(r==0){ visit_offset(b, 0, 0, 0, fn); return; }
+        for(int oc=-r; oc<=r; ++oc)
+        for(int ob=-r; ob<=r; ++ob){
+            const bool face = (oc==-r || oc==r || ob==-r || ob==r);
+            if(face){ for(int oa=-r; oa<=r; ++oa) visit_offset(b, oa, ob, oc, fn); }
+            else { visit_offset(b, -r, ob, oc, fn); visit_offset(b, r, ob, oc, fn); }
+        }
+    }
+};
+
+// Bin points u (grid coordinates within [lo,hi] per axis) with roughly cubic cartesian bins of
+// edge bin_size; the bin count is capped so sparse inputs do not allocate huge empty grids.
+inline BinGrid make_bin_grid(const std::vector<Vec3>& u, const Vec3& lo, const Vec3& hi,
+                             const Vec3& scale, const std::array<bool,3>& periodic, double bin_size){
+    BinGrid G;
+    G.periodic = periodic; G.lo = lo; G.scale = scale;
+    const size_t N = u.size();
+    const size_t max_bins = 4*N + 8;
+    double h = (bin_size > 0 && std::isfinite(bin_size)) ? bin_size : 1.0;
+    for(;;){
+        size_t total = 1;
+        for(int k=0;k<3;++k){
+            double extent = std::max(hi[k]-lo[k], 0.0);
+            double cells = extent / (h*scale[k]);
+            G.n[k] = (int)std::clamp(std::floor(cells), 1.0, 1e6);
+            total *= (size_t)G.n[k];
+        }
+        if(total <= max_bins) break;
+        h *= 1.25;
+    }
+    for(int k=0;k<3;++k){
+        double extent = std::max(hi[k]-lo[k], 0.0);
+        G.width[k] = (extent > 0) ? extent / G.n[k] : 1.0;
+    }
+    G.bin_of.resize(N);
+    G.start.assign(G.num_bins()+1, 0);
+    for(size_t p=0; p<N; ++p){
+        std::array<int32_t,3> b;
+        for(int k=0;k<3;++k){
+            double t = std::floor((u[p][k] - lo[k]) / G.width[k]);
+            b[k] = (int32_t)std::clamp(t, 0.0, (double)(G.n[k]-1));
+        }
+        G.bin_of[p] = b;
+        G.start[G.flat(b[0],b[1],b[2])+1]++;
+    }
+    for(size_t f=0; f<G.num_bins(); ++f) G.start[f+1] += G.start[f];
+    G.ids.resize(N);
+    std::vector<int32_t> fill(G.start.begin(), G.start.end()-1);
+    for(size_t p=0; p<N; ++p){
+        const auto& b = G.bin_of[p];
+        G.ids[(size_t)fill[G.flat(b[0],b[1],b[2])]++] = (int32_t)p;
+    }
+    return G;
+}
+
+} // namespace v3d
@@ -3,6 +3,12 @@
 #include <limits>
 
 namespace v3d {
+// How stitch_global identifies the shared vertices and faces of neighboring cells
+enum class StitchMode {
+    Geometric,    // quantized vertex positions, canonical vertex cycles
+    Topological   // generating planes of vertices, neighbor row / reverse row for faces
+};
+
 struct Config {
     double eps_pos = 1e-10;          // geometric position tolerance
     double eps_angle = 1e-12;        // for normal normalization / parallel checks
@@ -12,5 +18,11 @@ struct Config {
     double min_M = 0.1;              // lower bound for M (0 < min_M < 0.5 ideally)
     double reach_factor = 2.5;       // PBC: R = reach_factor * d_nn
     double neighbor_skin = 1e-8;     // padding for search radius
+
+    // Execution
+    int num_threads = 0;             // threads for per-atom loops (0 = OpenMP default, 1 = serial)
+
+    // Global mesh
+    StitchMode stitch_mode = StitchMode::Geometric;
 };
 }
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "parallel.hpp"
+
+namespace v3d {
+
+inline uint64_t mix64(uint64_t x){
+    x ^= x >> 33; x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+inline uint64_t hash_combine64(uint64_t h, uint64_t v){ return mix64(h ^ (v + 0x9e3779b97f4a7c15ULL + (h<<6) + (h>>2))); }
+
+// For items 0..n-1 with hashes h[k], set rep[k] to the smallest k' whose item equals item k
+// (eq(a,b) compares two items). Items are split into shards by hash and every shard is
+// deduplicated in item order with its own open-addressing table, in parallel; the result is
+// the same for any thread count.
+template<class Eq>
+inline void first_occurrence(const std::vector<uint64_t>& h, Eq&& eq, int num_threads, std::vector<int64_t>& rep){
+    const size_t n = h.size();
+    rep.resize(n);
+    if(n == 0) return;
+    size_t S = 1; while(S < 256 && S*4096 < n) S <<= 1;
+    std::vector<int64_t> start(S+1, 0), items(n);
+    for(size_t k=0; k<n; ++k) start[(size_t)(h[k] >> 40) % S + 1]++;
+    for(size_t s=0; s<S; ++s) start[s+1] += start[s];
+    {
+        std::vector<int64_t> fill(start.begin(), start.end()-1);
+        for(size_t k=0; k<n; ++k) items[(size_t)fill[(size_t)(h[k] >> 40) % S]++] = (int64_t)k;
+    }
+    parallel_for(S, num_threads, [&](size_t s){
+        const size_t b = (size_t)start[s], e = (size_t)start[s+1];
+        size_t cap = 16; while(cap < 2*(e-b)) cap <<= 1;
+        std::vector<int64_t> slot(cap, -1);
+        for(size_t q=b; q<e; ++q){
+            const int64_t k = items[q];
+            for(size_t t = (size_t)h[(size_t)k] & (cap-1);; t = (t+1) & (cap-1)){
+                const int64_t o = slot[t];
+                if(o < 0){ slot[t] = k; rep[(size_t)k] = k; break; }
+                if(h[(size_t)o] == h[(size_t)k] && eq((size_t)o, (size_t)k)){ rep[(size_t)k] = o; break; }
+            }
+        }
+    });
+}
+
+// Dense ids in order of first occurrence: id[k] numbers the distinct items by their first
+// appearance; returns the number of distinct items
+inline int64_t dense_ids(const std::vector<int64_t>& rep, std::vector<int64_t>& id){
+    id.resize(rep.size());
+    int64_t next = 0;
+    for(size_t k=0; k<rep.size(); ++k) id[k] = (rep[k] == (int64_t)k) ? next++ : id[(size_t)rep[k]];
+    return next;
+}
+
+} // namespace v3d
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <functional>
+#include <stdexcept>
+#include "config.hpp"
+#include "neighbor.hpp"
+#include "tessellate.hpp"
+#include "tessellation_result.hpp"
+
+namespace v3d {
+
+// Tessellation that follows sparse changes of M. Row r only shapes the cell of T.i[r], so
+// update() rebuilds just the cells of the changed rows (and of their reverse rows when the
+// update is symmetric), in time proportional to the change. The container and table are held
+// by reference and must outlive this object.
+struct IncrementalTessellation {
+    template<class Container>
+    IncrementalTessellation(const Container& c, const NeighborTable& T, std::vector<double> M, const Config& cfg)
+        : T_(&T), M_(std::move(M)) {
+        if(M_.size() != T.size()) throw std::invalid_argument("M length must equal neighbor table size");
+        build_ = [&c, &T, cfg, A = atom_rows(T, c.pos.size())](const std::vector<double>& M, const int32_t* ids, size_t n, std::vector<CellResult>& out){
+            tessellate_atoms(c, T, A, M, cfg, ids, n, out);
+        };
+        rev_ = has_reverse(T) ? T.rev : reverse_rows(T, cfg.num_threads);
+        std::vector<int32_t> all(c.pos.size());
+        for(size_t i=0; i<all.size(); ++i) all[i] = (int32_t)i;
+        build_(M_, all.data(), all.size(), cells_);
+        volume_.resize(cells_.size());
+        for(size_t i=0; i<cells_.size(); ++i) volume_[i] = cells_[i].volume;
+    }
+
+    // Set M[rows[k]] = values[k] (and M[rev] = 1 - values[k] if symmetric) and rebuild the
+    // affected cells; returns those cells, in ascending atom order. Rows and values are checked
+    // before anything changes, and M is restored if the rebuild throws.
+    TessellationResult update(const std::vector<int64_t>& rows, const std::vector<double>& values, bool symmetric = true){
+        if(rows.size() != values.size()) throw std::invalid_argument("rows and values must have the same length");
+        for(size_t k=0; k<rows.size(); ++k){
+            if(rows[k] < 0 || (size_t)rows[k] >= M_.size()) throw std::out_of_range("row index out of range");
+            if(!std::isfinite(values[k])) throw std::invalid_argument("M values must be finite");
+        }
+        std::vector<std::pair<size_t,double>> old;   // (row, previous M), to undo a failed rebuild
+        std::vector<int32_t> ids;
+        old.reserve(2*rows.size());
+        ids.reserve(2*rows.size());
+        auto set = [&](size_t r, double m){
+            old.push_back({r, M_[r]});
+            M_[r] = m;
+            ids.push_back(T_->i[r]);
+        };
+        for(size_t k=0; k<rows.size(); ++k){
+            const size_t r = (size_t)rows[k];
+            set(r, values[k]);
+            const int64_t q = rev_[r];
+            if(symmetric && q >= 0) set((size_t)q, 1.0 - values[k]);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        std::vector<CellResult> fresh;
+        TessellationResult R;
+        try {
+            build_(M_, ids.data(), ids.size(), fresh);
+            R = flatten_cells(fresh);
+        } catch(...) {
+            for(size_t k=old.size(); k-- > 0;) M_[old[k].first] = old[k].second;
+            throw;
+        }
+        for(size_t k=0; k<ids.size(); ++k){
+            volume_[(size_t)ids[k]] = fresh[k].volume;
+            cells_[(size_t)ids[k]] = std::move(fresh[k]);
+        }
+        rebuilt_ += (int64_t)ids.size();
+        return R;
+    }
+
+    const std::vector<double>& M() const { return M_; }
+    const std::vector<CellResult>& cells() const { return cells_; }
+    const std::vector<double>& volume() const { return volume_; }   // per atom
+    const CellResult& cell(size_t i) const { return cells_[i]; }
+    const std::vector<int64_t>& reverse() const { return rev_; }
+    int64_t cells_rebuilt() const { return rebuilt_; }   // by update(), in total
+
+private:
+    const NeighborTable* T_;
+    std::vector<double> M_;
+    std::vector<int64_t> rev_;
+    std::vector<CellResult> cells_;
+    std::vector<double> volume_;
+    int64_t rebuilt_ = 0;
+    std::function<void(const std::vector<double>&, const int32_t*, size_t, std::vector<CellResult>&)> build_;
+};
+
+} // namespace v3d
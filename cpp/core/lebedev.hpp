@@ -1,60 +1,118 @@
 #pragma once
 #include <vector>
+#include <array>
+#include <map>
+#include <mutex>
 #include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <numbers>
 #include "vec.hpp"
 
 namespace v3d {
 
-// Return a set of (approximately) uniformly distributed unit vectors on S^2.
-// order <= 6: 6-point octahedron
-// order <=14: add cube corners (8)
-// order <=26: add edge midpoints (12) for total 26
-// order  >26: Fibonacci sphere with N=order points
-inline std::vector<Vec3> lebedev_dirs(int order){
+// Unit directions on S^2. Caps only need the directions, so the quadrature weights of the
+// Lebedev tables are not kept.
+struct SphereRule {
     std::vector<Vec3> dirs;
-    if(order<=6){
-        dirs = { {1,0,0},{-1,0,0},{0,1,0},{0,-1,0},{0,0,1},{0,0,-1} };
-        return dirs;
-    }
-    if(order<=14){
-        dirs = { {1,0,0},{-1,0,0},{0,1,0},{0,-1,0},{0,0,1},{0,0,-1} };
-        double s = 1.0/std::sqrt(3.0);
-        int sgn[2]={-1,1};
-        for(int a=0;a<2;a++) for(int b=0;b<2;b++) for(int c=0;c<2;c++){
-            dirs.push_back({ s*sgn[a], s*sgn[b], s*sgn[c] });
-        }
-        return dirs;
+    size_t size() const { return dirs.size(); }
+};
+
+// Octahedral orbits of the Lebedev-Laikov generators: A1 (±1,0,0) 6 points, A2 (0,±s,±s) 12,
+// A3 (±s,±s,±s) 8, B (±a,±a,±c) 24, C (±a,±c,0) 24, D (±a,±b,±c) 48 (c completes unit length)
+enum class LebedevOrbit : uint8_t { A1, A2, A3, B, C, D };
+struct LebedevGenerator { LebedevOrbit orbit; double a = 0, b = 0; };
+
+inline void append_lebedev_orbit(const LebedevGenerator& g, SphereRule& S){
+    auto signs = [&](double x, double y, double z){
+        for(double sx : {1.0, -1.0}){ if(x == 0 && sx < 0) continue;
+        for(double sy : {1.0, -1.0}){ if(y == 0 && sy < 0) continue;
+        for(double sz : {1.0, -1.0}){ if(z == 0 && sz < 0) continue;
+            S.dirs.push_back(Vec3{sx*x, sy*y, sz*z});
+        }}}
+    };
+    const double a = g.a, b = g.b;
+    switch(g.orbit){
+    case LebedevOrbit::A1: signs(1,0,0); signs(0,1,0); signs(0,0,1); break;
+    case LebedevOrbit::A2: { const double s = std::sqrt(0.5); signs(0,s,s); signs(s,0,s); signs(s,s,0); break; }
+    case LebedevOrbit::A3: { const double s = std::sqrt(1.0/3.0); signs(s,s,s); break; }
+    case LebedevOrbit::B:  { const double c = std::sqrt(1 - 2*a*a); signs(a,a,c); signs(a,c,a); signs(c,a,a); break; }
+    case LebedevOrbit::C:  { const double c = std::sqrt(1 - a*a); signs(a,c,0); signs(c,a,0); signs(a,0,c); signs(c,0,a); signs(0,a,c); signs(0,c,a); break; }
+    case LebedevOrbit::D:  { const double c = std::sqrt(1 - a*a - b*b); signs(a,b,c); signs(a,c,b); signs(b,a,c); signs(b,c,a); signs(c,a,b); signs(c,b,a); break; }
     }
-    if(order<=26){
-        dirs = { {1,0,0},{-1,0,0},{0,1,0},{0,-1,0},{0,0,1},{0,0,-1} };
-        double s2 = 1.0/std::sqrt(2.0);
-        int sgn[2]={-1,1};
-        for(int a=0;a<2;a++) for(int b=0;b<2;b++){
-            dirs.push_back({ s2*sgn[a], s2*sgn[b], 0 });
-            dirs.push_back({ s2*sgn[a], 0, s2*sgn[b] });
-            dirs.push_back({ 0, s2*sgn[a], s2*sgn[b] });
+}
+
+// Point counts of the tabulated Lebedev grids (exact for polynomials up to degree 3..23)
+constexpr std::array<int,11> kLebedevSizes{6, 14, 26, 38, 50, 74, 86, 110, 146, 170, 194};
+
+// Lebedev grid with exactly `points` points (one of kLebedevSizes), built once
+inline const SphereRule& lebedev_rule(int points){
+    using O = LebedevOrbit;
+    static const std::array<SphereRule, kLebedevSizes.size()> rules = []{
+        const std::vector<LebedevGenerator> gens[kLebedevSizes.size()] = {
+            {{O::A1}},
+            {{O::A1}, {O::A3}},
+            {{O::A1}, {O::A2}, {O::A3}},
+            {{O::A1}, {O::A3},
+             {O::C,0.4597008433809831}},
+            {{O::A1}, {O::A2}, {O::A3},
+             {O::B,0.3015113445777636}},
+            {{O::A1}, {O::A2}, {O::A3},
+             {O::B,0.4803844614152614}, {O::C,0.3207726489807764}},
+            {{O::A1}, {O::A3},
+             {O::B,0.3696028464541502}, {O::B,0.6943540066026664},
+             {O::C,0.3742430390903412}},
+            {{O::A1}, {O::A3},
+             {O::B,0.1851156353447362}, {O::B,0.6904210483822922},
+             {O::B,0.3956894730559419}, {O::C,0.4783690288121502}},
+            {{O::A1}, {O::A2}, {O::A3},
+             {O::B,0.6764410400114264}, {O::B,0.4174961227965453},
+             {O::B,0.1574676672039082}, {O::D,0.1403553811713183,0.4493328323269557}},
+            {{O::A1}, {O::A2}, {O::A3},
+             {O::B,0.2551252621114134}, {O::B,0.6743601460362766},
+             {O::B,0.4318910696719410}, {O::C,0.2613931360335988},
+             {O::D,0.4990453161796037,0.1446630744325115}},
+            {{O::A1}, {O::A2}, {O::A3},
+             {O::B,0.6712973442695226}, {O::B,0.2892465627575439},
+             {O::B,0.4446933178717437}, {O::B,0.1299335447650067},
+             {O::C,0.3457702197611283}, {O::D,0.1590417105383530,0.8360360154824589}},
+        };
+        std::array<SphereRule, kLebedevSizes.size()> R;
+        for(size_t g=0; g<R.size(); ++g){
+            R[g].dirs.reserve((size_t)kLebedevSizes[g]);
+            for(const auto& G : gens[g]) append_lebedev_orbit(G, R[g]);
         }
-        double s3 = 1.0/std::sqrt(3.0);
-        for(int a=0;a<2;a++) for(int b=0;b<2;b++) for(int c=0;c<2;c++){
-            dirs.push_back({ s3*sgn[a], s3*sgn[b], s3*sgn[c] });
+        return R;
+    }();
+    const auto it = std::find(kLebedevSizes.begin(), kLebedevSizes.end(), points);
+    return rules[(size_t)(it == kLebedevSizes.end() ? 0 : it - kLebedevSizes.begin())];
+}
+
+// Fibonacci sphere of N points, built once per N
+inline const SphereRule& fibonacci_rule(int N){
+    static std::mutex mu;
+    static std::map<int, SphereRule> cache;   // node-based: references stay valid
+    std::lock_guard<std::mutex> lock(mu);
+    SphereRule& S = cache[N];
+    if(S.dirs.empty() && N > 0){
+        const double phi = (1.0 + std::sqrt(5.0)) * 0.5;
+        const double ga = 2.0 * std::numbers::pi * (1.0 - 1.0/phi); // golden angle
+        S.dirs.reserve((size_t)N);
+        for(int k=0; k<N; ++k){
+            double z = 1.0 - 2.0*((k + 0.5) / (double)N);
+            double r = std::sqrt(std::max(0.0, 1.0 - z*z));
+            S.dirs.push_back(Vec3{r*std::cos(ga*k), r*std::sin(ga*k), z});
         }
-        return dirs;
     }
-    // Fibonacci sphere
-    const int N = order;
-    dirs.reserve(N);
-    const double phi = (1.0 + std::sqrt(5.0)) * 0.5; // golden ratio
-    const double ga = 2.0 * M_PI * (1.0 - 1.0/phi); // golden angle
-    for(int k=0; k<N; ++k){
-        double z = 1.0 - 2.0*((k + 0.5)/ (double)N);
-        double r = std::sqrt(std::max(0.0, 1.0 - z*z));
-        double theta = ga * k;
-        double x = r * std::cos(theta);
-        double y = r * std::sin(theta);
-        // already unit length by construction
-        dirs.push_back(Vec3{x,y,z});
-    }
-    return dirs;
+    return S;
+}
+
+// Directions for `order` requested points: the smallest Lebedev grid with at least that many
+// (6..194), or a Fibonacci sphere of exactly `order` points beyond. Tables are cached, so the
+// returned reference stays valid for the life of the program.
+inline const std::vector<Vec3>& lebedev_dirs(int order){
+    for(int n : kLebedevSizes) if(order <= n) return lebedev_rule(n).dirs;
+    return fibonacci_rule(order).dirs;
 }
 
 } // namespace v3d
@@ -1,11 +1,17 @@
 #pragma once
+#include <array>
 #include <vector>
 #include <unordered_map>
 #include <algorithm>
 #include <tuple>
+#include <cstdint>
+#include <limits>
 #include "vec.hpp"
 #include "polyhedron.hpp"
+#include "dedup.hpp"
+#include "parallel.hpp"
 #include "neighbor.hpp"
+#include "profiling.hpp"
 #include "../containers/box_container.hpp"
 #include "../containers/triclinic_pbc.hpp"
 
@@ -53,132 +59,427 @@ inline Vec3Key key_of(const Vec3& v, double q){
     return Vec3Key{ (long long)std::llround(v.x/q), (long long)std::llround(v.y/q), (long long)std::llround(v.z/q) };
 }
 
-inline GlobalMesh stitch_global(const NeighborTable& T,
+// Canonical cycle of loop[0..n) written to out (rotation to the smallest id, direction with the
+// lexicographically smaller continuation), matching canonical_cycle()
+inline void canonical_cycle_into(const int* loop, size_t n, int* out){
+    size_t mini = 0;
+    for(size_t k=1;k<n;k++) if(loop[k] < loop[mini]) mini = k;
+    bool rev = false;
+    for(size_t t=1;t<n;t++){
+        const int a = loop[(mini + t)%n], b = loop[(mini + n - t)%n];
+        if(a != b){ rev = b < a; break; }
+    }
+    for(size_t t=0;t<n;t++) out[t] = rev ? loop[(mini + n - t)%n] : loop[(mini + t)%n];
+}
+
+// Offsets of each cell's vertices, faces and face indices in the concatenation over all cells
+struct CellLayout {
+    std::vector<int64_t> voff{0}, foff{0}, ioff{0};
+};
+
+inline CellLayout cell_layout(const std::vector<Polyhedron>& cell_polys){
+    CellLayout L;
+    const size_t C = cell_polys.size();
+    L.voff.resize(C+1); L.foff.resize(C+1); L.ioff.resize(C+1);
+    for(size_t ci=0; ci<C; ++ci){
+        L.voff[ci+1] = L.voff[ci] + (int64_t)cell_polys[ci].V.size();
+        L.foff[ci+1] = L.foff[ci] + (int64_t)cell_polys[ci].num_faces();
+        L.ioff[ci+1] = L.ioff[ci] + (int64_t)cell_polys[ci].face_index.size();
+    }
+    return L;
+}
+
+inline uint64_t hash_key3(const Vec3Key& k){
+    return hash_combine64(hash_combine64(mix64((uint64_t)k.x), (uint64_t)k.y), (uint64_t)k.z);
+}
+
+// Geometric vertex identity: rep[k] is the first vertex instance with the same quantized position
+inline void quantized_vertex_reps(const std::vector<Polyhedron>& cell_polys, const CellLayout& L,
+                                  double q, int nt, std::vector<int64_t>& rep){
+    std::vector<Vec3Key> vkey((size_t)L.voff.back());
+    std::vector<uint64_t> vh(vkey.size());
+    parallel_for(cell_polys.size(), nt, [&](size_t ci){
+        const auto& P = cell_polys[ci];
+        for(size_t lv=0; lv<P.V.size(); ++lv){
+            const size_t g = (size_t)L.voff[ci] + lv;
+            vkey[g] = key_of(P.V[lv], q);
+            vh[g] = hash_key3(vkey[g]);
+        }
+    });
+    first_occurrence(vh, [&](size_t a, size_t b){ return vkey[a].x==vkey[b].x && vkey[a].y==vkey[b].y && vkey[a].z==vkey[b].z; }, nt, rep);
+}
+
+// Generator behind each face (index into the concatenated faces), packed into 64 bits: atom j
+// with image img for a neighbor row (j = the cell's own atom, img = ±unit for a self-image
+// plane), or a box wall tag. Any other face (caps, walls of non-periodic axes, images beyond
+// ±511) belongs to its cell alone and gets a generator no other cell has.
+using FaceGen = uint64_t;
+
+inline FaceGen atom_generator(int32_t j, const std::array<int32_t,3>& img){
+    uint64_t g = (uint64_t)(uint32_t)j << 30;
+    for(int k=0; k<3; ++k) g |= (uint64_t)(uint32_t)(img[(size_t)k] + 512) << (20 - 10*k);
+    return g;
+}
+constexpr uint64_t kImageMask = ((uint64_t)1 << 30) - 1;
+constexpr uint64_t kImageZero = (uint64_t)512 << 20 | (uint64_t)512 << 10 | 512;
+inline FaceGen wall_generator(int tag){ return (uint64_t)1 << 62 | (uint32_t)tag; }
+inline FaceGen own_generator(size_t ci, size_t f){ return (uint64_t)2 << 62 | (uint64_t)(uint32_t)ci << 30 | (uint32_t)f; }
+
+template<class Real, bool Half>
+inline std::vector<FaceGen> face_generators(const BasicNeighborTable<Real,Half>& T, const std::vector<Polyhedron>& cell_polys,
+                                            const std::vector<int>& atom_ids, const CellLayout& L, int nt){
+    std::vector<FaceGen> gen((size_t)L.foff.back());
+    parallel_for(cell_polys.size(), nt, [&](size_t ci){
+        const auto& P = cell_polys[ci];
+        for(size_t f=0; f<P.num_faces(); ++f){
+            const int tag = f < P.face_tag.size() ? P.face_tag[f] : -1;
+            FaceGen& g = gen[(size_t)L.foff[ci] + f];
+            g = own_generator(ci, f);
+            if(tag >= 0 && (size_t)tag < oriented_rows(T) && row_i(T, (size_t)tag) == atom_ids[ci]){
+                const auto m = row_img(T, (size_t)tag);
+                if(std::max({std::abs(m[0]), std::abs(m[1]), std::abs(m[2])}) < 512) g = atom_generator(row_j(T, (size_t)tag), m);
+            } else if(tag <= -1000 && tag > -1006){
+                g = wall_generator(tag);
+            } else if(tag <= -2000 && tag > -2006){
+                std::array<int32_t,3> m{0,0,0};
+                m[(size_t)(-2000 - tag)/2] = ((-2000 - tag) % 2) ? 1 : -1;
+                g = atom_generator(atom_ids[ci], m);
+            }
+        }
+    });
+    return gen;
+}
+
+// Partner of every face or -1: the face of cell i tagged with row r (j, img 0) pairs with the
+// face of cell j tagged with the reverse row of r. Periodic images do not pair, so copies of a
+// cell stay apart.
+template<class Real, bool Half>
+inline std::vector<int64_t> pair_faces(const BasicNeighborTable<Real,Half>& T, const std::vector<Polyhedron>& cell_polys,
+                                       const std::vector<int>& atom_ids, const CellLayout& L,
+                                       const std::vector<FaceGen>& gen, int nt){
+    std::vector<int64_t> rev_local;
+    const std::vector<int64_t>* rev = &T.rev;
+    if constexpr (!Half) if(T.rev.size() != T.size()){ rev_local = reverse_rows(T, nt); rev = &rev_local; }
+    int max_id = -1;
+    for(int a : atom_ids) max_id = std::max(max_id, a);
+    std::vector<int64_t> cell_of((size_t)(max_id+1), -1);
+    for(size_t ci=0; ci<atom_ids.size(); ++ci) if(atom_ids[ci] >= 0 && cell_of[(size_t)atom_ids[ci]] < 0) cell_of[(size_t)atom_ids[ci]] = (int64_t)ci;
+    // tags of all faces in one array, so a cell's faces are scanned without touching its polyhedron
+    std::vector<int> ftag((size_t)L.foff.back(), -1);
+    parallel_for(cell_polys.size(), nt, [&](size_t ci){
+        const auto& P = cell_polys[ci];
+        for(size_t f=0; f<P.num_faces() && f<P.face_tag.size(); ++f) ftag[(size_t)L.foff[ci] + f] = P.face_tag[f];
+    });
+    std::vector<int64_t> partner(ftag.size(), -1);
+    parallel_for(cell_polys.size(), nt, [&](size_t ci){
+        for(int64_t g=L.foff[ci]; g<L.foff[ci+1]; ++g){
+            // gen holds (j, img) of the face's row, if it is a row of this cell's atom
+            const int tag = ftag[(size_t)g];
+            const int32_t j = (int32_t)(uint32_t)(gen[(size_t)g] >> 30);
+            if(tag < 0 || gen[(size_t)g] >> 62 || (gen[(size_t)g] & kImageMask) != kImageZero || j == atom_ids[ci]) continue;
+            if(j < 0 || j > max_id || cell_of[(size_t)j] < 0) continue;
+            int64_t rr;
+            if constexpr (Half) rr = (int64_t)((size_t)tag ^ 1);
+            else rr = (*rev)[(size_t)tag];
+            if(rr < 0) continue;
+            const size_t cj = (size_t)cell_of[(size_t)j];
+            for(int64_t h=L.foff[cj]; h<L.foff[cj+1]; ++h)
+                if(ftag[(size_t)h] == (int)rr){ partner[(size_t)g] = h; break; }
+        }
+    });
+    // keep mutual pairs only
+    std::vector<int64_t> mutual(partner.size(), -1);
+    parallel_for(partner.size(), nt, [&](size_t g){
+        const int64_t h = partner[g];
+        if(h >= 0 && partner[(size_t)h] == (int64_t)g) mutual[g] = h;
+    });
+    return mutual;
+}
+
+// Topological vertex identity. A vertex where exactly three faces meet is keyed by its
+// generators: the cell's atom plus the generator behind each face; its copies in the
+// neighboring cells have the same generator set. Degenerate vertices (other face counts) start
+// out alone and are joined through the paired faces they lie on: the two copies of a face are
+// the same cycle in opposite directions, aligned on the vertices they already share. Only a
+// face with no shared vertex at all (a fully degenerate lattice) is aligned by the rotation that
+// brings its vertices closest; no position tolerance is used. Aligned vertices are joined only
+// if their generator sets agree: where they do not (a wall of a non-periodic PBC axis is an own
+// generator of each cell, so the two copies of a face can differ in shape) the face is left
+// unpaired. rep[k] is the first instance of k's vertex.
+inline void topological_vertex_reps(const std::vector<Polyhedron>& cell_polys, const std::vector<int>& atom_ids,
+                                    const CellLayout& L, const std::vector<FaceGen>& gen,
+                                    const std::vector<int64_t>& partner, int nt, std::vector<int64_t>& rep){
+    const size_t NV = (size_t)L.voff.back();
+    std::vector<std::array<FaceGen,4>> gkey(NV);   // the cell's own atom and the three generators, sorted
+    std::vector<uint8_t> topo(NV, 0);
+    std::vector<uint64_t> vh(NV), vset(NV);        // vset: hash sum of all the generators
+    parallel_for(cell_polys.size(), nt, [&](size_t ci){
+        const auto& P = cell_polys[ci];
+        thread_local std::vector<int> cnt;
+        cnt.assign(P.V.size(), 0);
+        for(size_t f=0; f<P.num_faces(); ++f){
+            const FaceGen& fg = gen[(size_t)L.foff[ci] + f];
+            for(int lv : P.face(f)){
+                const size_t g = (size_t)L.voff[ci] + (size_t)lv;
+                if(cnt[(size_t)lv] < 3) gkey[g][(size_t)cnt[(size_t)lv] + 1] = fg;
+                cnt[(size_t)lv]++;
+                vset[g] += mix64(fg);
+            }
+        }
+        for(size_t lv=0; lv<P.V.size(); ++lv){
+            const size_t g = (size_t)L.voff[ci] + lv;
+            std::array<FaceGen,4>& k = gkey[g];
+            k[0] = atom_generator(atom_ids[ci], {0,0,0});
+            vset[g] += mix64(k[0]);
+            if(cnt[lv] == 3){
+                std::sort(k.begin(), k.end());
+                uint64_t hh = mix64(1);
+                for(FaceGen e : k) hh = hash_combine64(hh, e);
+                topo[g] = 1; vh[g] = hh;
+            } else {
+                vh[g] = mix64((uint64_t)g);
+            }
+        }
+    });
+    first_occurrence(vh, [&](size_t a, size_t b){ return topo[a] && topo[b] && gkey[a] == gkey[b]; }, nt, rep);
+
+    // Paired faces must reference the same vertices (compared as multisets by a hash sum);
+    // collect the ones that do not
+    std::vector<uint64_t> sig(partner.size());
+    parallel_for(cell_polys.size(), nt, [&](size_t ci){
+        const auto& P = cell_polys[ci];
+        for(size_t f=0; f<P.num_faces(); ++f){
+            const size_t g = (size_t)L.foff[ci] + f;
+            if(partner[g] < 0) continue;
+            uint64_t sum = mix64(P.face(f).size());
+            for(int lv : P.face(f)) sum += mix64((uint64_t)rep[(size_t)(L.voff[ci] + lv)]);
+            sig[g] = sum;
+        }
+    });
+    std::vector<int64_t> todo;
+    for(size_t g=0; g<partner.size(); ++g)
+        if(partner[g] > (int64_t)g && sig[g] != sig[(size_t)partner[g]]) todo.push_back((int64_t)g);
+    if(todo.empty()) return;
+    auto face_at = [&](int64_t g){   // (cell, local face)
+        const size_t ci = (size_t)(std::upper_bound(L.foff.begin(), L.foff.end(), g) - L.foff.begin()) - 1;
+        return std::pair<size_t,size_t>{ci, (size_t)(g - L.foff[ci])};
+    };
+
+    // union by smallest instance, so every root stays the first instance of its set
+    std::vector<int64_t> parent = rep;
+    auto find = [&](int64_t x){
+        while(parent[(size_t)x] != x){ parent[(size_t)x] = parent[(size_t)parent[(size_t)x]]; x = parent[(size_t)x]; }
+        return x;
+    };
+    // Align face ga with its partner gb (vertex a[t] is b[s-t]) and join the aligned vertices,
+    // unless a pair not yet joined has different generator sets (then nothing is joined).
+    // Returns false if there is nothing to align on yet (no shared vertex, closest not allowed).
+    std::vector<int> votes;
+    auto align = [&](int64_t ga, int64_t gb, bool closest){
+        const auto [ca, fa] = face_at(ga);
+        const auto [cb, fb] = face_at(gb);
+        const auto& A = cell_polys[ca]; const auto& B = cell_polys[cb];
+        const auto a = A.face(fa); const auto b = B.face(fb);
+        const size_t n = a.size();
+        if(n != b.size() || n < 3) return true;   // different cycles: nothing to join
+        votes.assign(n, 0);
+        for(size_t t=0; t<n; ++t)
+            for(size_t u=0; u<n; ++u)
+                if(find(L.voff[ca] + a[t]) == find(L.voff[cb] + b[u])) votes[(t+u)%n]++;
+        size_t s = (size_t)(std::max_element(votes.begin(), votes.end()) - votes.begin());
+        if(votes[s] == 0){
+            if(!closest) return false;
+            double best = std::numeric_limits<double>::infinity();
+            for(size_t c=0; c<n; ++c){
+                double d = 0.0;
+                for(size_t t=0; t<n; ++t) d += (A.V[(size_t)a[t]] - B.V[(size_t)b[(c + n - t)%n]]).norm2();
+                if(d < best){ best = d; s = c; }
+            }
+        }
+        for(size_t t=0; t<n; ++t){
+            const int64_t va = L.voff[ca] + a[t], vb = L.voff[cb] + b[(s + n - t)%n];
+            if(vset[(size_t)va] != vset[(size_t)vb] && find(va) != find(vb)) return true;
+        }
+        for(size_t t=0; t<n; ++t){
+            const int64_t x = find(L.voff[ca] + a[t]), y = find(L.voff[cb] + b[(s + n - t)%n]);
+            if(x != y) parent[(size_t)std::max(x,y)] = std::min(x,y);
+        }
+        return true;
+    };
+    // faces sharing a vertex first (repeatedly, as joins create shared vertices), then the rest
+    bool closest = false;
+    while(!todo.empty()){
+        std::vector<int64_t> left;
+        for(int64_t g : todo) if(!align(g, partner[(size_t)g], closest)) left.push_back(g);
+        closest = left.size() == todo.size();
+        todo.swap(left);
+    }
+    for(size_t k=0; k<NV; ++k) rep[k] = find((int64_t)k);
+}
+
+// Stitch per-cell polyhedra into one mesh and extract its edges. cfg.stitch_mode selects how
+// the copies of a shared vertex/face are identified:
+//  - Geometric: vertices by quantized position (~100*eps_pos), faces by canonical vertex cycle;
+//  - Topological: vertices by generating planes (see topological_vertex_reps), faces by
+//    neighbor row and reverse row (T.rev; row r^1 of a half table). No quantization.
+// Every pass runs in parallel over cells/faces (cfg.num_threads) with sharded open-addressing
+// tables; ids are assigned in order of first occurrence (cell order, then local order), so the
+// mesh is identical for any thread count. Face tags are oriented rows of T (see row_i).
+template<class Real, bool Half>
+inline GlobalMesh stitch_global(const BasicNeighborTable<Real,Half>& T,
                                 const std::vector<Polyhedron>& cell_polys,
                                 const std::vector<int>& atom_ids,
                                 const std::vector<double>& volumes,
                                 const std::vector<Vec3>& cell_centroids,
                                 const std::vector<Vec3>& atom_pos,
                                 const Config& cfg){
+    (void)atom_pos;
+    V3D_PROFILE_SCOPE(Stitch);
     GlobalMesh G;
     const double q = std::max(1e-9, cfg.eps_pos*100);
+    const int nt = cfg.num_threads;
+    const bool topological = cfg.stitch_mode == StitchMode::Topological;
+    const size_t C = cell_polys.size();
+    const CellLayout L = cell_layout(cell_polys);
+    const auto& voff = L.voff; const auto& foff = L.foff; const auto& ioff = L.ioff;
+    std::vector<int64_t> rep, id, partner;
+
     // 1) Vertex dedup
-    std::unordered_map<long long, int> vmap; vmap.reserve(16384);
-    auto pack3 = [](long long a, long long b, long long c)->long long{ return ((a & 0x7fffff)<<42) ^ ((b & 0x7fffff)<<21) ^ (c & 0x7fffff); };
-    std::vector<std::vector<int>> local2global(cell_polys.size());
-    for(size_t ci=0; ci<cell_polys.size(); ++ci){
+    if(topological){
+        const std::vector<FaceGen> gen = face_generators(T, cell_polys, atom_ids, L, nt);
+        partner = pair_faces(T, cell_polys, atom_ids, L, gen, nt);
+        topological_vertex_reps(cell_polys, atom_ids, L, gen, partner, nt, rep);
+    } else {
+        quantized_vertex_reps(cell_polys, L, q, nt, rep);
+    }
+    std::vector<int64_t> vid;
+    G.vertices.resize((size_t)dense_ids(rep, vid));
+    parallel_for(C, nt, [&](size_t ci){
         const auto& P = cell_polys[ci];
-        auto& L2G = local2global[ci];
-        L2G.resize(P.V.size(), -1);
         for(size_t lv=0; lv<P.V.size(); ++lv){
-            Vec3Key k = key_of(P.V[lv], q);
-            long long h = pack3(k.x, k.y, k.z);
-            auto it = vmap.find(h);
-            if(it == vmap.end()){
-                int gid = (int)G.vertices.size();
-                G.vertices.push_back(P.V[lv]);
-                vmap.emplace(h, gid);
-                L2G[lv] = gid;
-            }else{
-                L2G[lv] = it->second;
-            }
+            const size_t g = (size_t)voff[ci] + lv;
+            if(rep[g] == (int64_t)g) G.vertices[(size_t)vid[g]] = P.V[lv];
         }
-    }
-    // 2) Face dedup using canonical vertex cycles
-    struct FaceKeyHash {
-        size_t operator()(const std::vector<int>& v) const noexcept {
-            size_t h=1469598103934665603ull;
-            for(int x : v){ h ^= (size_t)x; h *= 1099511628211ull; }
-            return h;
+    });
+
+    // 2) Face dedup by canonical cycle of global vertex ids (Geometric) or by pairing (Topological)
+    const size_t NF = (size_t)foff[C];
+    std::vector<int> cyc((size_t)ioff[C]);
+    std::vector<int64_t> cstart(NF);
+    std::vector<int> clen(NF, 0);
+    std::vector<uint64_t> fh(NF, 0);
+    parallel_for(C, nt, [&](size_t ci){
+        const auto& P = cell_polys[ci];
+        std::vector<int> gl;
+        int64_t pos = ioff[ci];
+        for(size_t f=0; f<P.num_faces(); ++f){
+            const size_t g = (size_t)foff[ci] + f;
+            gl.clear();
+            for(int lv : P.face(f)){
+                const int v = (int)vid[(size_t)voff[ci] + (size_t)lv];
+                if(gl.empty() || gl.back()!=v) gl.push_back(v);
+            }
+            if(gl.size()>=3 && gl.front()==gl.back()) gl.pop_back();
+            cstart[g] = pos;
+            if(gl.size() >= 3){
+                int* out = &cyc[(size_t)pos];
+                canonical_cycle_into(gl.data(), gl.size(), out);
+                clen[g] = (int)gl.size();
+                uint64_t hh = mix64((uint64_t)clen[g]);
+                for(size_t t=0; t<gl.size(); ++t) hh = hash_combine64(hh, (uint64_t)(uint32_t)out[t]);
+                fh[g] = hh;
+            }
+            pos += (int64_t)P.face(f).size();
         }
+    });
+    // faces are equal when their canonical cycles are (the hash only picks the bucket)
+    auto same_cycle = [&](size_t a, size_t b){
+        return clen[a] == clen[b] && std::equal(cyc.begin() + cstart[a], cyc.begin() + cstart[a] + clen[a], cyc.begin() + cstart[b]);
     };
-    struct FaceKeyEq {
-        bool operator()(const std::vector<int>& a, const std::vector<int>& b) const noexcept {
-            return a==b;
+    if(topological){
+        rep.resize(NF);
+        // copies whose cycles still differ (a degenerate vertex resolved differently) stay apart
+        for(size_t g=0; g<NF; ++g){
+            const int64_t h = partner[g];
+            rep[g] = (h >= 0 && same_cycle(g, (size_t)h)) ? std::min((int64_t)g, h) : (int64_t)g;
         }
-    };
-    std::unordered_map<std::vector<int>, int, FaceKeyHash, FaceKeyEq> fmap;
-    for(size_t ci=0; ci<cell_polys.size(); ++ci){
+    } else {
+        first_occurrence(fh, same_cycle, nt, rep);
+    }
+    // faces too short after merging vertices are dropped; they take no id
+    std::vector<int64_t> fid(NF, -1);
+    int64_t nfaces = 0;
+    for(size_t g=0; g<NF; ++g){
+        if(clen[(size_t)rep[g]] < 3) continue;
+        fid[g] = (rep[g] == (int64_t)g) ? nfaces++ : fid[(size_t)rep[g]];
+    }
+    G.faces.resize((size_t)nfaces);
+    G.cells.resize(C);
+    parallel_for(C, nt, [&](size_t ci){
         const auto& P = cell_polys[ci];
-        GlobalMeshCell cell;
+        GlobalMeshCell& cell = G.cells[ci];
         cell.atom_id = atom_ids[ci];
         cell.volume = volumes[ci];
         cell.centroid = cell_centroids[ci];
-        for(size_t f=0; f<P.F.size(); ++f){
-            std::vector<int> gl;
-            gl.reserve(P.F[f].size());
-            for(int lv : P.F[f]) gl.push_back(local2global[ci][(size_t)lv]);
-            std::vector<int> gl2; gl2.reserve(gl.size());
-            for(size_t k=0;k<gl.size();++k){ if(k==0 || gl[k]!=gl[k-1]) gl2.push_back(gl[k]); }
-            if(gl2.size()>=3 && gl2.front()==gl2.back()) gl2.pop_back();
-            if(gl2.size()<3) continue;
-            auto canon = canonical_cycle(gl2);
-            int fid;
-            auto it = fmap.find(canon);
-            if(it==fmap.end()){
-                fid = (int)G.faces.size();
-                GlobalMeshFace Fg;
-                Fg.loop = canon;
-                int tag = (f < (int)P.face_tag.size()) ? P.face_tag[f] : -1;
-                if(tag>=0){
-                    int ii = atom_ids[ci];
-                    int jj = T.j[(size_t)tag];
-                    Fg.i = ii; Fg.j = jj;
-                    Fg.img = T.img[(size_t)tag];
-                    Vec3 dir = T.disp[(size_t)tag]; double L = dir.norm(); if(L>0) dir = dir / L; else dir = Vec3{0,0,1};
-                    // area & centroid from local attributes if present
-                    if(f < P.face_area.size()) Fg.area = P.face_area[f];
-                    if(f < P.face_centroid.size()) Fg.centroid = P.face_centroid[f];
-                    // orient loop to align with dir
-                    // compute simple normal via Newell on global vertices
-                    Vec3 n{0,0,0};
-                    for(size_t k=0;k<canon.size();++k){
-                        const Vec3& a = G.vertices[canon[k]];
-                        const Vec3& b = G.vertices[canon[(k+1)%canon.size()]];
-                        n.x += (a.y - b.y) * (a.z + b.z);
-                        n.y += (a.z - b.z) * (a.x + b.x);
-                        n.z += (a.x - b.x) * (a.y + b.y);
-                    }
-                    double Ln = n.norm();
-                    Vec3 nu = (Ln>0)? n/Ln : Vec3{0,0,1};
-                    if(nu.dot(dir) < 0){
-                        std::reverse(Fg.loop.begin(), Fg.loop.end());
-                    }
-                    Fg.normal_ij = dir;
-                } else {
-                    Fg.i = atom_ids[ci]; Fg.j = -1;
-                    Fg.img = {0,0,0};
-                    if(f < P.face_area.size()) Fg.area = P.face_area[f];
-                    if(f < P.face_centroid.size()) Fg.centroid = P.face_centroid[f];
-                    Fg.normal_ij = Vec3{0,0,1};
+        for(size_t f=0; f<P.num_faces(); ++f){
+            const size_t g = (size_t)foff[ci] + f;
+            if(fid[g] < 0) continue;
+            cell.face_ids.push_back((int)fid[g]);
+            if(rep[g] != (int64_t)g) continue;
+            GlobalMeshFace& Fg = G.faces[(size_t)fid[g]];
+            Fg.loop.assign(cyc.begin() + cstart[g], cyc.begin() + cstart[g] + clen[g]);
+            if(f < P.face_area.size()) Fg.area = P.face_area[f];
+            if(f < P.face_centroid.size()) Fg.centroid = P.face_centroid[f];
+            int tag = (f < P.face_tag.size()) ? P.face_tag[f] : -1;
+            if(tag>=0){
+                Fg.i = atom_ids[ci];
+                Fg.j = row_j(T, (size_t)tag);
+                Fg.img = row_img(T, (size_t)tag);
+                Vec3 dir = row_disp(T, (size_t)tag); double L = dir.norm(); if(L>0) dir = dir / L; else dir = Vec3{0,0,1};
+                // orient loop to align with dir (Newell normal on global vertices)
+                Vec3 n{0,0,0};
+                for(size_t k=0;k<Fg.loop.size();++k){
+                    const Vec3& a = G.vertices[(size_t)Fg.loop[k]];
+                    const Vec3& b = G.vertices[(size_t)Fg.loop[(k+1)%Fg.loop.size()]];
+                    n.x += (a.y - b.y) * (a.z + b.z);
+                    n.y += (a.z - b.z) * (a.x + b.x);
+                    n.z += (a.x - b.x) * (a.y + b.y);
                 }
-                G.faces.push_back(std::move(Fg));
-                fmap.emplace(canon, fid);
+                if(n.norm() == 0) n = Vec3{0,0,1};
+                if(n.dot(dir) < 0) std::reverse(Fg.loop.begin(), Fg.loop.end());
+                Fg.normal_ij = dir;
             } else {
-                fid = it->second;
+                Fg.i = atom_ids[ci]; Fg.j = -1;
+                Fg.img = {0,0,0};
+                Fg.normal_ij = Vec3{0,0,1};
             }
-            cell.face_ids.push_back(fid);
         }
-        G.cells.push_back(std::move(cell));
-    }
-    // 3) Build edges
-    std::unordered_map<long long,int> emap; emap.reserve(65536);
-    auto pack2 = [](int a, int b)->long long{
-        int u = std::min(a,b), v = std::max(a,b);
-        return ( (long long)u << 32 ) | (unsigned long long)v;
-    };
-    for(const auto& Fg : G.faces){
-        const auto& L = Fg.loop;
+    });
+
+    // 3) Edges, in order of first appearance along the face loops
+    std::vector<int64_t> eoff(G.faces.size()+1, 0);
+    for(size_t f=0; f<G.faces.size(); ++f) eoff[f+1] = eoff[f] + (int64_t)G.faces[f].loop.size();
+    std::vector<uint64_t> ekey((size_t)eoff[G.faces.size()]), eh(ekey.size());
+    parallel_for(G.faces.size(), nt, [&](size_t f){
+        const auto& L = G.faces[f].loop;
         for(size_t k=0;k<L.size();++k){
-            int a = L[k], b = L[(k+1)%L.size()];
-            long long h = pack2(a,b);
-            if(emap.find(h)==emap.end()){
-                int eid = (int)G.edges.size();
-                emap.emplace(h, eid);
-                G.edges.push_back({std::min(a,b), std::max(a,b)});
-            }
+            const int a = L[k], b = L[(k+1)%L.size()];
+            const uint64_t key = ((uint64_t)(uint32_t)std::min(a,b) << 32) | (uint32_t)std::max(a,b);
+            ekey[(size_t)eoff[f] + k] = key;
+            eh[(size_t)eoff[f] + k] = mix64(key);
         }
-    }
+    });
+    first_occurrence(eh, [&](size_t a, size_t b){ return ekey[a] == ekey[b]; }, nt, rep);
+    G.edges.resize((size_t)dense_ids(rep, id));
+    parallel_for(ekey.size(), nt, [&](size_t k){
+        if(rep[k] == (int64_t)k) G.edges[(size_t)id[k]] = { (int)(ekey[k] >> 32), (int)(uint32_t)ekey[k] };
+    });
+#ifdef V3D_PROFILE
+    uint64_t bytes = capacity_bytes(G.vertices, G.edges, G.faces, G.cells);
+    for(const auto& f : G.faces) bytes += capacity_bytes(f.loop);
+    for(const auto& c : G.cells) bytes += capacity_bytes(c.face_ids);
+    V3D_PROFILE_COUNT(BytesAllocated, bytes);
+#endif
     return G;
 }
 
@@ -4,81 +4,489 @@
 #include <cstdint>
 #include <unordered_map>
 #include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
 #include "vec.hpp"
 #include "config.hpp"
+#include "cell_list.hpp"
+#include "dedup.hpp"
+#include "profiling.hpp"
 #include "../containers/box_container.hpp"
 #include "../containers/triclinic_pbc.hpp"
 
 namespace v3d {
-struct NeighborTable {
-    // Oriented pairs (one row per oriented (i,j,image))
+// Real is the storage type of disp and r2: double, or float to halve the table (planners
+// still measure in double and round on store; consumers convert back before any geometry).
+// Half tables store each unordered pair once (see the oriented row accessors below).
+template<class Real, bool Half = false>
+struct BasicNeighborTable {
+    using real_type = Real;
+    using vec_type = typename StoredVec3<Real>::type;
+    static constexpr bool half = Half;
+    // Oriented pairs (one row per oriented (i,j,image); for a half table one row per unordered
+    // pair, its reverse (j,i,-image) implicit); the planners emit each atom's rows
+    // contiguously and nearest first (by r2)
     std::vector<int32_t> i, j;
     std::vector<std::array<int32_t,3>> img; // (na,nb,nc)
-    std::vector<Vec3> disp;                 // cartesian displacement ri->rj(image)
-    std::vector<double> r2;                 // squared distance
+    std::vector<vec_type> disp;             // cartesian displacement ri->rj(image)
+    std::vector<Real> r2;                   // squared distance
+    std::vector<int64_t> offsets;           // CSR: rows of atom a are [offsets[a], offsets[a+1])
+    std::vector<int64_t> rev;               // row of the reverse pair (j,i,-img), or -1 if absent (full tables)
+    std::vector<int64_t> by_atom_offsets;   // half tables: the oriented rows of atom a, nearest first, are
+    std::vector<int32_t> by_atom;           //   by_atom[by_atom_offsets[a] .. by_atom_offsets[a+1]) (see by_atom_index)
     size_t size() const { return i.size(); }
+    size_t num_atoms() const { return offsets.empty() ? 0 : offsets.size()-1; }
 };
 
-inline NeighborTable plan_neighbors(const BoxContainer& box, const Config& cfg){
-    NeighborTable T;
+using NeighborTable = BasicNeighborTable<double>;
+using NeighborTableF32 = BasicNeighborTable<float>;
+using HalfNeighborTable = BasicNeighborTable<double, true>;
+using HalfNeighborTableF32 = BasicNeighborTable<float, true>;
+
+// Oriented row r of a table. A full table stores every oriented row; in a half table r = 2h is
+// row h as stored (i sees j) and r = 2h+1 its reverse (j sees i through -img, -disp), with M
+// given for the stored orientation only (the reverse takes 1 - M). Face tags carry r.
+template<class Real, bool Half>
+inline size_t oriented_rows(const BasicNeighborTable<Real,Half>& T){ return Half ? 2*T.size() : T.size(); }
+template<class Real, bool Half>
+inline int32_t row_i(const BasicNeighborTable<Real,Half>& T, size_t r){
+    if constexpr (Half) return (r & 1) ? T.j[r>>1] : T.i[r>>1]; else return T.i[r];
+}
+template<class Real, bool Half>
+inline int32_t row_j(const BasicNeighborTable<Real,Half>& T, size_t r){
+    if constexpr (Half) return (r & 1) ? T.i[r>>1] : T.j[r>>1]; else return T.j[r];
+}
+template<class Real, bool Half>
+inline std::array<int32_t,3> row_img(const BasicNeighborTable<Real,Half>& T, size_t r){
+    if constexpr (Half){ const auto& m = T.img[r>>1]; return (r & 1) ? std::array<int32_t,3>{-m[0], -m[1], -m[2]} : m; }
+    else return T.img[r];
+}
+template<class Real, bool Half>
+inline Vec3 row_disp(const BasicNeighborTable<Real,Half>& T, size_t r){
+    if constexpr (Half){ const Vec3 d = T.disp[r>>1]; return (r & 1) ? d * -1.0 : d; }
+    else return T.disp[r];
+}
+template<class Real, bool Half>
+inline double row_r2(const BasicNeighborTable<Real,Half>& T, size_t r){ return (double)T.r2[Half ? r>>1 : r]; }
+template<class Real, bool Half>
+inline double row_M(const BasicNeighborTable<Real,Half>&, const std::vector<double>& M, size_t r){
+    if constexpr (Half) return (r & 1) ? 1.0 - M[r>>1] : M[r>>1]; else return M[r];
+}
+
+// Rebuild T.offsets for N atoms from T.i. Returns false (and clears offsets) if the rows are
+// not grouped by ascending i or reference atoms outside [0,N).
+template<class Real, bool Half>
+inline bool build_offsets(BasicNeighborTable<Real,Half>& T, size_t N){
+    T.offsets.assign(N+1, 0);
+    for(size_t r=0; r<T.i.size(); ++r){
+        const int32_t a = T.i[r];
+        if(a < 0 || (size_t)a >= N || (r>0 && a < T.i[r-1])){ T.offsets.clear(); return false; }
+        T.offsets[(size_t)a+1]++;
+    }
+    for(size_t a=0; a<N; ++a) T.offsets[a+1] += T.offsets[a];
+    return true;
+}
+
+// True if T.offsets is a CSR index of T's rows over N atoms
+template<class Real, bool Half>
+inline bool has_offsets(const BasicNeighborTable<Real,Half>& T, size_t N){
+    return T.offsets.size() == N+1 && T.offsets.front() == 0 && (size_t)T.offsets.back() == T.size();
+}
+
+// reverse_rows for a table grouped by i (CSR offsets over num_atoms()) whose images fit in
+// 10 bits. Every row (i,j,img) is bucketed under j with the key of the row it needs, (i,-img);
+// each atom then looks its bucket up in a small hash of its own rows, so apart from the
+// bucketing pass all work stays within one atom's rows. Returns false if an image is out of
+// range.
+template<class Real>
+inline bool reverse_rows_csr(const BasicNeighborTable<Real>& T, int num_threads, std::vector<int64_t>& rev){
+    const size_t N = T.num_atoms(), R = T.size();
+    const int64_t* off = T.offsets.data();
+    using Key = std::pair<uint64_t,int64_t>;   // (packed j,img), row
+    auto pack = [](int32_t j, int32_t a, int32_t b, int32_t c){
+        return (uint64_t)(uint32_t)j << 32 | (uint64_t)(uint32_t)(a + 512) << 20 | (uint64_t)(uint32_t)(b + 512) << 10 | (uint64_t)(uint32_t)(c + 512);
+    };
+    for(const auto& m : T.img) for(int32_t v : m) if(v <= -512 || v >= 512) return false;
+    std::vector<int64_t> start(N+1, 0);
+    for(int32_t j : T.j) if(j >= 0 && (size_t)j < N) start[(size_t)j+1]++;
+    for(size_t a=0; a<N; ++a) start[a+1] += start[a];
+    std::vector<Key> want((size_t)start[N]);
+    {
+        std::vector<int64_t> fill(start.begin(), start.end()-1);
+        for(size_t r=0; r<R; ++r){
+            const int32_t j = T.j[r];
+            if(j < 0 || (size_t)j >= N) continue;
+            const auto& m = T.img[r];
+            want[(size_t)fill[(size_t)j]++] = { pack(T.i[r], -m[0], -m[1], -m[2]), (int64_t)r };
+        }
+    }
+    rev.assign(R, -1);
+    parallel_for(N, num_threads, [&](size_t a){
+        static thread_local std::vector<Key> slot;
+        const size_t n = (size_t)(off[a+1] - off[a]);
+        size_t cap = 16; while(cap < 2*n) cap <<= 1;
+        slot.assign(cap, Key{0, -1});
+        for(int64_t r=off[a]; r<off[a+1]; ++r){   // first row wins for duplicate keys
+            const auto& m = T.img[(size_t)r];
+            const uint64_t k = pack(T.j[(size_t)r], m[0], m[1], m[2]);
+            for(size_t t = (size_t)mix64(k) & (cap-1);; t = (t+1) & (cap-1)){
+                if(slot[t].second < 0){ slot[t] = {k, r}; break; }
+                if(slot[t].first == k) break;
+            }
+        }
+        for(int64_t w=start[a]; w<start[a+1]; ++w){
+            const Key& q = want[(size_t)w];
+            for(size_t t = (size_t)mix64(q.first) & (cap-1);; t = (t+1) & (cap-1)){
+                if(slot[t].second < 0) break;
+                if(slot[t].first == q.first){ if(slot[t].second != q.second) rev[(size_t)q.second] = slot[t].second; break; }
+            }
+        }
+    });
+    return true;
+}
+
+// Row of the reverse pair (j,i,-img) of every row of T, or -1 if the table lacks it
+template<class Real>
+inline std::vector<int64_t> reverse_rows(const BasicNeighborTable<Real>& T, int num_threads = 0){
+    const size_t R = T.size();
+    if(R > 0 && has_offsets(T, T.num_atoms())){
+        bool grouped = true;   // has_offsets only checks the ends
+        for(size_t a=0; a<T.num_atoms() && grouped; ++a)
+            for(int64_t r=T.offsets[a]; r<T.offsets[a+1]; ++r) if((size_t)T.i[(size_t)r] != a){ grouped = false; break; }
+        std::vector<int64_t> rev;
+        if(grouped && reverse_rows_csr(T, num_threads, rev)) return rev;
+    }
+    // the unordered key orients each row so that (i,j,img) is the smaller of its two directions
+    auto forward = [&](size_t r){
+        if(T.i[r] != T.j[r]) return T.i[r] < T.j[r];
+        const auto& m = T.img[r];
+        return m[0] > 0 || (m[0] == 0 && (m[1] > 0 || (m[1] == 0 && m[2] >= 0)));
+    };
+    std::vector<uint64_t> h(R);
+    parallel_for(R, num_threads, [&](size_t r){
+        const bool f = forward(r);
+        const int s = f ? 1 : -1;
+        uint64_t x = mix64((uint64_t)(uint32_t)(f ? T.i[r] : T.j[r]) << 32 | (uint32_t)(f ? T.j[r] : T.i[r]));
+        for(int k=0;k<3;++k) x = hash_combine64(x, (uint64_t)(uint32_t)(s*T.img[r][(size_t)k]));
+        h[r] = x;
+    });
+    auto reverse = [&](size_t a, size_t b){
+        if(forward(a) == forward(b)) return false; // same direction: a duplicate row
+        return T.i[a] == T.j[b] && T.j[a] == T.i[b] &&
+               T.img[a][0] == -T.img[b][0] && T.img[a][1] == -T.img[b][1] && T.img[a][2] == -T.img[b][2];
+    };
+    std::vector<int64_t> rep, rev(R, -1);
+    first_occurrence(h, reverse, num_threads, rep);
+    for(size_t r=0; r<R; ++r){
+        if(rep[r] == (int64_t)r) continue;
+        rev[r] = rep[r]; rev[(size_t)rep[r]] = (int64_t)r;
+    }
+    return rev;
+}
+
+// True if T.rev indexes the reverse row of every row of T
+template<class Real>
+inline bool has_reverse(const BasicNeighborTable<Real>& T){ return T.rev.size() == T.size(); }
+
+// M' with M'[rev[r]] = 1 - M'[r] for every row r that has a reverse row: each such pair gets
+// the average of M[r] and 1 - M[rev[r]], evaluated from its lower row so the two entries are
+// exact complements. Rows without a reverse keep M[r].
+inline std::vector<double> symmetrize_M(const std::vector<int64_t>& rev, const std::vector<double>& M, int num_threads = 0){
+    std::vector<double> out(M.size());
+    parallel_for(M.size(), num_threads, [&](size_t r){
+        const int64_t q = rev[r];
+        if(q < 0){ out[r] = M[r]; return; }
+        if((size_t)q > r) out[r] = 0.5*(M[r] + (1.0 - M[(size_t)q]));
+        else out[r] = 1.0 - 0.5*(M[(size_t)q] + (1.0 - M[r]));
+    });
+    return out;
+}
+
+template<class Real>
+inline std::vector<double> symmetrize_M(const BasicNeighborTable<Real>& T, const std::vector<double>& M, int num_threads = 0){
+    if(has_reverse(T)) return symmetrize_M(T.rev, M, num_threads);
+    return symmetrize_M(reverse_rows(T, num_threads), M, num_threads);
+}
+
+// Half tables: the oriented rows of every atom (2h under T.i[h], 2h+1 under T.j[h]) ordered by
+// (r2, row), as CSR over N atoms (the planners store it in T.by_atom_offsets / T.by_atom).
+// Stored rows come grouped and nearest first from the planners, so per atom only the reverse
+// rows are sorted and merged in.
+template<class Real>
+inline void by_atom_index(const BasicNeighborTable<Real,true>& T, size_t N, int num_threads,
+                          std::vector<int64_t>& off, std::vector<int32_t>& rows){
+    off.assign(N+1, 0);
+    auto valid = [&](int32_t a){ return a >= 0 && (size_t)a < N; };
+    for(size_t h=0; h<T.size(); ++h){
+        if(valid(T.i[h])) off[(size_t)T.i[h]+1]++;
+        if(valid(T.j[h])) off[(size_t)T.j[h]+1]++;
+    }
+    for(size_t a=0; a<N; ++a) off[a+1] += off[a];
+    rows.resize((size_t)off[N]);
+    std::vector<int64_t> fill(off.begin(), off.end()-1);
+    for(size_t h=0; h<T.size(); ++h) if(valid(T.i[h])) rows[(size_t)fill[(size_t)T.i[h]]++] = (int32_t)(2*h);
+    const std::vector<int64_t> split = fill;   // end of each atom's stored rows
+    for(size_t h=0; h<T.size(); ++h) if(valid(T.j[h])) rows[(size_t)fill[(size_t)T.j[h]]++] = (int32_t)(2*h + 1);
+    parallel_for(N, num_threads, [&](size_t a){
+        static thread_local std::vector<std::pair<Real,int32_t>> keyed, merged;
+        const size_t b = (size_t)off[a], m = (size_t)split[a], e = (size_t)off[a+1];
+        keyed.clear();
+        for(size_t k=b; k<e; ++k) keyed.push_back({T.r2[(size_t)rows[k] >> 1], rows[k]});
+        const auto mid = keyed.begin() + (std::ptrdiff_t)(m - b);
+        if(!std::is_sorted(keyed.begin(), mid)) std::sort(keyed.begin(), mid);
+        std::sort(mid, keyed.end());
+        merged.resize(keyed.size());
+        std::merge(keyed.begin(), mid, mid, keyed.end(), merged.begin());
+        for(size_t k=b; k<e; ++k) rows[k] = merged[k-b].second;
+    });
+}
+
+// True if T.by_atom indexes every oriented row of T over N atoms
+template<class Real>
+inline bool has_by_atom(const BasicNeighborTable<Real,true>& T, size_t N){
+    return T.by_atom_offsets.size() == N+1 && T.by_atom_offsets.front() == 0 && (size_t)T.by_atom_offsets.back() == T.by_atom.size()
+        && T.by_atom.size() <= 2*T.size();
+}
+
+// 98 cone axes: the integer points on the surface of the cube [-2,2]^3, normalized. Every unit
+// vector lies within ~17.65 deg of one of them; kConeCos/kConeSin describe a slightly wider
+// half-angle so the bounds below stay conservative.
+constexpr int kConeAxes = 98;
+constexpr double kConeCos = 0.9521;
+constexpr double kConeSin = 0.3058;
+
+inline const std::array<Vec3,kConeAxes>& cone_axes(){
+    static const std::array<Vec3,kConeAxes> dirs = []{
+        std::array<Vec3,kConeAxes> d{}; int k=0;
+        for(int x=-2;x<=2;++x) for(int y=-2;y<=2;++y) for(int z=-2;z<=2;++z){
+            if(std::max({std::abs(x), std::abs(y), std::abs(z)}) != 2) continue;
+            Vec3 v{(double)x,(double)y,(double)z}; d[k++] = v / v.norm();
+        }
+        return d;
+    }();
+    return dirs;
+}
+
+// Tighten per-cone reach bounds with a half-space n·(x-ri) <= h (n unit).
+// Points of the cone around axis u lie within the half-angle of u, so along the cone
+// t <= h / cos(angle(u,n) + half-angle) whenever that angle stays below 90 degrees.
+inline void cone_bound_update(std::array<double,kConeAxes>& bound, const Vec3& n, double h){
+    const auto& U = cone_axes();
+    for(int k=0;k<kConeAxes;++k){
+        double c = U[k].dot(n);
+        if(c <= 0) continue;
+        double s = std::sqrt(std::max(0.0, 1.0 - c*c));
+        double cc = c*kConeCos - s*kConeSin; // cos(theta + half-angle)
+        if(cc > 1e-12) bound[k] = std::min(bound[k], h / cc);
+    }
+}
+
+inline BinGrid box_bin_grid(const BoxContainer& box){
+    const size_t N = box.pos.size();
+    Vec3 lo = box.bounds.lo, hi = box.bounds.hi;
+    for(const auto& r : box.pos){
+        for(int k=0;k<3;++k){ lo[k] = std::min(lo[k], r[k]); hi[k] = std::max(hi[k], r[k]); }
+    }
+    double vol = 1.0; int dims = 0;
+    for(int k=0;k<3;++k){ double e = hi[k]-lo[k]; if(e>0){ vol *= e; ++dims; } }
+    double h = (N>0 && dims>0) ? std::pow(2.0*vol/(double)N, 1.0/dims) : 1.0;
+    return make_bin_grid(box.pos, lo, hi, Vec3{1,1,1}, {false,false,false}, h);
+}
+
+// Conservative radius of the cell of each atom: the cell lies inside the box and inside every
+// neighbor half-space, whose plane sits at most (1-min_M)|d| from the atom. Neighbors are met
+// ring by ring until no unseen atom can tighten the loosest cone bound.
+inline std::vector<double> box_reach_radii(const BoxContainer& box, const BinGrid& G, const Config& cfg){
     const size_t N = box.pos.size();
+    const double far = 1.0 - std::clamp(cfg.min_M, 0.0, 0.5);
+    std::vector<double> R(N, 0.0);
+    const Vec3 axes[3] = { Vec3{1,0,0}, Vec3{0,1,0}, Vec3{0,0,1} };
+    for(size_t ii=0; ii<N; ++ii){
+        const Vec3& ri = box.pos[ii];
+        std::array<double,kConeAxes> bound;
+        bound.fill(std::numeric_limits<double>::infinity());
+        for(int k=0;k<3;++k){
+            cone_bound_update(bound, axes[k], std::max(0.0, box.bounds.hi[k] - ri[k]));
+            cone_bound_update(bound, axes[k]*-1.0, std::max(0.0, ri[k] - box.bounds.lo[k]));
+        }
+        const auto& b = G.bin_of[ii];
+        double worst = *std::max_element(bound.begin(), bound.end());
+        for(int ring=0;; ++ring){
+            G.visit_ring(b, ring, [&](int32_t jj, const std::array<int32_t,3>&){
+                if((size_t)jj == ii) return;
+                Vec3 d = box.pos[(size_t)jj] - ri;
+                double L = d.norm();
+                if(L > 0 && far*L < worst) cone_bound_update(bound, d / L, far*L);
+            });
+            worst = *std::max_element(bound.begin(), bound.end());
+            if(G.exhausted(b, ring)) break;
+            if(worst <= far * G.ring_radius(b, ring)) break;
+        }
+        R[ii] = std::min(worst, box.farthest_corner_radius((int)ii));
+    }
+    return R;
+}
+
+// search_radius (optional) receives each atom's search radius, skin included. Table selects
+// the storage precision (plan_neighbors<NeighborTableF32>(...) for float32) and whether each
+// pair is stored once (HalfNeighborTable, HalfNeighborTableF32).
+template<class Table = NeighborTable>
+inline Table plan_neighbors(const BoxContainer& box, const Config& cfg,
+                            std::vector<double>* search_radius = nullptr){
+    V3D_PROFILE_SCOPE(PlanNeighbors);
+    Table T;
+    T.offsets.assign(1, 0);
+    const size_t N = box.pos.size();
+    if(search_radius) search_radius->assign(N, 0.0);
+    if(N==0) return T;
+    BinGrid G = box_bin_grid(box);
+    std::vector<double> R = box_reach_radii(box, G, cfg);
+    auto search = [&](size_t a){ return (R[a] / std::max(cfg.min_M, 1e-12)) + cfg.neighbor_skin; };
+    struct Cand { int32_t j; Vec3 d; double d2; };
+    std::vector<Cand> cand;
     for(size_t ii=0; ii<N; ++ii){
-        double R = box.farthest_corner_radius((int)ii);
-        double rsearch = (R / std::max(cfg.min_M, 1e-12)) + cfg.neighbor_skin;
+        double rsearch = search(ii);
         double r2max = rsearch*rsearch;
-        for(size_t jj=0; jj<N; ++jj){ if(ii==jj) continue;
-            Vec3 d = box.pos[jj] - box.pos[ii];
-            double d2 = d.norm2();
-            if(d2 <= r2max){
-                T.i.push_back((int32_t)ii); T.j.push_back((int32_t)jj);
-                T.img.push_back({0,0,0});
-                T.disp.push_back(d);
-                T.r2.push_back(d2);
-            }
+        if(search_radius) (*search_radius)[ii] = rsearch;
+        std::array<int,3> c{ G.reach(0, rsearch), G.reach(1, rsearch), G.reach(2, rsearch) };
+        cand.clear();
+        G.visit_block(G.bin_of[ii], c, [&](int32_t jj, const std::array<int32_t,3>&){
+            if((size_t)jj == ii) return;
+            Vec3 d = box.pos[(size_t)jj] - box.pos[ii];
+            double d2 = d.norm2();   // bitwise the same from either end
+            if(d2 > r2max) return;
+            // half tables: a pair goes to the lower atom, unless that atom's search missed it
+            if constexpr (Table::half){ if((size_t)jj < ii){ const double rj = search((size_t)jj); if(d2 <= rj*rj) return; } }
+            cand.push_back({jj, d, d2});
+        });
+        // nearest first, so cell construction can stop at the security radius
+        std::sort(cand.begin(), cand.end(), [](const Cand& a, const Cand& b){
+            return a.d2 != b.d2 ? a.d2 < b.d2 : a.j < b.j;
+        });
+        for(const auto& cd : cand){
+            T.i.push_back((int32_t)ii); T.j.push_back(cd.j);
+            T.img.push_back({0,0,0});
+            T.disp.push_back(cd.d);
+            T.r2.push_back((typename Table::real_type)cd.d2);
         }
+        T.offsets.push_back((int64_t)T.size());
     }
+    if constexpr (Table::half) by_atom_index(T, N, cfg.num_threads, T.by_atom_offsets, T.by_atom);
+    else T.rev = reverse_rows(T, cfg.num_threads);
+    V3D_PROFILE_COUNT(BytesAllocated, capacity_bytes(T.i, T.j, T.img, T.disp, T.r2, T.offsets, T.rev, T.by_atom_offsets, T.by_atom));
     return T;
 }
 
-inline NeighborTable plan_neighbors(const TriclinicPBC& pbc, const Config& cfg){
-    NeighborTable T;
+// Fractional-coordinate binning of a periodic frame. Periodic axes are wrapped into [0,1);
+// wrap[p] records the lattice translation removed from atom p, so that
+// pos[p] = A*(u[p] + wrap[p]). Bin reach along axis k uses the reciprocal-vector norm.
+inline BinGrid pbc_bin_grid(const TriclinicPBC& pbc, std::vector<std::array<int32_t,3>>& wrap){
     const size_t N = pbc.pos.size();
-    if(N==0) return T;
-    // crude nearest-neighbor distance estimate
-    double dnn = std::numeric_limits<double>::infinity();
-    for(size_t i=0;i<N;i++){
-        for(size_t j=i+1;j<N;j++){
-            auto [d, img] = pbc.lat.min_image_disp(pbc.pos[i], pbc.pos[j], pbc.periodic);
-            dnn = std::min(dnn, d.norm());
+    std::vector<Vec3> u(N);
+    wrap.assign(N, {0,0,0});
+    Vec3 lo{0,0,0}, hi{1,1,1};
+    for(int k=0;k<3;++k) if(!pbc.periodic[k]){ lo[k] = std::numeric_limits<double>::infinity(); hi[k] = -lo[k]; }
+    for(size_t p=0; p<N; ++p){
+        Vec3 f = pbc.lat.to_frac(pbc.pos[p]);
+        for(int k=0;k<3;++k){
+            if(pbc.periodic[k]){
+                double s = std::floor(f[k]);
+                f[k] -= s;
+                if(f[k] >= 1.0){ f[k] = 0.0; s += 1.0; }
+                wrap[p][k] = (int32_t)s;
+            } else {
+                lo[k] = std::min(lo[k], f[k]); hi[k] = std::max(hi[k], f[k]);
+            }
         }
+        u[p] = f;
     }
+    const Mat3& B = pbc.lat.Ainv;
+    Vec3 scale{ Vec3{B.c0.x, B.c1.x, B.c2.x}.norm(),
+                Vec3{B.c0.y, B.c1.y, B.c2.y}.norm(),
+                Vec3{B.c0.z, B.c1.z, B.c2.z}.norm() };
+    double vol = 1.0; int dims = 0;
+    for(int k=0;k<3;++k){ double e = (hi[k]-lo[k]) / scale[k]; if(e>0){ vol *= e; ++dims; } }
+    double h = (N>0 && dims>0) ? std::pow(2.0*vol/(double)N, 1.0/dims) : 1.0;
+    return make_bin_grid(u, lo, hi, scale, pbc.periodic, h);
+}
+
+// Smallest distance between two distinct atoms over all images (excluding self-images)
+inline double pbc_nearest_distance(const TriclinicPBC& pbc, const BinGrid& G,
+                                   const std::vector<std::array<int32_t,3>>& wrap){
+    const size_t N = pbc.pos.size();
+    const Mat3& A = pbc.lat.A;
+    double best = std::numeric_limits<double>::infinity();
+    for(size_t ii=0; ii<N; ++ii){
+        const auto& b = G.bin_of[ii];
+        for(int ring=0;; ++ring){
+            G.visit_ring(b, ring, [&](int32_t jj, const std::array<int32_t,3>& shift){
+                if((size_t)jj == ii) return;
+                const auto& wi = wrap[ii]; const auto& wj = wrap[(size_t)jj];
+                Vec3 im = A.c0*(double)(shift[0]-wj[0]+wi[0]) + A.c1*(double)(shift[1]-wj[1]+wi[1])
+                        + A.c2*(double)(shift[2]-wj[2]+wi[2]);
+                Vec3 d = (pbc.pos[(size_t)jj] + im) - pbc.pos[ii];
+                best = std::min(best, d.norm());
+            });
+            if(G.exhausted(b, ring) || best <= G.ring_radius(b, ring)) break;
+            if(N < 2) break;
+        }
+    }
+    return best;
+}
+
+template<class Table = NeighborTable>
+inline Table plan_neighbors(const TriclinicPBC& pbc, const Config& cfg,
+                            std::vector<double>* search_radius = nullptr){
+    V3D_PROFILE_SCOPE(PlanNeighbors);
+    Table T;
+    T.offsets.assign(1, 0);
+    const size_t N = pbc.pos.size();
+    if(search_radius) search_radius->assign(N, 0.0);
+    if(N==0) return T;
+    std::vector<std::array<int32_t,3>> wrap;
+    BinGrid G = pbc_bin_grid(pbc, wrap);
+    // nearest-neighbor distance sets the reach
+    double dnn = pbc_nearest_distance(pbc, G, wrap);
     if(!std::isfinite(dnn) || dnn==0.0) dnn = 1.0;
     double R = cfg.reach_factor * dnn;
     double rsearch = (R / std::max(cfg.min_M, 1e-12)) + cfg.neighbor_skin;
+    const double r2max = rsearch*rsearch;
+    if(search_radius) search_radius->assign(N, rsearch);
+    const std::array<int,3> c{ G.reach(0, rsearch), G.reach(1, rsearch), G.reach(2, rsearch) };
+    const Mat3& A = pbc.lat.A;
 
-    auto norm = [](const Vec3& v){ return std::sqrt(v.norm2()); };
-    double na_max = std::ceil(rsearch / std::max(1e-12, norm(pbc.lat.A.c0)));
-    double nb_max = std::ceil(rsearch / std::max(1e-12, norm(pbc.lat.A.c1)));
-    double nc_max = std::ceil(rsearch / std::max(1e-12, norm(pbc.lat.A.c2)));
-
+    struct Cand { int32_t j; std::array<int32_t,3> n; Vec3 d; double d2; };
+    std::vector<Cand> cand;
     for(size_t ii=0; ii<N; ++ii){
-        for(size_t jj=0; jj<N; ++jj){ if(ii==jj) continue;
-            for(int na = (pbc.periodic[0]?-(int)na_max:0); na <= (pbc.periodic[0]?(int)na_max:0); ++na)
-            for(int nb = (pbc.periodic[1]?-(int)nb_max:0); nb <= (pbc.periodic[1]?(int)nb_max:0); ++nb)
-            for(int nc = (pbc.periodic[2]?-(int)nc_max:0); nc <= (pbc.periodic[2]?(int)nc_max:0); ++nc){
-                Vec3 im = pbc.lat.A.c0*(double)na + pbc.lat.A.c1*(double)nb + pbc.lat.A.c2*(double)nc;
-                Vec3 d = (pbc.pos[jj] + im) - pbc.pos[ii];
-                double d2 = d.norm2();
-                if(d2 <= rsearch*rsearch && d2>0){
-                    T.i.push_back((int32_t)ii);
-                    T.j.push_back((int32_t)jj);
-                    T.img.push_back({na,nb,nc});
-                    T.disp.push_back(d);
-                    T.r2.push_back(d2);
-                }
-            }
+        cand.clear();
+        const auto& wi = wrap[ii];
+        G.visit_block(G.bin_of[ii], c, [&](int32_t jj, const std::array<int32_t,3>& shift){
+            if((size_t)jj == ii) return;
+            if constexpr (Table::half){ if((size_t)jj < ii) return; }   // one search radius: the lower atom keeps the pair
+            const auto& wj = wrap[(size_t)jj];
+            std::array<int32_t,3> n{ shift[0]-wj[0]+wi[0], shift[1]-wj[1]+wi[1], shift[2]-wj[2]+wi[2] };
+            Vec3 im = A.c0*(double)n[0] + A.c1*(double)n[1] + A.c2*(double)n[2];
+            Vec3 d = (pbc.pos[(size_t)jj] + im) - pbc.pos[ii];
+            double d2 = d.norm2();
+            if(d2 <= r2max && d2>0) cand.push_back({jj, n, d, d2});
+        });
+        std::sort(cand.begin(), cand.end(), [](const Cand& a, const Cand& b){
+            if(a.d2 != b.d2) return a.d2 < b.d2;
+            return a.j != b.j ? a.j < b.j : a.n < b.n;
+        });
+        for(const auto& cd : cand){
+            T.i.push_back((int32_t)ii);
+            T.j.push_back(cd.j);
+            T.img.push_back(cd.n);
+            T.disp.push_back(cd.d);
+            T.r2.push_back((typename Table::real_type)cd.d2);
         }
+        T.offsets.push_back((int64_t)T.size());
     }
+    if constexpr (Table::half) by_atom_index(T, N, cfg.num_threads, T.by_atom_offsets, T.by_atom);
+    else T.rev = reverse_rows(T, cfg.num_threads);
+    V3D_PROFILE_COUNT(BytesAllocated, capacity_bytes(T.i, T.j, T.img, T.disp, T.r2, T.offsets, T.rev, T.by_atom_offsets, T.by_atom));
     return T;
 }
 }
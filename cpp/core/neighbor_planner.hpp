@@ -0,0 +1,186 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include "vec.hpp"
+#include "config.hpp"
+#include "neighbor.hpp"
+#include "parallel.hpp"
+#include "../containers/box_container.hpp"
+#include "../containers/triclinic_pbc.hpp"
+
+namespace v3d {
+
+struct PlannerStats {
+    int64_t frames = 0;
+    int64_t rebuilds = 0;            // full plan_neighbors runs
+    int64_t refreshes = 0;           // frames served by refreshing disp/r2 in place
+    double max_displacement = 0.0;   // largest atom displacement since the last rebuild (last frame)
+};
+
+// Verlet-style reuse of a neighbor table across frames of the same system. Tables are planned
+// with cfg.neighbor_skin of extra search radius; while every atom has moved less than skin/2
+// since the last rebuild, the rows still cover every pair the cells can need, so update() only
+// recomputes disp/r2 (and, for PBC, images of atoms that crossed a boundary) in place. Row order
+// is kept, so per-row M stays valid until a rebuild (last_rebuilt() tells when it changed).
+//
+// Coverage is checked per atom, not just by the skin/2 rule: a refreshed frame must also satisfy
+// R_new/min_M + 2*max_displacement <= search radius, where R_new bounds the new cell radius
+// (box: cone bounds from the walls and the table's rows; PBC: reach_factor * nearest distance).
+struct NeighborPlanner {
+    explicit NeighborPlanner(const Config& cfg): cfg_(cfg) {}
+
+    const NeighborTable& update(const BoxContainer& box){
+        stats_.frames++;
+        if(table_ && is_box_ && box.pos.size() == ref_pos_.size() && same_bounds(box.bounds) && refresh_box(box)){
+            stats_.refreshes++; rebuilt_ = false; return *table_;
+        }
+        table_ = std::make_shared<NeighborTable>(plan_neighbors(box, cfg_, &rsearch_));
+        is_box_ = true; bounds_ = box.bounds; ref_pos_ = box.pos;
+        ref_r2_ = table_->r2;
+        ref_img_.clear();
+        stats_.rebuilds++; stats_.max_displacement = 0.0; rebuilt_ = true;
+        return *table_;
+    }
+
+    const NeighborTable& update(const TriclinicPBC& pbc){
+        stats_.frames++;
+        if(table_ && !is_box_ && pbc.pos.size() == ref_pos_.size() && same_lattice(pbc) && refresh_pbc(pbc)){
+            stats_.refreshes++; rebuilt_ = false; return *table_;
+        }
+        table_ = std::make_shared<NeighborTable>(plan_neighbors(pbc, cfg_, &rsearch_));
+        is_box_ = false; A_ = pbc.lat.A; periodic_ = pbc.periodic; ref_pos_ = pbc.pos;
+        ref_img_ = table_->img;
+        ref_r2_.clear();
+        stats_.rebuilds++; stats_.max_displacement = 0.0; rebuilt_ = true;
+        return *table_;
+    }
+
+    // Force a full rebuild on the next update
+    void reset(){ table_.reset(); }
+
+    const NeighborTable& table() const { return *table_; }
+    // The current table; a rebuild replaces it, so holders of an older pointer keep a valid
+    // (stale) table, while refreshes modify it in place
+    std::shared_ptr<NeighborTable> table_ptr() const { return table_; }
+    bool last_rebuilt() const { return rebuilt_; }
+    const PlannerStats& stats() const { return stats_; }
+    const Config& config() const { return cfg_; }
+
+private:
+    Config cfg_;
+    std::shared_ptr<NeighborTable> table_;
+    bool is_box_ = true, rebuilt_ = false;
+    BoxBounds bounds_{};
+    Mat3 A_{};
+    std::array<bool,3> periodic_{true,true,true};
+    std::vector<Vec3> ref_pos_;                  // positions at the last rebuild
+    std::vector<double> rsearch_;                // per-atom search radius of the last rebuild
+    std::vector<double> ref_r2_;                 // box: r2 of each row at the last rebuild
+    std::vector<std::array<int32_t,3>> ref_img_; // PBC: images at the last rebuild
+    PlannerStats stats_;
+
+    bool same_bounds(const BoxBounds& b) const {
+        for(int k=0;k<3;++k) if(b.lo[k] != bounds_.lo[k] || b.hi[k] != bounds_.hi[k]) return false;
+        return true;
+    }
+    bool same_lattice(const TriclinicPBC& pbc) const {
+        if(pbc.periodic != periodic_) return false;
+        const Mat3& A = pbc.lat.A;
+        const Vec3 a[3] = {A.c0, A.c1, A.c2}, b[3] = {A_.c0, A_.c1, A_.c2};
+        for(int k=0;k<3;++k) if((a[k]-b[k]).norm2() != 0) return false;
+        return true;
+    }
+
+    bool refresh_box(const BoxContainer& box){
+        const size_t N = box.pos.size();
+        double dmax = 0.0;
+        for(size_t i=0; i<N; ++i) dmax = std::max(dmax, (box.pos[i] - ref_pos_[i]).norm());
+        stats_.max_displacement = dmax;
+        if(2*dmax > cfg_.neighbor_skin) return false;
+        NeighborTable& T = *table_;
+        const int64_t* off = T.offsets.data();
+        // new cell radius bound from walls and rows, nearest (at rebuild) first; rows beyond
+        // far*(d_ref - 2*dmax) cannot tighten it any more
+        const double far = 1.0 - std::clamp(cfg_.min_M, 0.0, 0.5);
+        const Vec3 axes[3] = { Vec3{1,0,0}, Vec3{0,1,0}, Vec3{0,0,1} };
+        std::vector<uint8_t> covered(N, 0);
+        parallel_for(N, cfg_.num_threads, [&](size_t i){
+            const Vec3& ri = box.pos[i];
+            std::array<double,kConeAxes> bound;
+            bound.fill(std::numeric_limits<double>::infinity());
+            for(int k=0;k<3;++k){
+                cone_bound_update(bound, axes[k], std::max(0.0, box.bounds.hi[k] - ri[k]));
+                cone_bound_update(bound, axes[k]*-1.0, std::max(0.0, ri[k] - box.bounds.lo[k]));
+            }
+            double worst = *std::max_element(bound.begin(), bound.end());
+            for(int64_t r=off[i]; r<off[i+1]; ++r){
+                const size_t ru = (size_t)r;
+                if(worst <= far * (std::sqrt(ref_r2_[ru]) - 2*dmax)) break;
+                const Vec3 d = box.pos[(size_t)T.j[ru]] - ri;
+                const double L = d.norm();
+                if(L > 0 && far*L < worst){
+                    cone_bound_update(bound, d / L, far*L);
+                    worst = *std::max_element(bound.begin(), bound.end());
+                }
+            }
+            const double R = std::min(worst, box.farthest_corner_radius((int)i));
+            covered[i] = R / std::max(cfg_.min_M, 1e-12) + 2*dmax <= rsearch_[i];
+        });
+        if(std::find(covered.begin(), covered.end(), 0) != covered.end()) return false;
+        parallel_for(T.size(), cfg_.num_threads, [&](size_t r){
+            T.disp[r] = box.pos[(size_t)T.j[r]] - box.pos[(size_t)T.i[r]];
+            T.r2[r] = T.disp[r].norm2();
+        });
+        return true;
+    }
+
+    bool refresh_pbc(const TriclinicPBC& pbc){
+        const size_t N = pbc.pos.size();
+        const Mat3& A = pbc.lat.A;
+        // lattice translation each atom made since the rebuild (wrapping), and the residual
+        std::vector<std::array<int32_t,3>> shift(N, {0,0,0});
+        double dmax = 0.0;
+        for(size_t i=0; i<N; ++i){
+            Vec3 df = pbc.lat.to_frac(pbc.pos[i] - ref_pos_[i]);
+            for(int k=0;k<3;++k) if(periodic_[k]){
+                const double s = std::round(df[k]);
+                shift[i][(size_t)k] = (int32_t)s; df[k] -= s;
+            }
+            dmax = std::max(dmax, (A.c0*df.x + A.c1*df.y + A.c2*df.z).norm());
+        }
+        stats_.max_displacement = dmax;
+        if(2*dmax > cfg_.neighbor_skin) return false;
+        NeighborTable& T = *table_;
+        // new displacements, and each atom's nearest distance (rows are grouped by atom)
+        const int64_t* off = T.offsets.data();
+        std::vector<Vec3> disp(T.size());
+        std::vector<double> nearest(N, std::numeric_limits<double>::infinity());
+        parallel_for(N, cfg_.num_threads, [&](size_t i){
+            for(int64_t rr=off[i]; rr<off[i+1]; ++rr){
+                const size_t r = (size_t)rr, j = (size_t)T.j[r];
+                std::array<int32_t,3> n;
+                for(int k=0;k<3;++k) n[(size_t)k] = ref_img_[r][(size_t)k] + shift[i][(size_t)k] - shift[j][(size_t)k];
+                disp[r] = pbc.pos[j] + A.c0*(double)n[0] + A.c1*(double)n[1] + A.c2*(double)n[2] - pbc.pos[i];
+                if(i != j) nearest[i] = std::min(nearest[i], disp[r].norm());
+            }
+        });
+        const double dnn = N ? *std::min_element(nearest.begin(), nearest.end()) : 0.0;
+        if(!std::isfinite(dnn) || dnn == 0.0) return false;
+        const double R = cfg_.reach_factor * dnn;
+        if(!rsearch_.empty() && R / std::max(cfg_.min_M, 1e-12) + 2*dmax > rsearch_[0]) return false;
+        parallel_for(T.size(), cfg_.num_threads, [&](size_t r){
+            const size_t i = (size_t)T.i[r], j = (size_t)T.j[r];
+            for(int k=0;k<3;++k) T.img[r][(size_t)k] = ref_img_[r][(size_t)k] + shift[i][(size_t)k] - shift[j][(size_t)k];
+            T.disp[r] = disp[r];
+            T.r2[r] = disp[r].norm2();
+        });
+        return true;
+    }
+};
+
+} // namespace v3d
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include "profiling.hpp"
+#ifdef V3D_OPENMP
+#include <omp.h>
+#endif
+
+namespace v3d {
+// Run fn(k) for every k in [0,n), spread over num_threads threads (<= 0: OpenMP default).
+// Iterations must only write their own output slot, so results do not depend on the thread
+// count. Without OpenMP (V3D_OPENMP undefined) this is a plain loop.
+template<class F>
+inline void parallel_for(size_t n, int num_threads, F&& fn){
+#ifdef V3D_OPENMP
+    const int nt = num_threads > 0 ? num_threads : omp_get_max_threads();
+    if(nt > 1 && n > 1){
+        const std::ptrdiff_t count = (std::ptrdiff_t)n;
+        V3D_PROFILE_CONTEXT(caller);
+        #pragma omp parallel num_threads(nt)
+        {
+            V3D_PROFILE_WORKER(caller);   // the team's work counts toward the caller's profiled call
+            #pragma omp for schedule(dynamic, 16)
+            for(std::ptrdiff_t k=0; k<count; ++k) fn((size_t)k);
+        }
+        return;
+    }
+#else
+    (void)num_threads;
+#endif
+    for(size_t k=0; k<n; ++k) fn(k);
+}
+}
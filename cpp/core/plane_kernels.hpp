@@ -0,0 +1,121 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <limits>
+#include "vec.hpp"
+#include "plane.hpp"
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace v3d {
+
+// Plane distance kernels. Every path evaluates (n.x*x + n.y*y) + n.z*z - d with separate
+// multiplies and adds, in the order of signed_distance(), so SIMD and scalar builds classify
+// identically. The widest of AVX-512, AVX2 (x86) or NEON (aarch64) enabled at compile time is
+// used; otherwise the scalar loops below.
+#if defined(__AVX512F__)
+constexpr size_t kPlaneLanes = 8;
+#elif defined(__AVX2__)
+constexpr size_t kPlaneLanes = 4;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+constexpr size_t kPlaneLanes = 2;
+#else
+constexpr size_t kPlaneLanes = 1;
+#endif
+
+// Planes n·x <= d as columns, padded to a multiple of kPlaneLanes with planes that nothing
+// lies above (n = 0, d = +max)
+struct PlaneSoA {
+    std::vector<double> nx, ny, nz, d;
+    size_t count = 0;
+
+    void clear(){ nx.clear(); ny.clear(); nz.clear(); d.clear(); count = 0; }
+    template<class PlaneRange, class Get>
+    void assign(const PlaneRange& planes, Get&& get){
+        clear();
+        for(const auto& p : planes){
+            const Plane& P = get(p);
+            nx.push_back(P.n.x); ny.push_back(P.n.y); nz.push_back(P.n.z); d.push_back(P.d);
+        }
+        count = nx.size();
+        while(nx.size() % kPlaneLanes){ nx.push_back(0); ny.push_back(0); nz.push_back(0); d.push_back(std::numeric_limits<double>::max()); }
+    }
+    size_t size() const { return count; }
+};
+
+// True if x lies more than eps above any plane of S (stops at the first such block)
+inline bool any_plane_above(const PlaneSoA& S, const Vec3& x, double eps){
+    const size_t n = S.nx.size();
+#if defined(__AVX512F__)
+    const __m512d X = _mm512_set1_pd(x.x), Y = _mm512_set1_pd(x.y), Z = _mm512_set1_pd(x.z), E = _mm512_set1_pd(eps);
+    for(size_t k=0; k<n; k+=8){
+        __m512d t = _mm512_add_pd(_mm512_mul_pd(_mm512_loadu_pd(&S.nx[k]), X), _mm512_mul_pd(_mm512_loadu_pd(&S.ny[k]), Y));
+        t = _mm512_sub_pd(_mm512_add_pd(t, _mm512_mul_pd(_mm512_loadu_pd(&S.nz[k]), Z)), _mm512_loadu_pd(&S.d[k]));
+        if(_mm512_cmp_pd_mask(t, E, _CMP_GT_OQ)) return true;
+    }
+#elif defined(__AVX2__)
+    const __m256d X = _mm256_set1_pd(x.x), Y = _mm256_set1_pd(x.y), Z = _mm256_set1_pd(x.z), E = _mm256_set1_pd(eps);
+    for(size_t k=0; k<n; k+=4){
+        __m256d t = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&S.nx[k]), X), _mm256_mul_pd(_mm256_loadu_pd(&S.ny[k]), Y));
+        t = _mm256_sub_pd(_mm256_add_pd(t, _mm256_mul_pd(_mm256_loadu_pd(&S.nz[k]), Z)), _mm256_loadu_pd(&S.d[k]));
+        if(_mm256_movemask_pd(_mm256_cmp_pd(t, E, _CMP_GT_OQ))) return true;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float64x2_t X = vdupq_n_f64(x.x), Y = vdupq_n_f64(x.y), Z = vdupq_n_f64(x.z), E = vdupq_n_f64(eps);
+    for(size_t k=0; k<n; k+=2){
+        float64x2_t t = vaddq_f64(vmulq_f64(vld1q_f64(&S.nx[k]), X), vmulq_f64(vld1q_f64(&S.ny[k]), Y));
+        t = vsubq_f64(vaddq_f64(t, vmulq_f64(vld1q_f64(&S.nz[k]), Z)), vld1q_f64(&S.d[k]));
+        if(vmaxvq_u64(vcgtq_f64(t, E))) return true;
+    }
+#else
+    for(size_t k=0; k<n; ++k)
+        if((S.nx[k]*x.x + S.ny[k]*x.y) + S.nz[k]*x.z - S.d[k] > eps) return true;
+#endif
+    return false;
+}
+
+// sd[v] = signed distance of V[v] to H, for n packed vertices
+inline void signed_distances(const Plane& H, const Vec3* V, size_t n, double* sd){
+    size_t v = 0;
+#if defined(__AVX512F__) || defined(__AVX2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+    constexpr size_t W = kPlaneLanes;
+    auto block = [&](const double* p, double* out){   // W vertices starting at p (x,y,z interleaved)
+#if defined(__AVX512F__)
+        // masked gathers with a zero source: the plain gather's undefined source trips GCC 12's
+        // -Wmaybe-uninitialized
+        const __m512i ix = _mm512_set_epi64(21,18,15,12,9,6,3,0);
+        auto gather = [&](const double* q){ return _mm512_mask_i64gather_pd(_mm512_setzero_pd(), (__mmask8)0xFF, ix, q, 8); };
+        __m512d t = _mm512_add_pd(_mm512_mul_pd(_mm512_set1_pd(H.n.x), gather(p)),
+                                  _mm512_mul_pd(_mm512_set1_pd(H.n.y), gather(p+1)));
+        t = _mm512_sub_pd(_mm512_add_pd(t, _mm512_mul_pd(_mm512_set1_pd(H.n.z), gather(p+2))), _mm512_set1_pd(H.d));
+        _mm512_storeu_pd(out, t);
+#elif defined(__AVX2__)
+        const __m256i ix = _mm256_set_epi64x(9,6,3,0);
+        __m256d t = _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(H.n.x), _mm256_i64gather_pd(p, ix, 8)),
+                                  _mm256_mul_pd(_mm256_set1_pd(H.n.y), _mm256_i64gather_pd(p+1, ix, 8)));
+        t = _mm256_sub_pd(_mm256_add_pd(t, _mm256_mul_pd(_mm256_set1_pd(H.n.z), _mm256_i64gather_pd(p+2, ix, 8))), _mm256_set1_pd(H.d));
+        _mm256_storeu_pd(out, t);
+#else
+        const float64x2x3_t r = vld3q_f64(p);
+        float64x2_t t = vaddq_f64(vmulq_f64(vdupq_n_f64(H.n.x), r.val[0]), vmulq_f64(vdupq_n_f64(H.n.y), r.val[1]));
+        t = vsubq_f64(vaddq_f64(t, vmulq_f64(vdupq_n_f64(H.n.z), r.val[2])), vdupq_n_f64(H.d));
+        vst1q_f64(out, t);
+#endif
+    };
+    for(; v+W <= n; v+=W) block(&V[v].x, sd + v);
+    if(v < n){   // the tail goes through a padded block too, so every vertex takes the same path
+        Vec3 tail[W]{};
+        double out[W]{};
+        for(size_t k=0; v+k<n; ++k) tail[k] = V[v+k];
+        block(&tail[0].x, out);
+        for(size_t k=0; v+k<n; ++k) sd[v+k] = out[k];
+    }
+#else
+    for(; v<n; ++v) sd[v] = (H.n.x*V[v].x + H.n.y*V[v].y) + H.n.z*V[v].z - H.d;
+#endif
+}
+
+} // namespace v3d
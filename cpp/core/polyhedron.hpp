@@ -4,19 +4,42 @@
 #include <optional>
 #include <cmath>
 #include <algorithm>
+#include <span>
 #include "vec.hpp"
 #include "plane.hpp"
+#include "plane_kernels.hpp"
 #include "config.hpp"
+#include "profiling.hpp"
+#include "dedup.hpp"
 
 namespace v3d {
 
 struct Polyhedron {
     std::vector<Vec3> V;                   // vertices
-    std::vector<std::vector<int>> F;       // faces as CCW loops (indices into V)
+    std::vector<int> face_index;           // face loops back to back, CCW (indices into V)
+    std::vector<int> face_offset{0};       // face f is face_index[face_offset[f] .. face_offset[f+1])
     std::vector<Vec3> face_normal;
     std::vector<double> face_area;
     std::vector<Vec3> face_centroid;
     std::vector<int> face_tag;             // user tag for the plane that generated the face
+
+    size_t num_faces() const { return face_offset.empty() ? 0 : face_offset.size()-1; }
+    std::span<const int> face(size_t f) const {
+        return { face_index.data() + face_offset[f], (size_t)(face_offset[f+1] - face_offset[f]) };
+    }
+    std::span<int> face(size_t f){
+        return { face_index.data() + face_offset[f], (size_t)(face_offset[f+1] - face_offset[f]) };
+    }
+    void add_face(std::span<const int> loop, int tag){
+        face_index.insert(face_index.end(), loop.begin(), loop.end());
+        face_offset.push_back((int)face_index.size());
+        face_tag.push_back(tag);
+    }
+    // Empty the polyhedron but keep every buffer's capacity
+    void clear(){
+        V.clear(); face_index.clear(); face_offset.assign(1, 0);
+        face_normal.clear(); face_area.clear(); face_centroid.clear(); face_tag.clear();
+    }
 };
 
 struct PlaneWithTag {
@@ -69,11 +92,13 @@ inline Vec3 orthonormal_u(const Vec3& n){
 
 // exact per-face area/centroid via triangulation; normal via summed cross
 inline void compute_face_attributes(Polyhedron& P){
-    P.face_area.resize(P.F.size());
-    P.face_centroid.resize(P.F.size());
-    P.face_normal.resize(P.F.size());
-    for(size_t f=0; f<P.F.size(); ++f){
-        const auto& loop = P.F[f];
+    V3D_PROFILE_SCOPE(FaceAttributes);
+    const size_t nf = P.num_faces();
+    P.face_area.resize(nf);
+    P.face_centroid.resize(nf);
+    P.face_normal.resize(nf);
+    for(size_t f=0; f<nf; ++f){
+        const auto loop = P.face(f);
         if(loop.size()<3){ P.face_area[f]=0; P.face_centroid[f]={0,0,0}; P.face_normal[f]={0,0,1}; continue; }
         const Vec3& v0 = P.V[loop[0]];
         double area_sum = 0.0;
@@ -96,109 +121,194 @@ inline void compute_face_attributes(Polyhedron& P){
     }
 }
 
-// prune faces with area below threshold
+// prune faces with area below threshold (compacts in place, no allocation)
 inline void prune_tiny_faces(Polyhedron& P, const Config& cfg){
-    std::vector<std::vector<int>> F2;
-    std::vector<Vec3> N2, C2;
-    std::vector<double> A2;
-    std::vector<int> T2;
-    for(size_t f=0; f<P.F.size(); ++f){
-        if(f < P.face_area.size() && P.face_area[f] < cfg.min_face_area) continue;
-        F2.push_back(std::move(P.F[f]));
-        A2.push_back(f < P.face_area.size()? P.face_area[f] : 0.0);
-        C2.push_back(f < P.face_centroid.size()? P.face_centroid[f] : Vec3{0,0,0});
-        N2.push_back(f < P.face_normal.size()? P.face_normal[f] : Vec3{0,0,1});
-        T2.push_back(f < P.face_tag.size()? P.face_tag[f] : -1);
+    V3D_PROFILE_SCOPE(PruneFaces);
+    const size_t nf = P.num_faces();
+    P.face_area.resize(nf, 0.0);
+    P.face_centroid.resize(nf, Vec3{0,0,0});
+    P.face_normal.resize(nf, Vec3{0,0,1});
+    P.face_tag.resize(nf, -1);
+    size_t kept = 0, w = 0;
+    int begin = 0;
+    for(size_t f=0; f<nf; ++f){
+        const int end = P.face_offset[f+1];
+        if(P.face_area[f] < cfg.min_face_area){ begin = end; continue; }
+        for(int q=begin; q<end; ++q) P.face_index[w++] = P.face_index[(size_t)q];
+        P.face_offset[kept+1] = (int)w;
+        P.face_area[kept] = P.face_area[f];
+        P.face_centroid[kept] = P.face_centroid[f];
+        P.face_normal[kept] = P.face_normal[f];
+        P.face_tag[kept] = P.face_tag[f];
+        ++kept; begin = end;
     }
-    P.F = std::move(F2);
-    P.face_area = std::move(A2);
-    P.face_centroid = std::move(C2);
-    P.face_normal = std::move(N2);
-    P.face_tag = std::move(T2);
+    V3D_PROFILE_COUNT(PrunedFaces, nf - kept);
+    P.face_index.resize(w); P.face_offset.resize(kept+1);
+    P.face_area.resize(kept); P.face_centroid.resize(kept); P.face_normal.resize(kept); P.face_tag.resize(kept);
 }
 
-// Build convex polyhedron from intersection of half-spaces n·x <= d
-inline Polyhedron halfspace_intersection(const std::vector<PlaneWithTag>& planes, const Config& cfg){
-    Polyhedron P;
+// Monotone stand-in for atan2(y, x) on [0,4): orders directions CCW without trig calls
+inline double pseudo_angle(double x, double y){
+    const double s = std::fabs(x) + std::fabs(y);
+    if(s == 0) return 0.0;
+    const double p = x / s;
+    return y < 0 ? 3.0 + p : 1.0 - p;
+}
+
+// Scratch of halfspace_intersection, reusable across calls
+struct HalfspaceScratch {
+    struct Raw { Vec3 x; int a, b, c; };
+    struct Key { long long x, y, z; };
+    std::vector<Raw> raw;                       // feasible triple intersections
+    std::vector<Key> keys;                      // quantized key per unique vertex
+    std::vector<int> slots;                     // open-addressing table of unique vertex ids
+    std::vector<std::pair<int,int>> by_vertex;  // (vertex, plane) incidences
+    std::vector<std::pair<int,int>> by_plane;   // (plane, vertex) incidences
+    std::vector<std::pair<int,int>> edges;      // (other plane, vertex) on the current face
+    std::vector<int> nbr;                       // two face neighbors per vertex of the face
+    std::vector<std::pair<double,int>> ang;     // pseudo-angle fallback ordering
+    PlaneSoA soa;                               // the planes as columns, for the inside test
+};
+
+// Build convex polyhedron from intersection of half-spaces n·x <= d, written into P.
+// Every feasible vertex remembers the three planes that generated it; duplicates (quantized
+// to ~100*eps_pos) are merged through a hash table, pooling their planes. Each face is then
+// assembled by walking plane-vertex incidence: on face p, two vertices are joined when they
+// are the only two that share another plane q. Faces where that is ambiguous (collinear
+// vertices, tangent planes) are ordered by pseudo-angle around their centroid instead.
+inline void halfspace_intersection(const std::vector<PlaneWithTag>& planes, const Config& cfg,
+                                   Polyhedron& P, HalfspaceScratch& S){
+    P.clear();
     const size_t N = planes.size();
-    if(N < 4) return P;
-    // collect all triple intersections
-    std::vector<Vec3> verts;
-    verts.reserve(N*N);
+    if(N < 4) return;
+    V3D_PROFILE_BEGIN(phases, TripleIntersection);
+    V3D_PROFILE_COUNT(Cells, 1);
+    V3D_PROFILE_COUNT(CellPlanes, N);
+    V3D_PROFILE_COUNT(CandidateTriples, N*(N-1)*(N-2)/6);
     const double eps_in = std::max(1e-9, cfg.eps_pos*10);
+    auto& raw = S.raw; raw.clear();
+    S.soa.assign(planes, [](const PlaneWithTag& p) -> const Plane& { return p.P; });
     for(size_t a=0;a<N;a++){
         for(size_t b=a+1;b<N;b++){
             for(size_t c=b+1;c<N;c++){
                 Vec3 x;
                 if(!intersect_three(planes[a].P, planes[b].P, planes[c].P, x)) continue;
-                bool inside = true;
-                for(size_t k=0;k<N;k++){
-                    if(point_plane_distance_signed(planes[k].P, x) > eps_in){ inside=false; break; }
-                }
-                if(inside) verts.push_back(x);
+                if(!any_plane_above(S.soa, x, eps_in)) raw.push_back({x, (int)a, (int)b, (int)c});
             }
         }
     }
-    // deduplicate vertices
+    // deduplicate vertices by quantized key
+    V3D_PROFILE_NEXT(phases, VertexDedup);
     const double q = std::max(1e-9, cfg.eps_pos*100);
-    struct Key{ long long x,y,z; };
-    auto keyfn = [q](const Vec3& v)->Key{
-        return Key{ (long long)std::llround(v.x/q), (long long)std::llround(v.y/q), (long long)std::llround(v.z/q) };
-    };
-    std::vector<Vec3> Vuniq;
-    std::vector<int> map_idx(verts.size(), -1);
-    std::vector<Key> keys;
-    keys.reserve(verts.size());
-    for(size_t i=0;i<verts.size();++i){
-        keys.push_back(keyfn(verts[i]));
+    auto& keys = S.keys; keys.clear();
+    auto& slots = S.slots;
+    size_t cap = 16; while(cap < 2*raw.size()) cap <<= 1;
+    slots.assign(cap, -1);
+    auto& byv = S.by_vertex; byv.clear();
+    for(const auto& r : raw){
+        HalfspaceScratch::Key k{ std::llround(r.x.x/q), std::llround(r.x.y/q), std::llround(r.x.z/q) };
+        size_t h = (size_t)hash_combine64(hash_combine64(mix64((uint64_t)k.x), (uint64_t)k.y), (uint64_t)k.z) & (cap-1);
+        int id = -1;
+        for(;; h = (h+1) & (cap-1)){
+            const int s = slots[h];
+            if(s < 0){ id = (int)P.V.size(); slots[h] = id; keys.push_back(k); P.V.push_back(r.x); break; }
+            const auto& o = keys[(size_t)s];
+            if(o.x==k.x && o.y==k.y && o.z==k.z){ id = s; break; }
+        }
+        byv.push_back({id, r.a}); byv.push_back({id, r.b}); byv.push_back({id, r.c});
     }
-    for(size_t i=0;i<verts.size();++i){
-        if(map_idx[i]!=-1) continue;
-        Vuniq.push_back(verts[i]);
-        int gid = (int)Vuniq.size()-1;
-        map_idx[i] = gid;
-        for(size_t j=i+1;j<verts.size();++j){
-            if(map_idx[j]!=-1) continue;
-            if(keys[i].x==keys[j].x && keys[i].y==keys[j].y && keys[i].z==keys[j].z){
-                map_idx[j] = gid;
+    V3D_PROFILE_COUNT(AcceptedVertices, P.V.size());
+    if(P.V.size()<4){ P.clear(); return; }
+    V3D_PROFILE_NEXT(phases, FaceBuild);
+    std::sort(byv.begin(), byv.end());
+    byv.erase(std::unique(byv.begin(), byv.end()), byv.end());
+    auto& byp = S.by_plane; byp.clear();
+    for(const auto& [v, p] : byv) byp.push_back({p, v});
+    std::sort(byp.begin(), byp.end());
+    auto planes_of = [&](int v){ // incidence range of vertex v in by_vertex
+        auto lo = std::lower_bound(byv.begin(), byv.end(), std::make_pair(v, -1));
+        auto hi = std::lower_bound(lo, byv.end(), std::make_pair(v+1, -1));
+        return std::make_pair(lo, hi);
+    };
+
+    auto& edges = S.edges;
+    auto& nbr = S.nbr;
+    for(size_t f0=0; f0<byp.size(); ){
+        size_t f1 = f0; while(f1 < byp.size() && byp[f1].first == byp[f0].first) ++f1;
+        const int pi = byp[f0].first;
+        const size_t nvf = f1 - f0;
+        const size_t start = P.face_index.size();
+        if(nvf < 3){ f0 = f1; continue; }
+        // pair up the face's vertices by the other plane they share
+        edges.clear();
+        for(size_t k=f0; k<f1; ++k){
+            auto [lo, hi] = planes_of(byp[k].second);
+            for(auto it=lo; it!=hi; ++it) if(it->second != pi) edges.push_back({it->second, (int)(k-f0)});
+        }
+        std::sort(edges.begin(), edges.end());
+        nbr.assign(2*nvf, -1);
+        bool walk = true, duplicate = false;
+        for(size_t e0=0; e0<edges.size() && walk; ){
+            size_t e1 = e0; while(e1 < edges.size() && edges[e1].first == edges[e0].first) ++e1;
+            const size_t cnt = e1 - e0;
+            if(cnt == nvf){ if(edges[e0].first < pi) duplicate = true; } // coincident plane
+            else if(cnt == 2){
+                const int u = edges[e0].second, v = edges[e0+1].second;
+                int* nu = &nbr[2*(size_t)u]; int* nv = &nbr[2*(size_t)v];
+                if(nu[0] == v || nu[1] == v) {} // edge already known through another plane
+                else if(nu[1] >= 0 || nv[1] >= 0) walk = false;
+                else { (nu[0] < 0 ? nu[0] : nu[1]) = v; (nv[0] < 0 ? nv[0] : nv[1]) = u; }
             }
+            else if(cnt > 2) walk = false;
+            e0 = e1;
         }
-    }
-    P.V = std::move(Vuniq);
-    if(P.V.size()<4){ P.F.clear(); return P; }
-
-    // Build faces: for each plane, collect vertices on plane
-    for(size_t pi=0; pi<N; ++pi){
-        const Plane& pl = planes[pi].P;
-        std::vector<int> verts_on;
-        for(size_t v=0; v<P.V.size(); ++v){
-            double sd = std::fabs(point_plane_distance_signed(pl, P.V[v]));
-            if(sd <= eps_in*2) verts_on.push_back((int)v);
+        if(duplicate){ f0 = f1; continue; } // same face as a lower-index coincident plane
+        if(walk){
+            int prev = -1, cur = 0;
+            for(size_t step=0; step<nvf; ++step){
+                if(step > 0 && cur == 0){ walk = false; break; } // cycle shorter than the face
+                if(nbr[2*(size_t)cur] < 0 || nbr[2*(size_t)cur+1] < 0){ walk = false; break; }
+                P.face_index.push_back(byp[f0 + (size_t)cur].second);
+                const int nx = nbr[2*(size_t)cur] != prev ? nbr[2*(size_t)cur] : nbr[2*(size_t)cur+1];
+                prev = cur; cur = nx;
+            }
+            if(walk && cur != 0) walk = false;
+            if(walk){ // orient CCW around the outward normal
+                Vec3 nsum{0,0,0};
+                const size_t n = P.face_index.size() - start;
+                for(size_t k=0; k<n; ++k)
+                    nsum += P.V[(size_t)P.face_index[start+k]].cross(P.V[(size_t)P.face_index[start+(k+1)%n]]);
+                if(nsum.dot(planes[(size_t)pi].P.n) < 0) std::reverse(P.face_index.begin()+(std::ptrdiff_t)start, P.face_index.end());
+            }
         }
-        if(verts_on.size()<3) continue;
-        // Order vertices CCW around plane normal
-        Vec3 n = pl.n;
-        Vec3 u = orthonormal_u(n);
-        Vec3 v = n.cross(u);
-        // centroid in 3D
-        Vec3 c{0,0,0}; for(int id: verts_on) c += P.V[id]; c = c / (double)verts_on.size();
-        struct PA{ int id; double ang; };
-        std::vector<PA> proj; proj.reserve(verts_on.size());
-        for(int id: verts_on){
-            Vec3 d = P.V[id] - c;
-            double x = d.dot(u), y = d.dot(v);
-            double ang = std::atan2(y, x);
-            proj.push_back({id, ang});
+        if(!walk){
+            P.face_index.resize(start);
+            const Vec3 n = planes[(size_t)pi].P.n;
+            const Vec3 u = orthonormal_u(n), v = n.cross(u);
+            Vec3 c{0,0,0};
+            for(size_t k=f0; k<f1; ++k) c += P.V[(size_t)byp[k].second];
+            c = c / (double)nvf;
+            auto& ang = S.ang; ang.clear();
+            for(size_t k=f0; k<f1; ++k){
+                const Vec3 d = P.V[(size_t)byp[k].second] - c;
+                ang.push_back({pseudo_angle(d.dot(u), d.dot(v)), byp[k].second});
+            }
+            std::sort(ang.begin(), ang.end());
+            for(const auto& a : ang) P.face_index.push_back(a.second);
         }
-        std::sort(proj.begin(), proj.end(), [](const PA& a, const PA& b){ return a.ang < b.ang; });
-        std::vector<int> loop; loop.reserve(proj.size());
-        for(const auto& p : proj) loop.push_back(p.id);
-        // Append face
-        P.F.push_back(loop);
-        P.face_tag.push_back(planes[pi].tag);
+        P.face_offset.push_back((int)P.face_index.size());
+        P.face_tag.push_back(planes[(size_t)pi].tag);
+        f0 = f1;
     }
+    V3D_PROFILE_STOP(phases);
     compute_face_attributes(P);
     prune_tiny_faces(P, cfg);
+}
+
+inline Polyhedron halfspace_intersection(const std::vector<PlaneWithTag>& planes, const Config& cfg){
+    static thread_local HalfspaceScratch S;
+    Polyhedron P;
+    halfspace_intersection(planes, cfg, P, S);
     return P;
 }
 
@@ -206,7 +316,8 @@ inline Polyhedron halfspace_intersection(const std::vector<PlaneWithTag>& planes
 inline std::pair<double, Vec3> polyhedron_volume_centroid(const Polyhedron& P){
     double V = 0.0;
     Vec3 C{0,0,0};
-    for(const auto& loop : P.F){
+    for(size_t f=0; f<P.num_faces(); ++f){
+        const auto loop = P.face(f);
         if(loop.size()<3) continue;
         const Vec3& v0 = P.V[loop[0]];
         for(size_t k=1; k+1<loop.size(); ++k){
@@ -227,8 +338,9 @@ inline std::pair<double, Vec3> polyhedron_volume_centroid(const Polyhedron& P){
 // Volume via face formula (kept for reference / debugging)
 inline double polyhedron_volume(const Polyhedron& P){
     double V = 0.0;
-    if(P.F.size()!=P.face_area.size() || P.F.size()!=P.face_centroid.size() || P.F.size()!=P.face_normal.size()) return 0.0;
-    for(size_t f=0; f<P.F.size(); ++f){
+    const size_t nf = P.num_faces();
+    if(nf!=P.face_area.size() || nf!=P.face_centroid.size() || nf!=P.face_normal.size()) return 0.0;
+    for(size_t f=0; f<nf; ++f){
         V += (P.face_area[f] * P.face_normal[f].dot(P.face_centroid[f])) / 3.0;
     }
     return std::fabs(V);
@@ -0,0 +1,245 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#ifdef V3D_PROFILE
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace v3d {
+
+// Optional per-phase profiling, compiled in with V3D_PROFILE (CMake: VORONOI3D_PROFILE). Code is
+// instrumented through the V3D_PROFILE_* macros at the end of this file, which expand to nothing
+// (arguments unevaluated) when it is off.
+//
+// Every thread adds to its own block of counters; a snapshot sums the blocks of all threads, so
+// the difference of two snapshots covers the work of every thread in between (of concurrent
+// calls too, if there are any). A ProfileCall instead collects only the work done for it: on
+// its own thread and on the worker threads it hands work to (parallel_for, the planning thread
+// of tessellate_frames), which pass the call along with V3D_PROFILE_CONTEXT/WORKER. Phase times
+// are wall time summed over the threads that ran them.
+enum class ProfilePhase : uint8_t {
+    PlanNeighbors, Clip, TripleIntersection, VertexDedup, FaceBuild, FaceAttributes, PruneFaces,
+    Stitch, PythonConversion, Count
+};
+enum class ProfileCounter : uint8_t {
+    Cells,              // cells built (by clipping or halfspace_intersection)
+    CellPlanes,         // planes tested against those cells
+    FallbackCells,      // cells rebuilt by halfspace_intersection after clipping failed
+    CandidateTriples,   // plane triples tried by halfspace_intersection
+    AcceptedVertices,   // distinct feasible vertices they produced
+    PrunedFaces,        // faces below cfg.min_face_area
+    BytesAllocated,     // storage of the outputs: tables, cell polyhedra, meshes, result columns
+    Count
+};
+constexpr size_t kProfilePhases = (size_t)ProfilePhase::Count;
+constexpr size_t kProfileCounters = (size_t)ProfileCounter::Count;
+
+inline const char* profile_phase_name(ProfilePhase p){
+    static const char* const names[kProfilePhases] = {
+        "plan_neighbors", "clip", "triple_intersection", "vertex_dedup", "face_build",
+        "face_attributes", "prune_faces", "stitch", "python_conversion" };
+    return names[(size_t)p];
+}
+inline const char* profile_counter_name(ProfileCounter c){
+    static const char* const names[kProfileCounters] = {
+        "cells", "cell_planes", "fallback_cells", "candidate_triples", "accepted_vertices",
+        "pruned_faces", "bytes_allocated" };
+    return names[(size_t)c];
+}
+
+// Counters over an interval (one call): seconds per phase, counts, and the interval's wall time
+struct ProfileStats {
+    std::array<double, kProfilePhases> seconds{};
+    std::array<uint64_t, kProfileCounters> counts{};
+    double wall = 0.0;
+
+    double phase(ProfilePhase p) const { return seconds[(size_t)p]; }
+    uint64_t count(ProfileCounter c) const { return counts[(size_t)c]; }
+    double planes_per_cell() const {
+        const uint64_t n = count(ProfileCounter::Cells);
+        return n ? (double)count(ProfileCounter::CellPlanes) / (double)n : 0.0;
+    }
+};
+
+// Bytes held by a set of vectors (their capacity)
+template<class... V>
+inline uint64_t capacity_bytes(const V&... v){
+    return (0 + ... + (uint64_t)(v.capacity() * sizeof(typename V::value_type)));
+}
+
+#ifdef V3D_PROFILE
+
+// One thread's counters (phases in ns, then counts). Only the owning thread writes, so relaxed
+// load + store suffices; snapshots read from any thread.
+struct ProfileBlock { std::array<std::atomic<uint64_t>, kProfilePhases + kProfileCounters> v{}; };
+
+struct ProfileRegistry {
+    std::mutex mu;
+    std::vector<std::unique_ptr<ProfileBlock>> blocks;
+    std::vector<ProfileBlock*> idle;   // blocks of exited threads, totals kept, reused by new ones
+};
+inline ProfileRegistry& profile_registry(){ static ProfileRegistry R; return R; }
+
+inline ProfileBlock& profile_block(){
+    struct Owner {
+        ProfileBlock* b = nullptr;
+        Owner(){
+            ProfileRegistry& R = profile_registry();
+            std::lock_guard<std::mutex> lock(R.mu);
+            if(!R.idle.empty()){ b = R.idle.back(); R.idle.pop_back(); }
+            else { R.blocks.push_back(std::make_unique<ProfileBlock>()); b = R.blocks.back().get(); }
+        }
+        ~Owner(){
+            ProfileRegistry& R = profile_registry();
+            std::lock_guard<std::mutex> lock(R.mu);
+            R.idle.push_back(b);
+        }
+    };
+    thread_local Owner owner;
+    return *owner.b;
+}
+
+// Counters of one call, shared by the threads working for it; nested calls also add to the
+// enclosing one
+struct ProfileAttribution {
+    std::array<std::atomic<uint64_t>, kProfilePhases + kProfileCounters> v{};
+    ProfileAttribution* parent = nullptr;
+    void add(size_t slot, uint64_t x){
+        for(ProfileAttribution* a = this; a; a = a->parent) a->v[slot].fetch_add(x, std::memory_order_relaxed);
+    }
+};
+// The call this thread is working for, if any
+inline ProfileAttribution*& profile_attribution(){ thread_local ProfileAttribution* a = nullptr; return a; }
+
+inline void profile_add(size_t slot, uint64_t x){
+    std::atomic<uint64_t>& a = profile_block().v[slot];
+    a.store(a.load(std::memory_order_relaxed) + x, std::memory_order_relaxed);
+    if(ProfileAttribution* c = profile_attribution()) c->add(slot, x);
+}
+
+// Charges the work of a worker thread to the call `to` (captured on the thread that started the
+// work); collected locally and added to the call once, at the end of the scope
+class ProfileWorkerScope {
+public:
+    explicit ProfileWorkerScope(ProfileAttribution* to) : to_(to), prev_(profile_attribution()) {
+        if(to_) profile_attribution() = &local_;
+    }
+    ~ProfileWorkerScope(){
+        if(!to_) return;
+        profile_attribution() = prev_;
+        for(size_t k=0; k<local_.v.size(); ++k){
+            const uint64_t x = local_.v[k].load(std::memory_order_relaxed);
+            if(x) to_->add(k, x);
+        }
+    }
+    ProfileWorkerScope(const ProfileWorkerScope&) = delete;
+    ProfileWorkerScope& operator=(const ProfileWorkerScope&) = delete;
+private:
+    ProfileAttribution* to_;
+    ProfileAttribution* prev_;
+    ProfileAttribution local_;
+};
+inline void profile_count(ProfileCounter c, uint64_t n){ profile_add(kProfilePhases + (size_t)c, n); }
+
+inline uint64_t profile_now_ns(){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Totals of all threads so far
+inline ProfileStats profile_snapshot(){
+    ProfileStats S;
+    ProfileRegistry& R = profile_registry();
+    std::lock_guard<std::mutex> lock(R.mu);
+    for(const auto& b : R.blocks){
+        for(size_t k=0; k<kProfilePhases; ++k) S.seconds[k] += 1e-9 * (double)b->v[k].load(std::memory_order_relaxed);
+        for(size_t k=0; k<kProfileCounters; ++k) S.counts[k] += b->v[kProfilePhases + k].load(std::memory_order_relaxed);
+    }
+    return S;
+}
+
+// Charges elapsed wall time to the current phase; next() switches phase, stop() ends timing
+class ProfileTimer {
+public:
+    explicit ProfileTimer(ProfilePhase p) : phase_(p), t0_(profile_now_ns()) {}
+    ~ProfileTimer(){ stop(); }
+    ProfileTimer(const ProfileTimer&) = delete;
+    ProfileTimer& operator=(const ProfileTimer&) = delete;
+    void next(ProfilePhase p){
+        const uint64_t t = profile_now_ns();
+        if(running_) profile_add((size_t)phase_, t - t0_);
+        phase_ = p; t0_ = t; running_ = true;
+    }
+    void stop(){
+        if(!running_) return;
+        profile_add((size_t)phase_, profile_now_ns() - t0_);
+        running_ = false;
+    }
+private:
+    ProfilePhase phase_;
+    uint64_t t0_;
+    bool running_ = true;
+};
+
+// Counters of the last instrumented call made by this thread (see ProfileCall)
+inline ProfileStats& last_profile(){ thread_local ProfileStats S; return S; }
+
+// Records the work done for the enclosing scope (on this thread and its workers, see
+// ProfileWorkerScope) as last_profile(); work of concurrent calls is not included. The outermost
+// of nested calls writes last.
+class ProfileCall {
+public:
+    ProfileCall() : prev_(profile_attribution()), t0_(profile_now_ns()) {
+        acc_.parent = prev_;
+        profile_attribution() = &acc_;
+    }
+    ~ProfileCall(){
+        profile_attribution() = prev_;
+        ProfileStats S;
+        for(size_t k=0; k<kProfilePhases; ++k) S.seconds[k] = 1e-9 * (double)acc_.v[k].load(std::memory_order_relaxed);
+        for(size_t k=0; k<kProfileCounters; ++k) S.counts[k] = acc_.v[kProfilePhases + k].load(std::memory_order_relaxed);
+        S.wall = 1e-9 * (double)(profile_now_ns() - t0_);
+        last_profile() = S;
+    }
+    ProfileCall(const ProfileCall&) = delete;
+    ProfileCall& operator=(const ProfileCall&) = delete;
+private:
+    ProfileAttribution acc_;
+    ProfileAttribution* prev_;
+    uint64_t t0_;
+};
+
+#define V3D_PROFILE_CAT2(a, b) a##b
+#define V3D_PROFILE_CAT(a, b) V3D_PROFILE_CAT2(a, b)
+// time the rest of the enclosing scope as `phase`
+#define V3D_PROFILE_SCOPE(phase) ::v3d::ProfileTimer V3D_PROFILE_CAT(v3d_profile_scope_, __LINE__)(::v3d::ProfilePhase::phase)
+// a named timer for consecutive phases of one scope
+#define V3D_PROFILE_BEGIN(timer, phase) ::v3d::ProfileTimer timer(::v3d::ProfilePhase::phase)
+#define V3D_PROFILE_NEXT(timer, phase) timer.next(::v3d::ProfilePhase::phase)
+#define V3D_PROFILE_STOP(timer) timer.stop()
+#define V3D_PROFILE_COUNT(counter, n) ::v3d::profile_count(::v3d::ProfileCounter::counter, (uint64_t)(n))
+// make the enclosing scope a call reported by last_profile()
+#define V3D_PROFILE_CALL() ::v3d::ProfileCall V3D_PROFILE_CAT(v3d_profile_call_, __LINE__)
+// capture the call of this thread as `name`, and charge the enclosing scope of a worker thread to it
+#define V3D_PROFILE_CONTEXT(name) ::v3d::ProfileAttribution* const name = ::v3d::profile_attribution()
+#define V3D_PROFILE_WORKER(name) ::v3d::ProfileWorkerScope V3D_PROFILE_CAT(v3d_profile_worker_, __LINE__)(name)
+
+#else
+
+#define V3D_PROFILE_SCOPE(phase) ((void)0)
+#define V3D_PROFILE_BEGIN(timer, phase) ((void)0)
+#define V3D_PROFILE_NEXT(timer, phase) ((void)0)
+#define V3D_PROFILE_STOP(timer) ((void)0)
+#define V3D_PROFILE_COUNT(counter, n) ((void)0)
+#define V3D_PROFILE_CALL() ((void)0)
+#define V3D_PROFILE_CONTEXT(name) ((void)0)
+#define V3D_PROFILE_WORKER(name) ((void)0)
+
+#endif
+
+} // namespace v3d
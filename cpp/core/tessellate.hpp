@@ -1,10 +1,17 @@
 #pragma once
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
 #include "vec.hpp"
 #include "plane.hpp"
 #include "polyhedron.hpp"
+#include "cell_builder.hpp"
+#include "parallel.hpp"
 #include "neighbor.hpp"
+#include "profiling.hpp"
 #include "../containers/box_container.hpp"
 #include "../containers/triclinic_pbc.hpp"
 
@@ -15,6 +22,8 @@ struct CellResult {
     Polyhedron poly;
     double volume = 0.0;
     Vec3 centroid{0,0,0};
+    int rows_used = 0;    // neighbor/cap planes tested against the cell
+    int rows_skipped = 0; // rows without a plane or beyond the security radius, never clipped
 };
 
 inline Plane box_plane_x_le(double x){ return Plane{Vec3{1,0,0}, x}; }      // x <= hi
@@ -24,93 +33,195 @@ inline Plane box_plane_y_ge(double y){ return Plane{Vec3{0,-1,0}, -y}; }
 inline Plane box_plane_z_le(double z){ return Plane{Vec3{0,0,1}, z}; }
 inline Plane box_plane_z_ge(double z){ return Plane{Vec3{0,0,-1}, -z}; }
 
-inline std::vector<int> rows_for_atom_i(const NeighborTable& T, int i){
+// Per-atom row lookup. Planner tables carry CSR offsets and are used directly; tables without
+// them (or with rows not grouped by i) are indexed once with a counting sort into `perm`.
+struct AtomRows {
+    std::vector<int64_t> offsets; // empty: use T.offsets
+    std::vector<int32_t> perm;    // empty: row k of the CSR range is table row k (half tables: T.by_atom)
+};
+
+template<class Real>
+inline AtomRows atom_rows(const BasicNeighborTable<Real>& T, size_t N){
+    AtomRows A;
+    if(has_offsets(T, N)) return A;
+    A.offsets.assign(N+1, 0);
+    for(int32_t a : T.i) if(a >= 0 && (size_t)a < N) A.offsets[(size_t)a+1]++;
+    for(size_t a=0; a<N; ++a) A.offsets[a+1] += A.offsets[a];
+    A.perm.resize((size_t)A.offsets[N]);
+    std::vector<int64_t> fill(A.offsets.begin(), A.offsets.end()-1);
+    for(size_t r=0; r<T.i.size(); ++r){
+        const int32_t a = T.i[r];
+        if(a >= 0 && (size_t)a < N) A.perm[(size_t)fill[(size_t)a]++] = (int32_t)r;
+    }
+    return A;
+}
+
+// Half tables carry their per-atom index of oriented rows (T.by_atom, nearest first) from the
+// planners; tables without it (from_arrays) get the same index built here.
+template<class Real>
+inline AtomRows atom_rows(const BasicNeighborTable<Real,true>& T, size_t N, int num_threads = 0){
+    AtomRows A;
+    if(!has_by_atom(T, N)) by_atom_index(T, N, num_threads, A.offsets, A.perm);
+    return A;
+}
+
+template<class Real, bool Half>
+inline void rows_for_atom_i(const BasicNeighborTable<Real,Half>& T, const AtomRows& A, int i, std::vector<int>& rows){
+    const std::vector<int64_t>* off = &T.offsets;
+    const std::vector<int32_t>* perm = &A.perm;
+    if(!A.offsets.empty()) off = &A.offsets;
+    else if constexpr (Half){ off = &T.by_atom_offsets; perm = &T.by_atom; }
+    rows.clear();
+    for(int64_t k=(*off)[(size_t)i]; k<(*off)[(size_t)i+1]; ++k)
+        rows.push_back(perm->empty() ? (int)k : (int)(*perm)[(size_t)k]);
+}
+
+template<class Real>
+inline std::vector<int> rows_for_atom_i(const BasicNeighborTable<Real>& T, int i){
     std::vector<int> rows;
+    if(i >= 0 && (size_t)i < T.num_atoms() && has_offsets(T, T.num_atoms())){ rows_for_atom_i(T, AtomRows{}, i, rows); return rows; }
     for(size_t r=0;r<T.i.size();++r) if(T.i[r]==i) rows.push_back((int)r);
     return rows;
 }
 
+// Rows of atom i ordered nearest first; tables from the planners already are, others get sorted
+template<class Real, bool Half>
+inline void rows_nearest_first(const BasicNeighborTable<Real,Half>& T, const AtomRows& A, int i, std::vector<int>& rows){
+    rows_for_atom_i(T, A, i, rows);
+    if constexpr (Half) return;   // the by-atom index is sorted when built
+    auto closer = [&](int a, int b){ return row_r2(T, (size_t)a) < row_r2(T, (size_t)b); };
+    if(!std::is_sorted(rows.begin(), rows.end(), closer)) std::stable_sort(rows.begin(), rows.end(), closer);
+}
+
+// Plane of oriented row r around ri (half-space n·x <= d kept, tagged with the row). `reach` is
+// the smallest distance from ri any row at least this far away can have its plane at.
+template<class Real, bool Half>
+inline bool neighbor_plane(const Vec3& ri, const BasicNeighborTable<Real,Half>& T, const std::vector<double>& M,
+                           int r, const Config& cfg, PlaneWithTag& H, double& reach){
+    Vec3 d = row_disp(T, (size_t)r);
+    double L = d.norm();
+    if(L==0) return false;
+    double m = std::min(std::max(row_M(T, M, (size_t)r), cfg.min_M), 1.0 - cfg.min_M);
+    H = { from_point_normal(ri + d * m, d / L), r };
+    reach = std::max(0.0, std::min(cfg.min_M, 1.0 - cfg.min_M)) * L;
+    // float32 rows are ordered by the exact r2 but rounded independently, so later rows may
+    // come out a few ulps shorter; keep the bound conservative
+    if constexpr (!std::is_same_v<Real, double>) reach *= 1.0 - 16*(double)std::numeric_limits<Real>::epsilon();
+    return true;
+}
+
+// Result of the cell left in ws.poly by build_cell. The copy is sized to the cell (moving the
+// workspace out would hand every stored result the thread's high-water capacity); it is the
+// only per-cell allocation.
+inline CellResult take_cell(int i, const CellWorkspace& ws, const CellStats& st){
+    CellResult C; C.atom_id = i;
+    C.poly = ws.poly;
+    V3D_PROFILE_COUNT(BytesAllocated, capacity_bytes(C.poly.V, C.poly.face_index, C.poly.face_offset, C.poly.face_normal,
+                                                     C.poly.face_area, C.poly.face_centroid, C.poly.face_tag));
+    auto [V,Cc] = polyhedron_volume_centroid(C.poly);
+    C.volume = V; C.centroid = Cc;
+    C.rows_used = st.rows_used; C.rows_skipped = st.rows_skipped;
+    return C;
+}
+
+// Clip `seed` by the neighbor planes of ws.rows (nearest first) with the security radius
+template<class Real, bool Half>
+inline CellResult build_neighbor_cell(int i, const Vec3& ri, const SeedBox& seed, const BasicNeighborTable<Real,Half>& T,
+                                      const std::vector<double>& M, const Config& cfg, CellWorkspace& ws){
+    CellStats st;
+    build_cell(seed, ri, ws.rows.size(), [&](size_t k, PlaneWithTag& H, double& reach){
+        return neighbor_plane(ri, T, M, ws.rows[k], cfg, H, reach);
+    }, cfg, ws, &st);
+    return take_cell(i, ws, st);
+}
+
+// Box walls as a seed: x >= lo.x (-1000), x <= hi.x (-1001), ... z <= hi.z (-1005)
+inline SeedBox box_seed(const BoxBounds& b){
+    SeedBox S;
+    for(int k=0;k<3;++k){
+        S.lo[k] = b.lo[k]; S.hi[k] = b.hi[k];
+        S.tag_lo[k] = -1000 - 2*k; S.tag_hi[k] = -1001 - 2*k;
+    }
+    return S;
+}
+
+// Self-image planes (midway to the atom's own image along each periodic lattice vector) as a
+// seed; non-periodic axes get a wide slab (tag -1) so the seed stays bounded.
+inline SeedBox pbc_seed(const TriclinicPBC& pbc, int i, double reach){
+    const Vec3 a[3] = { pbc.lat.A.c0, pbc.lat.A.c1, pbc.lat.A.c2 };
+    const double span = a[0].norm() + a[1].norm() + a[2].norm();
+    SeedBox S;
+    for(int axis=0; axis<3; ++axis){
+        double Ls = a[axis].norm();
+        S.n[axis] = (Ls>0) ? a[axis] / Ls : Vec3{axis==0?1.0:0.0, axis==1?1.0:0.0, axis==2?1.0:0.0};
+        double c = S.n[axis].dot(pbc.pos[(size_t)i]);
+        double half = pbc.periodic[axis] ? 0.5*Ls : 2.0*reach + span;
+        S.lo[axis] = c - half; S.hi[axis] = c + half;
+        S.tag_lo[axis] = pbc.periodic[axis] ? -2000 - axis*2 : -1;
+        S.tag_hi[axis] = pbc.periodic[axis] ? -2000 - axis*2 - 1 : -1;
+    }
+    return S;
+}
+
+// Cells of atoms ids[0..n) written to out[0..n); ids may be any subset/order of the atoms
+template<class Real, bool Half>
+inline void tessellate_atoms(const BoxContainer& box, const BasicNeighborTable<Real,Half>& T, const AtomRows& A,
+                             const std::vector<double>& M, const Config& cfg,
+                             const int32_t* ids, size_t n, std::vector<CellResult>& out){
+    out.resize(n);
+    const SeedBox seed = box_seed(box.bounds);
+    parallel_for(n, cfg.num_threads, [&](size_t k){
+        const int i = ids[k];
+        CellWorkspace& ws = thread_workspace();
+        rows_nearest_first(T, A, i, ws.rows);
+        out[k] = build_neighbor_cell(i, box.pos[(size_t)i], seed, T, M, cfg, ws);
+    });
+}
+
+template<class Real, bool Half>
+inline void tessellate_atoms(const TriclinicPBC& pbc, const BasicNeighborTable<Real,Half>& T, const AtomRows& A,
+                             const std::vector<double>& M, const Config& cfg,
+                             const int32_t* ids, size_t n, std::vector<CellResult>& out){
+    out.resize(n);
+    parallel_for(n, cfg.num_threads, [&](size_t k){
+        const int i = ids[k];
+        CellWorkspace& ws = thread_workspace();
+        rows_nearest_first(T, A, i, ws.rows);
+        // distance of the atom's farthest row: sets the walls of non-periodic axes
+        double reach2 = 0.0;
+        for(int r : ws.rows) reach2 = std::max(reach2, row_r2(T, (size_t)r));
+        const double reach = std::sqrt(reach2);
+        // Self-image planes along periodic axes (±1) form the seed, ensuring closure
+        out[k] = build_neighbor_cell(i, pbc.pos[(size_t)i], pbc_seed(pbc, i, reach), T, M, cfg, ws);
+    });
+}
+
+template<class Container, class Real, bool Half>
+inline std::vector<CellResult> tessellate_pairs_impl(const Container& c, const BasicNeighborTable<Real,Half>& T,
+                                                     const std::vector<double>& M, const Config& cfg){
+    const size_t N = c.pos.size();
+    std::vector<int32_t> ids(N);
+    for(size_t i=0; i<N; ++i) ids[i] = (int32_t)i;
+    std::vector<CellResult> out;
+    tessellate_atoms(c, T, atom_rows(T, N), M, cfg, ids.data(), N, out);
+    return out;
+}
+
+// M has one entry per stored row (for a half table, the stored orientation; see row_M)
+template<class Real, bool Half>
 inline std::vector<CellResult> tessellate_pairs(const BoxContainer& box,
-                                                const NeighborTable& T,
+                                                const BasicNeighborTable<Real,Half>& T,
                                                 const std::vector<double>& M,
                                                 const Config& cfg){
-    const int N = (int)box.pos.size();
-    std::vector<CellResult> out; out.reserve(N);
-    for(int i=0;i<N;i++){
-        std::vector<int> rows = rows_for_atom_i(T, i);
-        std::vector<PlaneWithTag> planes;
-        planes.reserve(6 + rows.size());
-        // Box walls
-        planes.push_back({ box_plane_x_ge(box.bounds.lo.x), -1000 });
-        planes.push_back({ box_plane_x_le(box.bounds.hi.x), -1001 });
-        planes.push_back({ box_plane_y_ge(box.bounds.lo.y), -1002 });
-        planes.push_back({ box_plane_y_le(box.bounds.hi.y), -1003 });
-        planes.push_back({ box_plane_z_ge(box.bounds.lo.z), -1004 });
-        planes.push_back({ box_plane_z_le(box.bounds.hi.z), -1005 });
-        // Neighbor planes
-        for(int r : rows){
-            Vec3 d = T.disp[(size_t)r];
-            double L = d.norm();
-            if(L==0) continue;
-            Vec3 n = d / L;
-            double m = std::min(std::max(M[(size_t)r], cfg.min_M), 1.0 - cfg.min_M);
-            Vec3 p = box.pos[i] + d * m;
-            Plane Hp = from_point_normal(p, n); // keep half-space n·x <= d
-            planes.push_back({Hp, r});
-        }
-        Polyhedron P = halfspace_intersection(planes, cfg);
-        CellResult C; C.atom_id=i; C.poly = std::move(P);
-        auto [V,Cc] = polyhedron_volume_centroid(C.poly);
-        C.volume = V; C.centroid = Cc;
-        out.push_back(std::move(C));
-    }
-    return out;
+    return tessellate_pairs_impl(box, T, M, cfg);
 }
 
+template<class Real, bool Half>
 inline std::vector<CellResult> tessellate_pairs(const TriclinicPBC& pbc,
-                                                const NeighborTable& T,
+                                                const BasicNeighborTable<Real,Half>& T,
                                                 const std::vector<double>& M,
                                                 const Config& cfg){
-    const int N = (int)pbc.pos.size();
-    std::vector<CellResult> out; out.reserve(N);
-    for(int i=0;i<N;i++){
-        std::vector<int> rows = rows_for_atom_i(T, i);
-        std::vector<PlaneWithTag> planes;
-        planes.reserve(rows.size());
-        for(int r : rows){
-            Vec3 d = T.disp[(size_t)r];
-            double L = d.norm();
-            if(L==0) continue;
-            Vec3 n = d / L;
-            double m = std::min(std::max(M[(size_t)r], cfg.min_M), 1.0 - cfg.min_M);
-            Vec3 p = pbc.pos[i] + d * m;
-            Plane Hp = from_point_normal(p, n); // keep half-space n·x <= d
-            planes.push_back({Hp, r});
-        }
-        
-        // Add self-image planes along periodic axes (±1) to ensure closure
-        for(int axis=0; axis<3; ++axis){
-            if(!pbc.periodic[axis]) continue;
-            for(int s : {-1, +1}){
-                Vec3 im = (axis==0? pbc.lat.A.c0 * (double)s
-                         : axis==1? pbc.lat.A.c1 * (double)s
-                                  : pbc.lat.A.c2 * (double)s);
-                double Ls = im.norm();
-                if(Ls==0) continue;
-                Vec3 nself = im / Ls;
-                Vec3 pself = pbc.pos[i] + im * 0.5; // midpoint between atom and its image
-                Plane Hs = from_point_normal(pself, nself); // keep n·x <= d (outside is towards image)
-                int tag = -2000 - axis*2 - (s<0?0:1);
-                planes.push_back({Hs, tag});
-            }
-        }
-Polyhedron P = halfspace_intersection(planes, cfg);
-        CellResult C; C.atom_id=i; C.poly = std::move(P);
-        auto [V,Cc] = polyhedron_volume_centroid(C.poly);
-        C.volume = V; C.centroid = Cc;
-        out.push_back(std::move(C));
-    }
-    return out;
+    return tessellate_pairs_impl(pbc, T, M, cfg);
 }
 
 } // namespace v3d
@@ -1,11 +1,16 @@
 #pragma once
 #include <vector>
 #include <unordered_set>
+#include <algorithm>
+#include <cmath>
 #include "vec.hpp"
 #include "plane.hpp"
 #include "polyhedron.hpp"
 #include "neighbor.hpp"
 #include "lebedev.hpp"
+#include "cell_builder.hpp"
+#include "tessellate.hpp"
+#include "parallel.hpp"
 #include "../containers/box_container.hpp"
 
 namespace v3d {
@@ -13,7 +18,7 @@ namespace v3d {
 struct CapOptions {
     bool enabled = false;
     double radius = 1.0;
-    int lebedev_order = 26; // 6, 14, or 26 supported here
+    int lebedev_order = 26; // cap directions: smallest Lebedev grid (6..194 points) with at least this many, Fibonacci beyond
     std::vector<int> surface_atom_ids; // if empty and auto_surface_margin>0, auto-detect
     double auto_surface_margin = 0.0;  // mark atoms within this distance from any wall as surface
 };
@@ -38,53 +43,53 @@ inline bool is_surface_atom_box(const BoxContainer& box, int i, const CapOptions
     return false;
 }
 
+// Cap planes n·x <= n·ri + radius for the (cached) directions n replace the walls of surface
+// atoms. Caps all lie at distance `radius`, so they are slotted into the nearest-first row
+// sequence between the rows that can reach closer and those that cannot: neighbor planes trim
+// the cell first, and the security radius then skips every cap (and every farther row) once the
+// cell lies within the cap sphere. Each remaining cap only clips if a vertex still reaches it.
 inline std::vector<CellResult> tessellate_pairs_with_caps(const BoxContainer& box,
                                                           const NeighborTable& T,
                                                           const std::vector<double>& M,
                                                           const CapOptions& opt,
                                                           const Config& cfg){
     const int N = (int)box.pos.size();
-    std::vector<CellResult> out; out.reserve(N);
-    auto dirs = lebedev_dirs(opt.lebedev_order);
-    for(int i=0;i<N;i++){
-        std::vector<int> rows;
-        for(size_t r=0;r<T.i.size();++r) if(T.i[r]==i) rows.push_back((int)r);
-        std::vector<PlaneWithTag> planes;
-        bool use_caps = is_surface_atom_box(box, i, opt);
-        if(!use_caps){
-            // Keep box walls for interior atoms
-            planes.push_back({ Plane{Vec3{-1,0,0}, -box.bounds.lo.x}, -1000 });
-            planes.push_back({ Plane{Vec3{+1,0,0},  box.bounds.hi.x}, -1001 });
-            planes.push_back({ Plane{Vec3{0,-1,0}, -box.bounds.lo.y}, -1002 });
-            planes.push_back({ Plane{Vec3{0,+1,0},  box.bounds.hi.y}, -1003 });
-            planes.push_back({ Plane{Vec3{0,0,-1}, -box.bounds.lo.z}, -1004 });
-            planes.push_back({ Plane{Vec3{0,0,+1},  box.bounds.hi.z}, -1005 });
-        } else {
-            // Add spherical caps around atom i
-            const Vec3& ri = box.pos[i];
-            for(size_t k=0;k<dirs.size();++k){
-                Vec3 n = dirs[k];
-                Vec3 p = ri + n*opt.radius;
-                Plane H = from_point_normal(p, n); // n·x <= n·(ri + R)
-                planes.push_back({H, -3000 - (int)k});
+    std::vector<CellResult> out((size_t)N);
+    const std::vector<Vec3>& dirs = lebedev_dirs(opt.lebedev_order);
+    const double near = std::max(0.0, std::min(cfg.min_M, 1.0 - cfg.min_M)); // reach per unit |d|
+    const AtomRows A = atom_rows(T, (size_t)N);
+    parallel_for((size_t)N, cfg.num_threads, [&](size_t ui){
+        const int i = (int)ui;
+        CellWorkspace& ws = thread_workspace();
+        rows_nearest_first(T, A, i, ws.rows);
+        const std::vector<int>& rows = ws.rows;
+        const bool use_caps = is_surface_atom_box(box, i, opt);
+        const size_t ncap = use_caps ? dirs.size() : 0;
+        const Vec3& ri = box.pos[i];
+        SeedBox seed = box_seed(box.bounds); // keep box walls for interior atoms
+        if(use_caps){
+            // Spherical caps around atom i replace the walls; a cube twice the cap radius seeds them
+            for(int k=0;k<3;++k){
+                seed.n[k] = Vec3{k==0?1.0:0.0, k==1?1.0:0.0, k==2?1.0:0.0};
+                seed.lo[k] = ri[k] - 2.0*opt.radius; seed.hi[k] = ri[k] + 2.0*opt.radius;
+                seed.tag_lo[k] = seed.tag_hi[k] = -1;
             }
         }
-        // neighbor planes
-        for(int r : rows){
-            Vec3 d = T.disp[(size_t)r];
-            double L = d.norm(); if(L==0) continue;
-            Vec3 n = d / L;
-            double m = std::min(std::max(M[(size_t)r], cfg.min_M), 1.0 - cfg.min_M);
-            Vec3 p = box.pos[i] + d*m;
-            Plane Hp = from_point_normal(p, n);
-            planes.push_back({Hp, r});
-        }
-        Polyhedron P = halfspace_intersection(planes, cfg);
-        CellResult C; C.atom_id = i; C.poly = std::move(P);
-        auto [V,Cc] = polyhedron_volume_centroid(C.poly);
-        C.volume = V; C.centroid = Cc;
-        out.push_back(std::move(C));
-    }
+        // rows [0, split) may reach closer than the caps, rows [split, end) cannot
+        const size_t split = ncap == 0 ? rows.size() : (size_t)(std::partition_point(rows.begin(), rows.end(), [&](int r){
+            return near * std::sqrt(T.r2[(size_t)r]) < opt.radius;
+        }) - rows.begin());
+        CellStats st;
+        build_cell(seed, ri, rows.size() + ncap, [&](size_t k, PlaneWithTag& H, double& reach){
+            if(k < split) return neighbor_plane(ri, T, M, rows[k], cfg, H, reach);
+            if(k >= split + ncap) return neighbor_plane(ri, T, M, rows[k - ncap], cfg, H, reach);
+            const size_t c = k - split;
+            H = { from_point_normal(ri + dirs[c]*opt.radius, dirs[c]), -3000 - (int)c };
+            reach = opt.radius;
+            return true;
+        }, cfg, ws, &st);
+        out[ui] = take_cell(i, ws, st);
+    });
     return out;
 }
 
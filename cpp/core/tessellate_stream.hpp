@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <numeric>
+#include "vec.hpp"
+#include "tessellate.hpp"
+
+namespace v3d {
+
+// Spread the low 21 bits of x so that they occupy every third bit
+inline uint64_t morton_spread21(uint64_t x){
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2)  & 0x1249249249249249ULL;
+    return x;
+}
+
+// Atom ids in Morton (Z-curve) order of their positions, on a 2^21 grid over the bounding box;
+// ties keep id order. Consecutive runs of this order are spatially compact.
+inline std::vector<int32_t> morton_order(const std::vector<Vec3>& pos){
+    const size_t N = pos.size();
+    std::vector<int32_t> ids(N);
+    std::iota(ids.begin(), ids.end(), 0);
+    if(N == 0) return ids;
+    Vec3 lo = pos[0], hi = pos[0];
+    for(const Vec3& p : pos) for(int k=0;k<3;++k){ lo[k] = std::min(lo[k], p[k]); hi[k] = std::max(hi[k], p[k]); }
+    std::vector<uint64_t> code(N);
+    for(size_t i=0; i<N; ++i){
+        uint64_t c = 0;
+        for(int k=0;k<3;++k){
+            const double ext = hi[k] - lo[k];
+            const double t = (ext > 0) ? (pos[i][k] - lo[k]) / ext : 0.0;
+            c |= morton_spread21((uint64_t)std::clamp(t * 2097151.0, 0.0, 2097151.0)) << k;
+        }
+        code[i] = c;
+    }
+    std::stable_sort(ids.begin(), ids.end(), [&](int32_t a, int32_t b){ return code[(size_t)a] < code[(size_t)b]; });
+    return ids;
+}
+
+// Tessellate in chunks of chunk_size atoms taken along morton_order(c.pos), calling
+// on_chunk(std::vector<CellResult>& cells) after each chunk; the buffer is reused, so only one
+// chunk of polyhedra is alive at a time. Cells carry their atom_id.
+template<class Container, class F>
+inline void tessellate_pairs_chunked(const Container& c, const NeighborTable& T,
+                                     const std::vector<double>& M, const Config& cfg,
+                                     size_t chunk_size, F&& on_chunk){
+    const size_t N = c.pos.size();
+    const std::vector<int32_t> order = morton_order(c.pos);
+    const AtomRows A = atom_rows(T, N);
+    chunk_size = std::max<size_t>(chunk_size, 1);
+    std::vector<CellResult> cells;
+    for(size_t b=0; b<N; b+=chunk_size){
+        const size_t n = std::min(chunk_size, N - b);
+        tessellate_atoms(c, T, A, M, cfg, order.data() + b, n, cells);
+        on_chunk(cells);
+    }
+}
+
+} // namespace v3d
@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "vec.hpp"
+#include "polyhedron.hpp"
+#include "tessellate.hpp"
+
+namespace v3d {
+
+// Columnar (CSR) form of a list of cells. Cell c owns vertices
+// [cell_vertex_offsets[c], cell_vertex_offsets[c+1]) and faces [cell_face_offsets[c],
+// cell_face_offsets[c+1]); face f lists face_vertex_indices[face_offsets[f] .. face_offsets[f+1])
+// as indices into the concatenated `vertices`, CCW around the outward normal.
+// Real is the storage type of the coordinate, area and volume columns (cells are always built
+// in double; float rounds on flatten).
+template<class Real>
+struct BasicTessellationResult {
+    using real_type = Real;
+    using vec_type = typename StoredVec3<Real>::type;
+    std::vector<vec_type> vertices;
+    std::vector<int64_t> cell_vertex_offsets{0};
+    std::vector<int64_t> face_vertex_indices;
+    std::vector<int64_t> face_offsets{0};
+    std::vector<int64_t> cell_face_offsets{0};
+    std::vector<int32_t> face_tag;     // neighbor row, or negative wall/image/cap tag
+    std::vector<Real> face_area;
+    std::vector<vec_type> face_normal;
+    std::vector<int32_t> atom_id;
+    std::vector<Real> volume;
+    std::vector<vec_type> centroid;
+    std::vector<int32_t> rows_used, rows_skipped;
+
+    size_t num_cells() const { return atom_id.size(); }
+    size_t num_faces() const { return face_tag.size(); }
+};
+
+using TessellationResult = BasicTessellationResult<double>;
+using TessellationResultF32 = BasicTessellationResult<float>;
+
+// Append one cell; face attributes are computed if the polyhedron does not carry them
+template<class Real>
+inline void append_cell(BasicTessellationResult<Real>& R, const CellResult& c){
+    const Polyhedron& P = c.poly;
+    Polyhedron tmp;
+    const Polyhedron* Q = &P;
+    if(P.face_area.size() != P.num_faces() || P.face_normal.size() != P.num_faces()){ tmp = P; compute_face_attributes(tmp); Q = &tmp; }
+    const int64_t v0 = (int64_t)R.vertices.size();
+    R.vertices.insert(R.vertices.end(), Q->V.begin(), Q->V.end());
+    for(size_t f=0; f<Q->num_faces(); ++f){
+        for(int v : Q->face(f)) R.face_vertex_indices.push_back(v0 + v);
+        R.face_offsets.push_back((int64_t)R.face_vertex_indices.size());
+        R.face_tag.push_back(f < Q->face_tag.size() ? Q->face_tag[f] : -1);
+        R.face_area.push_back((Real)Q->face_area[f]);
+        R.face_normal.push_back(Q->face_normal[f]);
+    }
+    R.cell_vertex_offsets.push_back((int64_t)R.vertices.size());
+    R.cell_face_offsets.push_back((int64_t)R.face_tag.size());
+    R.atom_id.push_back(c.atom_id);
+    R.volume.push_back((Real)c.volume);
+    R.centroid.push_back(c.centroid);
+    R.rows_used.push_back(c.rows_used);
+    R.rows_skipped.push_back(c.rows_skipped);
+}
+
+// Flatten cells in order, sizing every column up front (flatten_cells<float> for float32 columns)
+template<class Real = double>
+inline BasicTessellationResult<Real> flatten_cells(const std::vector<CellResult>& cells){
+    BasicTessellationResult<Real> R;
+    size_t nv = 0, nf = 0, ni = 0;
+    for(const auto& c : cells){
+        nv += c.poly.V.size(); nf += c.poly.num_faces(); ni += c.poly.face_index.size();
+    }
+    R.vertices.reserve(nv); R.face_vertex_indices.reserve(ni);
+    R.face_offsets.reserve(nf+1); R.face_tag.reserve(nf); R.face_area.reserve(nf); R.face_normal.reserve(nf);
+    R.cell_vertex_offsets.reserve(cells.size()+1); R.cell_face_offsets.reserve(cells.size()+1);
+    R.atom_id.reserve(cells.size()); R.volume.reserve(cells.size()); R.centroid.reserve(cells.size());
+    R.rows_used.reserve(cells.size()); R.rows_skipped.reserve(cells.size());
+    for(const auto& c : cells) append_cell(R, c);
+    return R;
+}
+
+} // namespace v3d
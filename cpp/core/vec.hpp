@@ -26,6 +26,19 @@ struct Vec3 {
 };
 inline std::ostream& operator<<(std::ostream& os, const Vec3& v){ return os<<v.x<<","<<v.y<<","<<v.z; }
 
+// Single-precision storage of a Vec3 (tables and results in float32 mode); arithmetic goes
+// through the implicit conversion back to double
+struct Vec3f {
+    float x{}, y{}, z{};
+    Vec3f() = default;
+    Vec3f(const Vec3& v): x((float)v.x), y((float)v.y), z((float)v.z) {}
+    operator Vec3() const { return {x, y, z}; }
+};
+
+// Storage type of a 3-vector for the scalar type Real (double or float)
+template<class Real> struct StoredVec3 { using type = Vec3; };
+template<> struct StoredVec3<float> { using type = Vec3f; };
+
 struct Mat3 {
     // columns are lattice vectors by convention
     Vec3 c0, c1, c2;
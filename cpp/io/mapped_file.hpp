@@ -0,0 +1,84 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace v3d {
+
+// Read-only memory map of a whole file; move-only, unmapped on destruction
+struct MappedFile {
+    explicit MappedFile(const std::string& path): path_(path) {
+#if defined(_WIN32)
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("cannot open " + path);
+        LARGE_INTEGER sz;
+        if(!GetFileSizeEx(file_, &sz)){ close(); throw std::runtime_error("cannot stat " + path); }
+        size_ = (size_t)sz.QuadPart;
+        if(size_ == 0) return;
+        map_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!map_){ close(); throw std::runtime_error("cannot map " + path); }
+        data_ = (const char*)MapViewOfFile(map_, FILE_MAP_READ, 0, 0, 0);
+        if(!data_){ close(); throw std::runtime_error("cannot map " + path); }
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) throw std::runtime_error("cannot open " + path);
+        struct stat st;
+        if(::fstat(fd, &st) != 0){ ::close(fd); throw std::runtime_error("cannot stat " + path); }
+        size_ = (size_t)st.st_size;
+        if(size_ > 0){
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p == MAP_FAILED){ ::close(fd); throw std::runtime_error("cannot map " + path); }
+            // no madvise: indexing scans front to back, but frames are then read in any order
+            data_ = (const char*)p;
+        }
+        ::close(fd);
+#endif
+    }
+    ~MappedFile(){ close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& o) noexcept { swap(o); }
+    MappedFile& operator=(MappedFile&& o) noexcept { if(this != &o){ close(); swap(o); } return *this; }
+
+    const char* data() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    HANDLE file_ = INVALID_HANDLE_VALUE, map_ = nullptr;
+#endif
+
+    void swap(MappedFile& o){
+        std::swap(path_, o.path_); std::swap(data_, o.data_); std::swap(size_, o.size_);
+#if defined(_WIN32)
+        std::swap(file_, o.file_); std::swap(map_, o.map_);
+#endif
+    }
+    void close(){
+#if defined(_WIN32)
+        if(data_) UnmapViewOfFile(data_);
+        if(map_) CloseHandle(map_);
+        if(file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE; map_ = nullptr;
+#else
+        if(data_) ::munmap((void*)data_, size_);
+#endif
+        data_ = nullptr; size_ = 0;
+    }
+};
+
+} // namespace v3d
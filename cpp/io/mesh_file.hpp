@@ -0,0 +1,365 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <bit>
+#include <type_traits>
+#include <algorithm>
+#include <stdexcept>
+#include "mapped_file.hpp"
+#include "../core/vec.hpp"
+#include "../core/mesh_builder.hpp"
+#include "../core/tessellation_result.hpp"
+#ifdef V3D_ZLIB
+#include <zlib.h>
+#endif
+
+namespace v3d {
+
+// Column container file (little-endian, version 1):
+//   header     64 bytes: "V3DMESH\0", u32 version, u32 kind, u32 num_blocks, u32 0, u64 directory offset
+//   directory  64 bytes per block: char name[32] (NUL-padded), char dtype ('f' float, 'i' int),
+//              u8 itemsize, u8 codec (0 raw, 1 zlib), u8 0, u32 cols, u64 rows, u64 offset, u64 stored bytes
+//   blocks     each at a 64-byte aligned offset; a raw block is a C-contiguous rows x cols array
+// python/voronoi3d/mesh_file.py maps raw blocks as zero-copy NumPy views.
+enum class MeshFileKind : uint32_t { GlobalMesh = 1, TessellationResult = 2 };
+enum class BlockCodec : uint8_t { Raw = 0, Zlib = 1 };
+
+struct MeshFileBlock {
+    std::string name;
+    char dtype = 'f';
+    uint8_t itemsize = 8;
+    BlockCodec codec = BlockCodec::Raw;
+    uint32_t cols = 1;
+    uint64_t rows = 0, offset = 0, stored_bytes = 0;
+    uint64_t raw_bytes() const { return rows * cols * itemsize; }
+};
+
+namespace mesh_file_detail {
+
+constexpr char kMagic[8] = {'V','3','D','M','E','S','H','\0'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kAlign = 64;
+
+template<class T> inline void put(char* p, T v){ std::memcpy(p, &v, sizeof(T)); }
+template<class T> inline T get(const char* p){ T v; std::memcpy(&v, p, sizeof(T)); return v; }
+
+inline void require_little_endian(){
+    if constexpr (std::endian::native != std::endian::little) throw std::runtime_error("mesh files require a little-endian host");
+}
+
+template<class T> constexpr char dtype_of(){ return std::is_floating_point_v<T> ? 'f' : 'i'; }
+
+#ifdef V3D_ZLIB
+// zlib counts bytes in uInt (32-bit, also where uLong is), so blocks of any size are streamed
+// through deflate/inflate in chunks of at most kZlibChunk bytes; the result is one zlib stream
+constexpr uint64_t kZlibChunk = uint64_t(1) << 30;
+
+inline void zlib_deflate(const char* src, uint64_t n, std::vector<unsigned char>& out){
+    z_stream z{};
+    if(deflateInit(&z, Z_DEFAULT_COMPRESSION) != Z_OK) throw std::runtime_error("zlib compression failed");
+    out.resize(std::min<uint64_t>(n / 2 + 64, kZlibChunk));
+    uint64_t in = 0, done = 0;
+    int rc = Z_OK;
+    while(rc != Z_STREAM_END){
+        if(z.avail_in == 0 && in < n){
+            z.next_in = (Bytef*)(src + in);
+            z.avail_in = (uInt)std::min(n - in, kZlibChunk);
+            in += z.avail_in;
+        }
+        if(done == out.size()) out.resize(out.size() + std::min<uint64_t>(out.size(), kZlibChunk));
+        z.next_out = out.data() + done;
+        z.avail_out = (uInt)std::min<uint64_t>(out.size() - done, kZlibChunk);
+        const uInt room = z.avail_out;
+        rc = deflate(&z, in == n ? Z_FINISH : Z_NO_FLUSH);
+        if(rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR){ deflateEnd(&z); throw std::runtime_error("zlib compression failed"); }
+        done += room - z.avail_out;
+    }
+    deflateEnd(&z);
+    out.resize(done);
+}
+
+// Inflate exactly n bytes into dst; false if the stream is corrupt or of another size
+inline bool zlib_inflate(const char* src, uint64_t stored, char* dst, uint64_t n){
+    z_stream z{};
+    if(inflateInit(&z) != Z_OK) return false;
+    uint64_t in = 0, done = 0;
+    int rc = Z_OK;
+    while(rc != Z_STREAM_END){
+        if(z.avail_in == 0 && in < stored){
+            z.next_in = (Bytef*)(src + in);
+            z.avail_in = (uInt)std::min(stored - in, kZlibChunk);
+            in += z.avail_in;
+        }
+        z.next_out = (Bytef*)(dst + done);
+        z.avail_out = (uInt)std::min(n - done, kZlibChunk);
+        const uInt room = z.avail_out, avail = z.avail_in;
+        rc = inflate(&z, Z_NO_FLUSH);
+        if(rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) break;
+        done += room - z.avail_out;
+        // no progress: input used up, or output full before the end of the stream
+        if(rc == Z_BUF_ERROR || (rc == Z_OK && room == z.avail_out && avail == z.avail_in)) break;
+    }
+    inflateEnd(&z);
+    return rc == Z_STREAM_END && done == n;
+}
+#endif
+
+} // namespace mesh_file_detail
+
+// Writes blocks in order, then the header and directory; blocks are gathered one at a time
+struct MeshFileWriter {
+    MeshFileWriter(const std::string& path, MeshFileKind kind, bool compress)
+        : out_(path, std::ios::binary | std::ios::trunc), path_(path), kind_(kind), compress_(compress) {
+        mesh_file_detail::require_little_endian();
+#ifndef V3D_ZLIB
+        if(compress) throw std::runtime_error("compression needs a build with zlib");
+#endif
+        if(!out_) throw std::runtime_error("cannot write " + path);
+        pos_ = 4096;   // room for the header and up to 63 directory entries
+    }
+
+    template<class T>
+    void block(const char* name, const T* data, uint64_t rows, uint32_t cols = 1){
+        MeshFileBlock B;
+        B.name = name; B.dtype = mesh_file_detail::dtype_of<T>(); B.itemsize = (uint8_t)sizeof(T);
+        B.cols = cols; B.rows = rows; B.offset = pos_;
+        const char* bytes = (const char*)data;
+        uint64_t n = B.raw_bytes();
+#ifdef V3D_ZLIB
+        std::vector<unsigned char> z;
+        if(compress_ && n > 0){
+            mesh_file_detail::zlib_deflate(bytes, n, z);
+            B.codec = BlockCodec::Zlib; bytes = (const char*)z.data(); n = z.size();
+        }
+#endif
+        B.stored_bytes = n;
+        out_.seekp((std::streamoff)B.offset);
+        if(n){ out_.write(bytes, (std::streamsize)n); end_ = B.offset + n; }
+        pos_ = (B.offset + n + mesh_file_detail::kAlign - 1) / mesh_file_detail::kAlign * mesh_file_detail::kAlign;
+        blocks_.push_back(std::move(B));
+    }
+
+    // Gather column k (cols values each) of n records with fn(k, T* out) and write it as a block
+    template<class T, class F>
+    void gathered(const char* name, uint64_t rows, uint32_t cols, F&& fn){
+        std::vector<T> buf(rows * cols);
+        for(uint64_t k=0; k<rows; ++k) fn(k, buf.data() + k*cols);
+        block(name, buf.data(), rows, cols);
+    }
+
+    void close(){
+        using namespace mesh_file_detail;
+        if(blocks_.size() > 63) throw std::runtime_error("too many blocks");
+        std::vector<char> head(kAlign * (1 + blocks_.size()), 0);
+        std::memcpy(head.data(), kMagic, 8);
+        put<uint32_t>(&head[8], kVersion);
+        put<uint32_t>(&head[12], (uint32_t)kind_);
+        put<uint32_t>(&head[16], (uint32_t)blocks_.size());
+        put<uint64_t>(&head[24], kAlign);
+        for(size_t b=0; b<blocks_.size(); ++b){
+            const MeshFileBlock& B = blocks_[b];
+            char* d = &head[kAlign * (b+1)];
+            if(B.name.size() >= 32) throw std::runtime_error("block name too long: " + B.name);
+            std::memcpy(d, B.name.data(), B.name.size());
+            d[32] = B.dtype; d[33] = (char)B.itemsize; d[34] = (char)B.codec;
+            put<uint32_t>(d+36, B.cols); put<uint64_t>(d+40, B.rows);
+            put<uint64_t>(d+48, B.offset); put<uint64_t>(d+56, B.stored_bytes);
+        }
+        // pad to the aligned end, so that empty trailing blocks also lie within the file
+        if(pos_ > end_){ out_.seekp((std::streamoff)pos_ - 1); out_.put('\0'); }
+        out_.seekp(0);
+        out_.write(head.data(), (std::streamsize)head.size());
+        out_.close();
+        if(!out_) throw std::runtime_error("error writing " + path_);
+    }
+
+private:
+    std::ofstream out_;
+    std::string path_;
+    MeshFileKind kind_;
+    bool compress_;
+    uint64_t pos_, end_ = 0;
+    std::vector<MeshFileBlock> blocks_;
+};
+
+// Memory-mapped mesh file; raw blocks are read in place, zlib blocks are inflated on access
+struct MeshFile {
+    explicit MeshFile(const std::string& path): file_(path) {
+        using namespace mesh_file_detail;
+        require_little_endian();
+        const char* p = file_.data();
+        if(file_.size() < kAlign || std::memcmp(p, kMagic, 8) != 0) throw std::runtime_error(path + " is not a mesh file");
+        if(get<uint32_t>(p+8) != kVersion) throw std::runtime_error(path + ": unsupported mesh file version");
+        kind_ = (MeshFileKind)get<uint32_t>(p+12);
+        const uint32_t nb = get<uint32_t>(p+16);
+        const uint64_t dir = get<uint64_t>(p+24);
+        if(dir + (uint64_t)nb * kAlign > file_.size()) throw std::runtime_error(path + ": truncated directory");
+        for(uint32_t b=0; b<nb; ++b){
+            const char* d = p + dir + (uint64_t)b * kAlign;
+            MeshFileBlock B;
+            B.name.assign(d, strnlen(d, 32));
+            B.dtype = d[32]; B.itemsize = (uint8_t)d[33]; B.codec = (BlockCodec)d[34];
+            B.cols = get<uint32_t>(d+36); B.rows = get<uint64_t>(d+40);
+            B.offset = get<uint64_t>(d+48); B.stored_bytes = get<uint64_t>(d+56);
+            if(B.offset + B.stored_bytes > file_.size()) throw std::runtime_error(path + ": block " + B.name + " is truncated");
+            blocks_.push_back(std::move(B));
+        }
+    }
+
+    MeshFileKind kind() const { return kind_; }
+    const std::vector<MeshFileBlock>& blocks() const { return blocks_; }
+
+    const MeshFileBlock& block(const std::string& name) const {
+        for(const auto& B : blocks_) if(B.name == name) return B;
+        throw std::runtime_error(file_.path() + " has no block " + name);
+    }
+
+    // Block contents as a vector of T (which must match the stored dtype and itemsize)
+    template<class T>
+    std::vector<T> column(const std::string& name) const {
+        const MeshFileBlock& B = block(name);
+        if(B.itemsize != sizeof(T) || B.dtype != mesh_file_detail::dtype_of<T>()) throw std::runtime_error("block " + name + " has another type");
+        std::vector<T> v(B.rows * B.cols);
+        const char* src = file_.data() + B.offset;
+        if(B.codec == BlockCodec::Raw){
+            if(B.stored_bytes != B.raw_bytes()) throw std::runtime_error("block " + name + " has a bad size");
+            if(!v.empty()) std::memcpy(v.data(), src, B.raw_bytes());
+        } else {
+#ifdef V3D_ZLIB
+            if(!v.empty() && !mesh_file_detail::zlib_inflate(src, B.stored_bytes, (char*)v.data(), B.raw_bytes()))
+                throw std::runtime_error("block " + name + " does not inflate");
+#else
+            throw std::runtime_error("block " + name + " is compressed; rebuild with zlib");
+#endif
+        }
+        return v;
+    }
+
+private:
+    MappedFile file_;
+    MeshFileKind kind_;
+    std::vector<MeshFileBlock> blocks_;
+};
+
+inline void write_global_mesh(const std::string& path, const GlobalMesh& GM, bool compress = false){
+    MeshFileWriter W(path, MeshFileKind::GlobalMesh, compress);
+    const uint64_t F = GM.faces.size(), C = GM.cells.size();
+    W.block("vertices", GM.vertices.empty() ? nullptr : &GM.vertices[0].x, GM.vertices.size(), 3);
+    W.block("edges", GM.edges.empty() ? nullptr : GM.edges[0].data(), GM.edges.size(), 2);
+    uint64_t nloop = 0, nids = 0;
+    W.gathered<int64_t>("face_offsets", F+1, 1, [&](uint64_t k, int64_t* o){ *o = (int64_t)nloop; if(k < F) nloop += GM.faces[k].loop.size(); });
+    {
+        std::vector<int32_t> L; L.reserve(nloop);
+        for(const auto& f : GM.faces) L.insert(L.end(), f.loop.begin(), f.loop.end());
+        W.block("face_vertex_indices", L.data(), L.size());
+    }
+    W.gathered<int32_t>("face_i", F, 1, [&](uint64_t k, int32_t* o){ *o = GM.faces[k].i; });
+    W.gathered<int32_t>("face_j", F, 1, [&](uint64_t k, int32_t* o){ *o = GM.faces[k].j; });
+    W.gathered<int32_t>("face_img", F, 3, [&](uint64_t k, int32_t* o){ for(int q=0;q<3;++q) o[q] = GM.faces[k].img[(size_t)q]; });
+    W.gathered<double>("face_area", F, 1, [&](uint64_t k, double* o){ *o = GM.faces[k].area; });
+    W.gathered<double>("face_centroid", F, 3, [&](uint64_t k, double* o){ const Vec3& c = GM.faces[k].centroid; o[0]=c.x; o[1]=c.y; o[2]=c.z; });
+    W.gathered<double>("face_normal", F, 3, [&](uint64_t k, double* o){ const Vec3& n = GM.faces[k].normal_ij; o[0]=n.x; o[1]=n.y; o[2]=n.z; });
+    W.gathered<int32_t>("cell_atom_id", C, 1, [&](uint64_t k, int32_t* o){ *o = GM.cells[k].atom_id; });
+    W.gathered<double>("cell_volume", C, 1, [&](uint64_t k, double* o){ *o = GM.cells[k].volume; });
+    W.gathered<double>("cell_centroid", C, 3, [&](uint64_t k, double* o){ const Vec3& c = GM.cells[k].centroid; o[0]=c.x; o[1]=c.y; o[2]=c.z; });
+    W.gathered<int64_t>("cell_face_offsets", C+1, 1, [&](uint64_t k, int64_t* o){ *o = (int64_t)nids; if(k < C) nids += GM.cells[k].face_ids.size(); });
+    {
+        std::vector<int32_t> L; L.reserve(nids);
+        for(const auto& c : GM.cells) L.insert(L.end(), c.face_ids.begin(), c.face_ids.end());
+        W.block("cell_face_ids", L.data(), L.size());
+    }
+    W.close();
+}
+
+namespace mesh_file_detail {
+
+// Throws unless `offsets` has count+1 entries running from 0 up to `len` without decreasing
+inline void check_offsets(const std::string& path, const char* name, const std::vector<int64_t>& offsets, size_t count, size_t len){
+    bool ok = offsets.size() == count + 1 && offsets.front() == 0 && (uint64_t)offsets.back() == len;
+    for(size_t k=1; ok && k<offsets.size(); ++k) ok = offsets[k-1] <= offsets[k];
+    if(!ok) throw std::runtime_error(path + ": block " + name + " does not match its index column");
+}
+
+// Every column of a row group must have the same number of rows (cols values per row)
+inline void check_rows(const std::string& path, const char* name, size_t size, size_t rows, size_t cols){
+    if(size != rows * cols) throw std::runtime_error(path + ": block " + name + " has the wrong number of rows");
+}
+
+} // namespace mesh_file_detail
+
+inline GlobalMesh read_global_mesh(const std::string& path){
+    const MeshFile M(path);
+    if(M.kind() != MeshFileKind::GlobalMesh) throw std::runtime_error(path + " does not hold a global mesh");
+    using namespace mesh_file_detail;
+    GlobalMesh GM;
+    const auto V = M.column<double>("vertices");
+    check_rows(path, "vertices", V.size(), V.size()/3, 3);
+    GM.vertices.resize(V.size()/3);
+    std::memcpy((void*)GM.vertices.data(), V.data(), V.size()*sizeof(double));
+    const auto E = M.column<int32_t>("edges");
+    check_rows(path, "edges", E.size(), E.size()/2, 2);
+    GM.edges.resize(E.size()/2);
+    for(size_t e=0; e<GM.edges.size(); ++e) GM.edges[e] = {E[2*e], E[2*e+1]};
+    const auto fo = M.column<int64_t>("face_offsets");
+    const auto fv = M.column<int32_t>("face_vertex_indices");
+    const auto fi = M.column<int32_t>("face_i"), fj = M.column<int32_t>("face_j"), img = M.column<int32_t>("face_img");
+    const auto fa = M.column<double>("face_area"), fc = M.column<double>("face_centroid"), fn = M.column<double>("face_normal");
+    const size_t nf = fi.size();
+    check_offsets(path, "face_offsets", fo, nf, fv.size());
+    check_rows(path, "face_j", fj.size(), nf, 1);
+    check_rows(path, "face_img", img.size(), nf, 3);
+    check_rows(path, "face_area", fa.size(), nf, 1);
+    check_rows(path, "face_centroid", fc.size(), nf, 3);
+    check_rows(path, "face_normal", fn.size(), nf, 3);
+    GM.faces.resize(nf);
+    for(size_t f=0; f<GM.faces.size(); ++f){
+        GlobalMeshFace& F = GM.faces[f];
+        F.loop.assign(fv.begin() + fo[f], fv.begin() + fo[f+1]);
+        F.i = fi[f]; F.j = fj[f]; F.img = {img[3*f], img[3*f+1], img[3*f+2]};
+        F.area = fa[f];
+        F.centroid = Vec3{fc[3*f], fc[3*f+1], fc[3*f+2]};
+        F.normal_ij = Vec3{fn[3*f], fn[3*f+1], fn[3*f+2]};
+    }
+    const auto ca = M.column<int32_t>("cell_atom_id");
+    const auto cv = M.column<double>("cell_volume"), cc = M.column<double>("cell_centroid");
+    const auto co = M.column<int64_t>("cell_face_offsets");
+    const auto cf = M.column<int32_t>("cell_face_ids");
+    const size_t nc = ca.size();
+    check_offsets(path, "cell_face_offsets", co, nc, cf.size());
+    check_rows(path, "cell_volume", cv.size(), nc, 1);
+    check_rows(path, "cell_centroid", cc.size(), nc, 3);
+    GM.cells.resize(nc);
+    for(size_t c=0; c<GM.cells.size(); ++c){
+        GlobalMeshCell& C = GM.cells[c];
+        C.atom_id = ca[c]; C.volume = cv[c];
+        C.centroid = Vec3{cc[3*c], cc[3*c+1], cc[3*c+2]};
+        C.face_ids.assign(cf.begin() + co[c], cf.begin() + co[c+1]);
+    }
+    return GM;
+}
+
+// Float columns keep the result's storage precision (float32 results write '<f4' blocks)
+template<class Real>
+inline void write_tessellation_result(const std::string& path, const BasicTessellationResult<Real>& R, bool compress = false){
+    MeshFileWriter W(path, MeshFileKind::TessellationResult, compress);
+    W.block("vertices", R.vertices.empty() ? nullptr : &R.vertices[0].x, R.vertices.size(), 3);
+    W.block("cell_vertex_offsets", R.cell_vertex_offsets.data(), R.cell_vertex_offsets.size());
+    W.block("face_vertex_indices", R.face_vertex_indices.data(), R.face_vertex_indices.size());
+    W.block("face_offsets", R.face_offsets.data(), R.face_offsets.size());
+    W.block("cell_face_offsets", R.cell_face_offsets.data(), R.cell_face_offsets.size());
+    W.block("face_tag", R.face_tag.data(), R.face_tag.size());
+    W.block("face_area", R.face_area.data(), R.face_area.size());
+    W.block("face_normal", R.face_normal.empty() ? nullptr : &R.face_normal[0].x, R.face_normal.size(), 3);
+    W.block("atom_id", R.atom_id.data(), R.atom_id.size());
+    W.block("volume", R.volume.data(), R.volume.size());
+    W.block("centroid", R.centroid.empty() ? nullptr : &R.centroid[0].x, R.centroid.size(), 3);
+    W.block("rows_used", R.rows_used.data(), R.rows_used.size());
+    W.block("rows_skipped", R.rows_skipped.data(), R.rows_skipped.size());
+    W.close();
+}
+
+} // namespace v3d
@@ -0,0 +1,501 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cctype>
+#include <cstdint>
+#include <charconv>
+#include <algorithm>
+#include <numeric>
+#include <numbers>
+#include <stdexcept>
+#include "mapped_file.hpp"
+#include "../core/vec.hpp"
+#include "../core/lattice.hpp"
+#include "../core/parallel.hpp"
+#include "../containers/box_container.hpp"
+#include "../containers/triclinic_pbc.hpp"
+
+namespace v3d {
+
+enum class TrajectoryFormat { Auto, ExtXYZ, LammpsText, LammpsBinary };
+
+struct TrajectoryFrame {
+    int64_t timestep = -1;                        // LAMMPS dumps only
+    std::vector<Vec3> pos;                        // cartesian, in file order (LAMMPS: sorted by id)
+    bool has_cell = false;
+    Vec3 origin{0,0,0};
+    Mat3 cell{};                                  // columns are the cell vectors a, b, c
+    std::array<bool,3> periodic{false,false,false};
+};
+
+// Lattice with the lengths and angles of the cell H (columns a, b, c)
+inline Lattice lattice_of_cell(const Mat3& H){
+    const double a = H.c0.norm(), b = H.c1.norm(), c = H.c2.norm(), deg = 180.0/std::numbers::pi;
+    return Lattice(a, b, c, std::acos(H.c1.dot(H.c2)/(b*c))*deg, std::acos(H.c0.dot(H.c2)/(a*c))*deg,
+                   std::acos(H.c0.dot(H.c1)/(a*b))*deg);
+}
+
+namespace traj_detail {
+
+inline const char* line_end(const char* p, const char* e){
+    const void* q = std::memchr(p, '\n', (size_t)(e - p));
+    return q ? (const char*)q : e;
+}
+inline const char* next_line(const char* p, const char* e){ p = line_end(p, e); return p < e ? p+1 : e; }
+inline bool is_ws(char c){ return c==' ' || c=='\t' || c=='\r'; }
+inline const char* skip_ws(const char* p, const char* e){ while(p < e && is_ws(*p)) ++p; return p; }
+inline const char* skip_token(const char* p, const char* e){ p = skip_ws(p, e); while(p < e && !is_ws(*p) && *p != '\n') ++p; return p; }
+inline bool blank_line(const char* p, const char* e){ p = skip_ws(p, e); return p >= e || *p == '\n'; }
+
+template<class T>
+inline bool parse_num(const char*& p, const char* e, T& v){
+    p = skip_ws(p, e);
+    if(p < e && *p == '+') ++p;
+    const auto r = std::from_chars(p, e, v);
+    if(r.ec != std::errc()) return false;
+    p = r.ptr;
+    return true;
+}
+
+inline std::vector<std::string_view> tokens(const char* p, const char* e){
+    std::vector<std::string_view> out;
+    for(p = skip_ws(p, e); p < e && *p != '\n'; p = skip_ws(p, e)){
+        const char* q = skip_token(p, e);
+        out.emplace_back(p, (size_t)(q - p));
+        p = q;
+    }
+    return out;
+}
+
+inline bool starts_with(const char* p, const char* e, std::string_view s){
+    return (size_t)(e - p) >= s.size() && std::memcmp(p, s.data(), s.size()) == 0;
+}
+
+inline bool iequals(std::string_view a, std::string_view b){
+    if(a.size() != b.size()) return false;
+    for(size_t k=0; k<a.size(); ++k) if(std::tolower((unsigned char)a[k]) != std::tolower((unsigned char)b[k])) return false;
+    return true;
+}
+
+// key=value pairs of an extended XYZ comment line; values may be "quoted"
+inline std::vector<std::pair<std::string_view, std::string_view>> extxyz_info(const char* p, const char* e){
+    std::vector<std::pair<std::string_view, std::string_view>> kv;
+    e = line_end(p, e);
+    while(true){
+        p = skip_ws(p, e);
+        if(p >= e) break;
+        const char* k = p;
+        while(p < e && *p != '=' && !is_ws(*p)) ++p;
+        std::string_view key(k, (size_t)(p - k)), val;
+        if(p < e && *p == '='){
+            ++p;
+            if(p < e && (*p == '"' || *p == '\'')){
+                const char q = *p++; const char* v = p;
+                while(p < e && *p != q) ++p;
+                val = std::string_view(v, (size_t)(p - v));
+                if(p < e) ++p;
+            } else {
+                const char* v = p; p = skip_token(p, e);
+                val = std::string_view(v, (size_t)(p - v));
+            }
+        }
+        kv.emplace_back(key, val);
+    }
+    return kv;
+}
+
+// Bounds-checked reads from a binary buffer
+struct ByteCursor {
+    const char* p; const char* e;
+    template<class T> T get(){
+        if((size_t)(e - p) < sizeof(T)) throw std::runtime_error("truncated LAMMPS binary dump");
+        T v; std::memcpy(&v, p, sizeof(T)); p += sizeof(T);
+        return v;
+    }
+    void skip(size_t n){
+        if((size_t)(e - p) < n) throw std::runtime_error("truncated LAMMPS binary dump");
+        p += n;
+    }
+};
+
+// Origin and cell from LAMMPS box bounds (lo/hi bound per axis, tilts xy xz yz)
+inline void lammps_cell(const double lo[3], const double hi[3], const double tilt[3], TrajectoryFrame& F){
+    const double xy = tilt[0], xz = tilt[1], yz = tilt[2];
+    const double xlo = lo[0] - std::min({0.0, xy, xz, xy+xz}), xhi = hi[0] - std::max({0.0, xy, xz, xy+xz});
+    const double ylo = lo[1] - std::min(0.0, yz), yhi = hi[1] - std::max(0.0, yz);
+    F.has_cell = true;
+    F.origin = Vec3{xlo, ylo, lo[2]};
+    F.cell = Mat3{ Vec3{xhi-xlo, 0, 0}, Vec3{xy, yhi-ylo, 0}, Vec3{xz, yz, hi[2]-lo[2]} };
+}
+
+} // namespace traj_detail
+
+// Random-access reader for extended XYZ and LAMMPS text/binary dumps. The file is memory-mapped
+// and the frame offsets are indexed once on construction; read(k) then parses only frame k,
+// with the atom lines split over num_threads threads.
+struct TrajectoryReader {
+    explicit TrajectoryReader(const std::string& path, TrajectoryFormat fmt = TrajectoryFormat::Auto, int num_threads = 0)
+        : file_(path), fmt_(fmt == TrajectoryFormat::Auto ? detect(file_) : fmt), num_threads_(num_threads) {
+        if(fmt_ == TrajectoryFormat::ExtXYZ) index_xyz();
+        else if(fmt_ == TrajectoryFormat::LammpsText) index_lammps_text();
+        else index_lammps_binary();
+    }
+
+    size_t num_frames() const { return frames_.size(); }
+    size_t num_atoms(size_t k) const { return (size_t)frame_index(k).natoms; }
+    TrajectoryFormat format() const { return fmt_; }
+    const std::string& path() const { return file_.path(); }
+
+    TrajectoryFrame read(size_t k) const {
+        const FrameIndex& I = frame_index(k);
+        TrajectoryFrame F;
+        if(fmt_ == TrajectoryFormat::ExtXYZ) read_xyz(I, F);
+        else if(fmt_ == TrajectoryFormat::LammpsText) read_lammps_text(I, F);
+        else read_lammps_binary(I, F);
+        return F;
+    }
+
+    // Frame k in a box: the cell's bounding box, or the atoms' bounding box without a cell
+    BoxContainer box(size_t k) const {
+        TrajectoryFrame F = read(k);
+        BoxBounds b{};
+        if(F.has_cell){
+            b.lo = b.hi = F.origin;
+            for(int m=1; m<8; ++m){
+                const Vec3 c = F.origin + F.cell * Vec3{(double)(m&1), (double)((m>>1)&1), (double)((m>>2)&1)};
+                for(int q=0;q<3;++q){ b.lo[q] = std::min(b.lo[q], c[q]); b.hi[q] = std::max(b.hi[q], c[q]); }
+            }
+        } else if(!F.pos.empty()){
+            b.lo = b.hi = F.pos[0];
+            for(const Vec3& p : F.pos) for(int q=0;q<3;++q){ b.lo[q] = std::min(b.lo[q], p[q]); b.hi[q] = std::max(b.hi[q], p[q]); }
+        }
+        BoxContainer box(b);
+        box.pos = std::move(F.pos);
+        return box;
+    }
+
+    // Frame k with its cell as a TriclinicPBC; positions are re-expressed in the Lattice's
+    // conventional orientation (a along x, b in the xy plane) relative to the cell origin
+    TriclinicPBC pbc(size_t k) const {
+        TrajectoryFrame F = read(k);
+        if(!F.has_cell) throw std::runtime_error("frame " + std::to_string(k) + " of " + path() + " has no cell");
+        TriclinicPBC pbc(lattice_of_cell(F.cell), F.periodic);
+        const Mat3& H = F.cell;
+        const Vec3 r0 = H.c1.cross(H.c2), r1 = H.c2.cross(H.c0), r2 = H.c0.cross(H.c1);
+        const double det = H.c0.dot(r0);
+        const Mat3& A = pbc.lat.A;
+        parallel_for(F.pos.size(), num_threads_, [&](size_t i){
+            const Vec3 d = F.pos[i] - F.origin;
+            F.pos[i] = A * Vec3{r0.dot(d)/det, r1.dot(d)/det, r2.dot(d)/det};
+        });
+        pbc.pos = std::move(F.pos);
+        return pbc;
+    }
+
+private:
+    struct FrameIndex { size_t header = 0, atoms = 0; int64_t natoms = 0; };
+
+    MappedFile file_;
+    TrajectoryFormat fmt_;
+    int num_threads_;
+    std::vector<FrameIndex> frames_;
+
+    const FrameIndex& frame_index(size_t k) const {
+        if(k >= frames_.size()) throw std::out_of_range("frame index out of range");
+        return frames_[k];
+    }
+    std::runtime_error error(const std::string& what) const { return std::runtime_error(path() + ": " + what); }
+
+    static TrajectoryFormat detect(const MappedFile& f){
+        const char *p = f.data(), *e = f.end();
+        if(!p) return TrajectoryFormat::ExtXYZ;
+        if(traj_detail::starts_with(traj_detail::skip_ws(p, e), e, "ITEM:")) return TrajectoryFormat::LammpsText;
+        // binary dumps start with an int64 timestep (negative in revised dumps): NUL bytes
+        if(std::memchr(p, '\0', std::min<size_t>(f.size(), 64))) return TrajectoryFormat::LammpsBinary;
+        return TrajectoryFormat::ExtXYZ;
+    }
+
+    // Start of each of the n lines from p; throws if the file ends first
+    std::vector<const char*> line_starts(const char* p, int64_t n) const {
+        const char* e = file_.end();
+        std::vector<const char*> L((size_t)n);
+        for(int64_t i=0; i<n; ++i){
+            if(p >= e) throw error("truncated frame");
+            L[(size_t)i] = p;
+            p = traj_detail::next_line(p, e);
+        }
+        return L;
+    }
+
+    // Parse three doubles at token columns c[0..2] of every line (and an id at idc >= 0)
+    void parse_lines(const std::vector<const char*>& L, const int c[3], int idc,
+                     std::vector<Vec3>& pos, std::vector<int64_t>* ids) const {
+        using namespace traj_detail;
+        const char* e = file_.end();
+        const int last = std::max({c[0], c[1], c[2], idc});
+        pos.resize(L.size());
+        if(ids) ids->resize(L.size());
+        std::vector<uint8_t> bad(L.size(), 0);
+        parallel_for(L.size(), num_threads_, [&](size_t i){
+            const char* p = L[i];
+            const char* le = line_end(p, e);
+            for(int col=0; col<=last; ++col){
+                int q = -1;
+                for(int a=0;a<3;++a) if(c[a] == col) q = a;
+                if(q >= 0){ if(!parse_num(p, le, pos[i][q])){ bad[i] = 1; return; } }
+                else if(col == idc){
+                    double v;
+                    if(!parse_num(p, le, v)){ bad[i] = 1; return; }
+                    (*ids)[i] = (int64_t)v;
+                }
+                else p = skip_token(p, le);
+            }
+        });
+        const auto it = std::find(bad.begin(), bad.end(), 1);
+        if(it != bad.end()) throw error("cannot parse atom line " + std::to_string(it - bad.begin()));
+    }
+
+    // ---- extended XYZ ----
+    void index_xyz(){
+        using namespace traj_detail;
+        const char *p = file_.data(), *e = file_.end();
+        while(p && p < e){
+            if(blank_line(p, e)){ p = next_line(p, e); continue; }
+            FrameIndex I;
+            const char* q = p;
+            if(!parse_num(q, e, I.natoms) || I.natoms < 0) throw error("frame " + std::to_string(frames_.size()) + ": expected an atom count");
+            I.header = (size_t)(next_line(p, e) - file_.data());
+            p = next_line(file_.data() + I.header, e);
+            I.atoms = (size_t)(p - file_.data());
+            for(int64_t i=0; i<I.natoms; ++i){
+                if(p >= e) throw error("frame " + std::to_string(frames_.size()) + " is truncated");
+                p = next_line(p, e);
+            }
+            frames_.push_back(I);
+        }
+    }
+
+    void read_xyz(const FrameIndex& I, TrajectoryFrame& F) const {
+        using namespace traj_detail;
+        const char* e = file_.end();
+        int c[3] = {1, 2, 3};
+        bool pbc_given = false;
+        for(const auto& [key, val] : extxyz_info(file_.data() + I.header, e)){
+            if(iequals(key, "Lattice")){
+                double h[9]; const char* p = val.data(); const char* ve = p + val.size();
+                for(double& x : h) if(!parse_num(p, ve, x)) throw error("bad Lattice value");
+                F.cell = Mat3{ Vec3{h[0],h[1],h[2]}, Vec3{h[3],h[4],h[5]}, Vec3{h[6],h[7],h[8]} };
+                F.has_cell = true;
+                if(!pbc_given) F.periodic = {true, true, true};
+            } else if(iequals(key, "pbc")){
+                const auto t = tokens(val.data(), val.data() + val.size());
+                if(t.size() != 3) throw error("bad pbc value");
+                for(int k=0;k<3;++k) F.periodic[(size_t)k] = iequals(t[(size_t)k], "T") || iequals(t[(size_t)k], "True") || t[(size_t)k] == "1";
+                pbc_given = true;
+            } else if(iequals(key, "Properties")){
+                // name:type:count triples; the position is the first R:3 property named pos
+                int col = 0, found = -1;
+                size_t b = 0;
+                std::vector<std::string_view> f;
+                while(b <= val.size()){
+                    size_t s = val.find(':', b); if(s == std::string_view::npos) s = val.size();
+                    f.push_back(val.substr(b, s - b)); b = s + 1;
+                }
+                for(size_t k=0; k+2<f.size(); k+=3){
+                    int n = 0; std::from_chars(f[k+2].data(), f[k+2].data() + f[k+2].size(), n);
+                    if(iequals(f[k], "pos")){ found = col; break; }
+                    col += n;
+                }
+                if(found < 0) throw error("Properties has no pos column");
+                c[0] = found; c[1] = found+1; c[2] = found+2;
+            }
+        }
+        parse_lines(line_starts(file_.data() + I.atoms, I.natoms), c, -1, F.pos, nullptr);
+    }
+
+    // ---- LAMMPS text dump ----
+    void index_lammps_text(){
+        using namespace traj_detail;
+        const char *p = file_.data(), *e = file_.end();
+        while(p && p < e){
+            if(blank_line(p, e)){ p = next_line(p, e); continue; }
+            if(!starts_with(p, e, "ITEM: TIMESTEP")) throw error("frame " + std::to_string(frames_.size()) + ": expected ITEM: TIMESTEP");
+            FrameIndex I;
+            I.header = (size_t)(p - file_.data());
+            I.natoms = -1;
+            for(p = next_line(p, e); p < e && !starts_with(p, e, "ITEM: ATOMS"); p = next_line(p, e)){
+                if(starts_with(p, e, "ITEM: NUMBER OF ATOMS")){
+                    p = next_line(p, e);
+                    const char* q = p;
+                    if(!parse_num(q, e, I.natoms)) throw error("bad NUMBER OF ATOMS");
+                }
+            }
+            if(p >= e || I.natoms < 0) throw error("frame " + std::to_string(frames_.size()) + " has no atoms section");
+            p = next_line(p, e);
+            I.atoms = (size_t)(p - file_.data());
+            for(int64_t i=0; i<I.natoms; ++i){
+                if(p >= e) throw error("frame " + std::to_string(frames_.size()) + " is truncated");
+                p = next_line(p, e);
+            }
+            frames_.push_back(I);
+        }
+    }
+
+    // Position columns of a LAMMPS column list: x y z, xu yu zu, xs ys zs or xsu ysu zsu
+    // (the last two are scaled); returns false if none is present
+    static bool lammps_columns(const std::vector<std::string_view>& names, int c[3], int& idc, bool& scaled){
+        static const char* sets[4][3] = {{"x","y","z"}, {"xu","yu","zu"}, {"xs","ys","zs"}, {"xsu","ysu","zsu"}};
+        idc = -1;
+        for(size_t k=0; k<names.size(); ++k) if(names[k] == "id") idc = (int)k;
+        for(int s=0; s<4; ++s){
+            int found = 0;
+            for(int a=0;a<3;++a) for(size_t k=0; k<names.size(); ++k) if(names[k] == sets[s][a]){ c[a] = (int)k; ++found; break; }
+            if(found == 3){ scaled = s >= 2; return true; }
+        }
+        return false;
+    }
+
+    // Scale (if needed) and order by atom id
+    static void finish_lammps(TrajectoryFrame& F, bool scaled, const std::vector<int64_t>* ids, int num_threads){
+        if(scaled) parallel_for(F.pos.size(), num_threads, [&](size_t i){ F.pos[i] = F.origin + F.cell * F.pos[i]; });
+        if(ids && !std::is_sorted(ids->begin(), ids->end())){
+            std::vector<size_t> perm(F.pos.size());
+            std::iota(perm.begin(), perm.end(), size_t{0});
+            std::stable_sort(perm.begin(), perm.end(), [&](size_t a, size_t b){ return (*ids)[a] < (*ids)[b]; });
+            std::vector<Vec3> sorted(perm.size());
+            for(size_t k=0; k<perm.size(); ++k) sorted[k] = F.pos[perm[k]];
+            F.pos = std::move(sorted);
+        }
+    }
+
+    void read_lammps_text(const FrameIndex& I, TrajectoryFrame& F) const {
+        using namespace traj_detail;
+        const char* e = file_.end();
+        const char* p = file_.data() + I.header;
+        std::vector<std::string_view> names;
+        for(; p < e && !starts_with(p, e, "ITEM: ATOMS"); p = next_line(p, e)){
+            if(starts_with(p, e, "ITEM: TIMESTEP")){
+                const char* q = next_line(p, e);
+                parse_num(q, e, F.timestep);
+            } else if(starts_with(p, e, "ITEM: BOX BOUNDS")){
+                const auto t = tokens(p + 16, e);
+                const bool tri = t.size() >= 3 && t[0] == "xy";
+                for(size_t k=0; k<3; ++k){
+                    const size_t at = (tri ? 3 : 0) + k;
+                    F.periodic[k] = at < t.size() && t[at].size() > 0 && t[at][0] == 'p';
+                }
+                double lo[3], hi[3], tilt[3] = {0,0,0};
+                for(int k=0;k<3;++k){
+                    p = next_line(p, e);
+                    const char* q = p;
+                    if(!parse_num(q, e, lo[k]) || !parse_num(q, e, hi[k]) || (tri && !parse_num(q, e, tilt[k])))
+                        throw error("bad BOX BOUNDS");
+                }
+                lammps_cell(lo, hi, tilt, F);
+            }
+        }
+        names = tokens(p + 11, e);
+        int c[3], idc; bool scaled;
+        if(!lammps_columns(names, c, idc, scaled)) throw error("dump has no x/y/z, xu/yu/zu, xs/ys/zs or xsu/ysu/zsu columns");
+        if(scaled && !F.has_cell) throw error("scaled coordinates without BOX BOUNDS");
+        std::vector<int64_t> ids;
+        parse_lines(line_starts(file_.data() + I.atoms, I.natoms), c, idc, F.pos, idc >= 0 ? &ids : nullptr);
+        finish_lammps(F, scaled, idc >= 0 ? &ids : nullptr, num_threads_);
+    }
+
+    // ---- LAMMPS binary dump ----
+    // Revision-2 dumps start each frame with -len("DUMPATOM"...), the magic string, endianness
+    // and revision, and carry unit style, time and column names; older dumps have none of these
+    // and are read as the dump atom default "id type xs ys zs"
+    struct BinaryHeader {
+        int64_t timestep = 0, natoms = 0;
+        int triclinic = 0, size_one = 0, nchunk = 0;
+        std::array<int,6> boundary{};
+        double lo[3]{}, hi[3]{}, tilt[3]{};
+        std::string columns;
+        const char* chunks = nullptr;
+    };
+
+    BinaryHeader binary_header(const char* p) const {
+        traj_detail::ByteCursor C{p, file_.end()};
+        BinaryHeader H;
+        H.timestep = C.get<int64_t>();
+        bool revised = false;
+        if(H.timestep < 0){
+            C.skip((size_t)(-H.timestep));
+            if(C.get<int>() != 1) throw error("big-endian LAMMPS binary dumps are not supported");
+            C.get<int>();   // format revision
+            revised = true;
+            H.timestep = C.get<int64_t>();
+        }
+        H.natoms = C.get<int64_t>();
+        H.triclinic = C.get<int>();
+        for(int& b : H.boundary) b = C.get<int>();
+        for(int k=0;k<3;++k){ H.lo[k] = C.get<double>(); H.hi[k] = C.get<double>(); }
+        if(H.triclinic) for(double& t : H.tilt) t = C.get<double>();
+        H.size_one = C.get<int>();
+        if(revised){
+            const int ulen = C.get<int>(); C.skip((size_t)ulen);
+            if(C.get<char>()) C.get<double>();
+            const int clen = C.get<int>();
+            const char* cs = C.p; C.skip((size_t)clen);
+            H.columns.assign(cs, (size_t)clen);
+        } else {
+            H.columns = "id type xs ys zs";
+        }
+        H.nchunk = C.get<int>();
+        H.chunks = C.p;
+        if(H.natoms < 0 || H.size_one <= 0 || H.nchunk < 0) throw error("bad LAMMPS binary frame header");
+        return H;
+    }
+
+    void index_lammps_binary(){
+        const char *p = file_.data(), *e = file_.end();
+        while(p && p < e){
+            const BinaryHeader H = binary_header(p);
+            traj_detail::ByteCursor C{H.chunks, e};
+            for(int k=0; k<H.nchunk; ++k){
+                const int n = C.get<int>();
+                C.skip((size_t)n * sizeof(double));
+            }
+            frames_.push_back(FrameIndex{(size_t)(p - file_.data()), (size_t)(H.chunks - file_.data()), H.natoms});
+            p = C.p;
+        }
+    }
+
+    void read_lammps_binary(const FrameIndex& I, TrajectoryFrame& F) const {
+        const BinaryHeader H = binary_header(file_.data() + I.header);
+        F.timestep = H.timestep;
+        for(int k=0;k<3;++k) F.periodic[(size_t)k] = H.boundary[(size_t)(2*k)] == 0;
+        traj_detail::lammps_cell(H.lo, H.hi, H.tilt, F);
+        const auto names = traj_detail::tokens(H.columns.data(), H.columns.data() + H.columns.size());
+        int c[3], idc; bool scaled;
+        if(!lammps_columns(names, c, idc, scaled) || std::max({c[0], c[1], c[2], idc}) >= H.size_one)
+            throw error("binary dump has no usable position columns");
+        F.pos.resize((size_t)H.natoms);
+        std::vector<int64_t> ids(idc >= 0 ? (size_t)H.natoms : 0);
+        traj_detail::ByteCursor C{H.chunks, file_.end()};
+        size_t at = 0;
+        for(int k=0; k<H.nchunk; ++k){
+            const size_t n = (size_t)C.get<int>() / (size_t)H.size_one;
+            const char* rows = C.p;
+            C.skip(n * (size_t)H.size_one * sizeof(double));
+            if(at + n > F.pos.size()) throw error("binary frame holds more atoms than declared");
+            parallel_for(n, num_threads_, [&](size_t i){
+                const char* r = rows + i * (size_t)H.size_one * sizeof(double);
+                double v[3];
+                for(int a=0;a<3;++a) std::memcpy(&v[a], r + (size_t)c[a]*sizeof(double), sizeof(double));
+                F.pos[at+i] = Vec3{v[0], v[1], v[2]};
+                if(idc >= 0){ double id; std::memcpy(&id, r + (size_t)idc*sizeof(double), sizeof(double)); ids[at+i] = (int64_t)id; }
+            });
+            at += n;
+        }
+        if(at != F.pos.size()) throw error("binary frame holds fewer atoms than declared");
+        finish_lammps(F, scaled, idc >= 0 ? &ids : nullptr, num_threads_);
+    }
+};
+
+} // namespace v3d
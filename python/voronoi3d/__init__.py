@@ -1,9 +1,13 @@
 from ._core import (  # type: ignore
-    Config, Vec3, Lattice, BoxBounds, BoxContainer, TriclinicPBC, plan_neighbors, tessellate_pairs, tessellate_pairs_global_mesh, CapOptions, tessellate_pairs_with_caps
+    Config, StitchMode, Vec3, Lattice, BoxBounds, BoxContainer, TriclinicPBC, NeighborTable, NeighborTableF32, HalfNeighborTable, HalfNeighborTableF32, NeighborPlanner, TessellationResult, TessellationResultF32, TessellationStream, IncrementalTessellation, FrameBatchResult, TrajectoryFormat, TrajectoryFrame, TrajectoryReader, plan_neighbors, tessellate_pairs, tessellate_pairs_stream, tessellate_frames, tessellate_pairs_global_mesh, save_global_mesh, read_global_mesh, MeshFile, mesh_compression_enabled, CapOptions, tessellate_pairs_with_caps, ProfileStats, last_profile, profiling_enabled
 )
 from .policy import symmetrize_M
+from .mesh_file import load_mesh_file
+from .futures import tessellate_pairs_async, tessellate_pairs_with_caps_async
 
 __all__ = [
-    "Config", "Vec3", "Lattice", "BoxBounds", "BoxContainer", "TriclinicPBC",
-    "plan_neighbors", "tessellate_pairs, tessellate_pairs_global_mesh, CapOptions, tessellate_pairs_with_caps", "symmetrize_M",
+    "Config", "StitchMode", "Vec3", "Lattice", "BoxBounds", "BoxContainer", "TriclinicPBC", "NeighborTable", "NeighborTableF32", "HalfNeighborTable", "HalfNeighborTableF32", "NeighborPlanner", "TessellationResult", "TessellationResultF32", "TessellationStream", "IncrementalTessellation", "FrameBatchResult", "TrajectoryFormat", "TrajectoryFrame", "TrajectoryReader",
+    "plan_neighbors", "tessellate_pairs", "tessellate_pairs_stream", "tessellate_frames", "tessellate_pairs_global_mesh", "save_global_mesh", "read_global_mesh", "MeshFile", "mesh_compression_enabled", "load_mesh_file", "CapOptions", "tessellate_pairs_with_caps", "symmetrize_M",
+    "tessellate_pairs_async", "tessellate_pairs_with_caps_async",
+    "ProfileStats", "last_profile", "profiling_enabled",
 ]
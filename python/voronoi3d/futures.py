@@ -0,0 +1,36 @@
+from __future__ import annotations
+import threading
+from concurrent.futures import Executor, Future, ThreadPoolExecutor
+from typing import Optional
+
+import numpy as np
+
+from . import _core
+
+_executor: Optional[ThreadPoolExecutor] = None
+_executor_lock = threading.Lock()
+
+
+def _default_executor() -> ThreadPoolExecutor:
+    global _executor
+    with _executor_lock:
+        if _executor is None:
+            _executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix="voronoi3d")
+        return _executor
+
+
+def tessellate_pairs_async(container, table, M, cfg, executor: Optional[Executor] = None) -> Future:
+    """
+    Submit tessellate_pairs to a worker thread and return a Future of its result.
+    The C++ phase releases the GIL, so the caller keeps running Python code meanwhile.
+    M is copied at submission; container, table and cfg must not be modified until the
+    future completes. By default a shared single-worker pool is used (frames run in order).
+    """
+    M = np.array(M, dtype=float, copy=True)
+    return (executor or _default_executor()).submit(_core.tessellate_pairs, container, table, M, cfg)
+
+
+def tessellate_pairs_with_caps_async(box, table, M, opt, cfg, executor: Optional[Executor] = None) -> Future:
+    """Future-returning variant of tessellate_pairs_with_caps (see tessellate_pairs_async)."""
+    M = np.array(M, dtype=float, copy=True)
+    return (executor or _default_executor()).submit(_core.tessellate_pairs_with_caps, box, table, M, opt, cfg)
@@ -0,0 +1,52 @@
+from __future__ import annotations
+import mmap
+import struct
+import zlib
+from typing import Dict
+
+import numpy as np
+
+# Layout: see cpp/io/mesh_file.hpp
+_MAGIC = b"V3DMESH\0"
+_KINDS = {1: "global_mesh", 2: "tessellation_result"}
+
+
+def load_mesh_file(path: str, use_mmap: bool = True) -> Dict[str, object]:
+    """
+    Open a file written by save_global_mesh or TessellationResult.save and return a dict
+    of its blocks (name -> array, e.g. "vertices", "face_offsets", "cell_volume") plus
+    "kind". With use_mmap, uncompressed blocks are read-only zero-copy views of the mapped
+    file, which stays open while any of them is alive; compressed blocks are inflated.
+    """
+    with open(path, "rb") as f:
+        if use_mmap:
+            buf = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        else:
+            buf = f.read()
+    if len(buf) < 64 or buf[:8] != _MAGIC:
+        raise ValueError(f"{path} is not a mesh file")
+    version, kind, nblocks = struct.unpack_from("<III", buf, 8)
+    if version != 1:
+        raise ValueError(f"{path}: unsupported mesh file version {version}")
+    (directory,) = struct.unpack_from("<Q", buf, 24)
+    out: Dict[str, object] = {"kind": _KINDS.get(kind, kind)}
+    for b in range(nblocks):
+        raw_name, dtype, itemsize, codec, cols, rows, offset, stored = struct.unpack_from("<32scBBxIQQQ", buf, directory + 64 * b)
+        name = raw_name.rstrip(b"\0").decode()
+        dt = np.dtype(f"<{dtype.decode()}{itemsize}")
+        shape = (rows, cols) if cols > 1 else (rows,)
+        if rows * cols == 0:
+            arr = np.empty(0, dtype=dt)
+        elif codec == 0:
+            if stored != rows * cols * itemsize or offset + stored > len(buf):
+                raise ValueError(f"{path}: block {name} has a bad size")
+            arr = np.frombuffer(buf, dtype=dt, count=rows * cols, offset=offset)
+        elif codec == 1:
+            raw = zlib.decompress(buf[offset:offset + stored])
+            if len(raw) != rows * cols * itemsize:
+                raise ValueError(f"{path}: block {name} has a bad size")
+            arr = np.frombuffer(raw, dtype=dt)
+        else:
+            raise ValueError(f"{path}: unknown codec {codec}")
+        out[name] = arr.reshape(shape)
+    return out
@@ -1,30 +1,23 @@
 from __future__ import annotations
 import numpy as np
-from typing import Dict, Tuple
 
-def symmetrize_M(table: dict, M: np.ndarray) -> np.ndarray:
+from . import _core  # type: ignore
+
+
+def symmetrize_M(table, M: np.ndarray, num_threads: int = 0) -> np.ndarray:
     """
     Return M' such that for every unordered pair+image, M_ji = 1 - M_ij.
-    Assumes 'table' contains oriented arrays: i, j, img (E×3). If both (i,j,img) and (j,i,-img)
-    rows exist, enforce complementarity by averaging them.
+    `table` is a NeighborTable (its `rev` column pairs the rows) or a dict of oriented arrays
+    i, j, img (E×3). If both (i,j,img) and (j,i,-img) rows exist, enforce complementarity by
+    averaging them: the lower row of the pair gets m = (M_ij + 1 - M_ji) / 2 and the other row
+    exactly 1 - m; rows without a reverse keep their value. Runs natively, in parallel.
+    (Versions before the native path wrote 1 - (1 - m) back to the lower row, which may differ
+    from m in the last bit.)
     """
-    i = np.asarray(table["i"], dtype=np.int64)
-    j = np.asarray(table["j"], dtype=np.int64)
-    img = np.asarray(table["img"], dtype=np.int64)
-    M = np.asarray(M, dtype=float)
-    assert M.shape[0] == i.shape[0]
-
-    # Build mapping from (i,j,na,nb,nc) → row
-    keys: Dict[Tuple[int,int,int,int,int], int] = {}
-    for idx, (ii, jj, (na, nb, nc)) in enumerate(zip(i, j, img)):
-        keys[(int(ii), int(jj), int(na), int(nb), int(nc))] = idx
-
-    out = M.copy()
-    for idx, (ii, jj, (na, nb, nc)) in enumerate(zip(i, j, img)):
-        k_op = (int(jj), int(ii), int(-na), int(-nb), int(-nc))
-        jdx = keys.get(k_op, None)
-        if jdx is not None:
-            m = 0.5*(out[idx] + (1.0 - out[jdx]))
-            out[idx] = m
-            out[jdx] = 1.0 - m
-    return out
+    M = np.ascontiguousarray(M, dtype=np.float64)
+    if isinstance(table, dict):
+        i = np.ascontiguousarray(table["i"], dtype=np.int32)
+        j = np.ascontiguousarray(table["j"], dtype=np.int32)
+        img = np.ascontiguousarray(table["img"], dtype=np.int32).reshape(-1, 3)
+        return _core.symmetrize_M(i, j, img, M, num_threads)
+    return _core.symmetrize_M(table, M, num_threads)
@@ -24,3 +24,22 @@ def test_caps_order_effect_vertices_and_volume():
     Vsphere = 4.0/3.0*math.pi
     assert c60["vertices"].shape[0] >= c6["vertices"].shape[0]
     assert abs(c60["volume"] - Vsphere) <= abs(c6["volume"] - Vsphere)
+
+def test_caps_lebedev_grids_face_counts_and_convergence():
+    sizes = [6, 14, 26, 38, 50, 74, 86, 110, 146, 170, 194]
+    cells = [_make_single_cap_cell(n) for n in sizes]
+    # every direction of a Lebedev grid is a face of the lone atom's cap polytope
+    assert [len(c["faces"]) for c in cells] == sizes
+    # requested counts round up to the next grid
+    assert len(_make_single_cap_cell(60)["faces"]) == 74
+    vols = np.array([c["volume"] for c in cells])
+    # converged reference: a dense Fibonacci cap, within 0.1% of the unit sphere
+    sphere = 4.0/3.0*math.pi
+    ref = _make_single_cap_cell(4000)["volume"]
+    assert sphere < ref < sphere * 1.001
+    # every grid's cap circumscribes the sphere; the excess of a polytope with n well-spread
+    # tangent faces decays like 1/n (measured: 3.1/n .. 5.5/n for these grids)
+    assert (vols > sphere).all()
+    rel = vols / ref - 1.0
+    assert (rel <= 6.0 / np.array(sizes)).all()
+    assert rel[-1] < 0.02
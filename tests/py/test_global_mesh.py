@@ -1,4 +1,7 @@
+import struct
+
 import numpy as np
+import pytest
 import voronoi3d as v3d
 
 def test_global_mesh_two_atoms_box():
@@ -23,3 +26,192 @@ def test_global_mesh_two_atoms_box():
     # internal face area should be approx 1 (unit square)
     area = F["area"][fidx]
     assert np.isclose(area, 1.0, atol=5e-2)
+
+def test_topological_stitch_matches_geometric():
+    rs = np.random.default_rng(4)
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(60, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5, dtype=float)
+    geo = v3d.tessellate_pairs_global_mesh(box, T, M, cfg)
+    cfg.stitch_mode = v3d.StitchMode.Topological
+    topo = v3d.tessellate_pairs_global_mesh(box, T, M, cfg)
+    assert np.array_equal(geo["vertices"], topo["vertices"])
+    assert np.array_equal(geo["edges"], topo["edges"])
+    assert geo["faces"]["loops"] == topo["faces"]["loops"]
+    # Euler characteristic of a box tessellation: V - E + F - C = 1
+    nV, nE, nF = len(topo["vertices"]), len(topo["edges"]), len(topo["faces"]["loops"])
+    assert nV - nE + nF - 60 == 1
+
+def test_topological_stitch_on_a_degenerate_lattice():
+    # simple cubic lattice: eight cells meet at every vertex, so no vertex has a unique
+    # generator triple and the stitch has to go through the paired faces
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(4,4,4)))
+    box.add_atoms([v3d.Vec3(x+0.5, y+0.5, z+0.5) for x in range(4) for y in range(4) for z in range(4)])
+    for half in (False, True):
+        T = v3d.plan_neighbors(box, cfg, half=half)
+        M = np.full(len(T.i), 0.5, dtype=float)
+        cfg.stitch_mode = v3d.StitchMode.Geometric
+        geo = v3d.tessellate_pairs_global_mesh(box, T, M, cfg)
+        cfg.stitch_mode = v3d.StitchMode.Topological
+        topo = v3d.tessellate_pairs_global_mesh(box, T, M, cfg)
+        assert len(topo["vertices"]) == 125
+        assert np.array_equal(geo["vertices"], topo["vertices"])
+        assert geo["faces"]["loops"] == topo["faces"]["loops"]
+
+@pytest.mark.parametrize("jitter", [0.0, 0.03])
+def test_topological_stitch_on_a_slab(jitter):
+    # vacuum along c: every surface cell has its own wall there, so the two copies of a face
+    # between surface cells can differ and must not be joined
+    cfg = v3d.Config()
+    cfg.min_M = 0.25
+    lat = v3d.Lattice(4.0, 4.0, 8.0, 80.0, 95.0, 105.0)
+    pbc = v3d.TriclinicPBC(lat, (True, True, False))
+    g = np.arange(4) + 0.5
+    base = np.array(np.meshgrid(g, g, g, indexing="ij")).reshape(3, -1).T / np.array([4.0, 4.0, 8.0]) + [0, 0, 0.25]
+    rs = np.random.default_rng(8)
+    frac = base + rs.uniform(-jitter, jitter, size=base.shape)
+    pbc.add_atoms([lat.to_cart(v3d.Vec3(*f)) for f in frac])
+    for half in (False, True):
+        T = v3d.plan_neighbors(pbc, cfg, half=half)
+        M = np.full(len(T.i), 0.5, dtype=float)
+        cfg.stitch_mode = v3d.StitchMode.Geometric
+        geo = v3d.tessellate_pairs_global_mesh(pbc, T, M, cfg)
+        cfg.stitch_mode = v3d.StitchMode.Topological
+        topo = v3d.tessellate_pairs_global_mesh(pbc, T, M, cfg)
+        assert np.array_equal(geo["vertices"], topo["vertices"])
+        assert np.array_equal(geo["edges"], topo["edges"])
+        assert geo["faces"]["loops"] == topo["faces"]["loops"]
+
+def test_mesh_file_round_trip(tmp_path):
+    rs = np.random.default_rng(9)
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(40, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5, dtype=float)
+    mesh = v3d.tessellate_pairs_global_mesh(box, T, M, cfg)
+    v3d.save_global_mesh(box, T, M, cfg, str(tmp_path / "mesh.v3dm"))
+    f = v3d.load_mesh_file(str(tmp_path / "mesh.v3dm"))
+    assert f["kind"] == "global_mesh"
+    assert np.array_equal(f["vertices"], mesh["vertices"])
+    assert np.array_equal(f["edges"], mesh["edges"])
+    off, idx = f["face_offsets"], f["face_vertex_indices"]
+    assert [list(idx[off[k]:off[k+1]]) for k in range(len(off) - 1)] == mesh["faces"]["loops"]
+    assert np.array_equal(f["face_img"], mesh["faces"]["img"])
+    assert np.array_equal(f["cell_volume"], mesh["cells"]["volume"])
+    res = v3d.tessellate_pairs(box, T, M, cfg)
+    res.save(str(tmp_path / "cells.v3dm"))
+    g = v3d.load_mesh_file(str(tmp_path / "cells.v3dm"), use_mmap=False)
+    assert g["kind"] == "tessellation_result"
+    assert np.array_equal(g["volume"], res.volume)
+    assert np.array_equal(g["face_vertex_indices"], res.face_vertex_indices)
+
+@pytest.mark.parametrize("compress", [False, True])
+def test_mesh_file_reads_back_raw_and_zlib_blocks(tmp_path, compress):
+    if compress and not v3d.mesh_compression_enabled:
+        pytest.skip("built without zlib")
+    rs = np.random.default_rng(9)
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(40, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5, dtype=float)
+    mesh = v3d.tessellate_pairs_global_mesh(box, T, M, cfg)
+    path = str(tmp_path / "mesh.v3dm")
+    v3d.save_global_mesh(box, T, M, cfg, path, compress=compress)
+    back = v3d.read_global_mesh(path)
+    assert np.array_equal(back["vertices"], mesh["vertices"])
+    assert np.array_equal(back["edges"], mesh["edges"])
+    assert back["faces"]["loops"] == mesh["faces"]["loops"]
+    for key in ("i", "j", "img", "area", "centroid", "normal_ij"):
+        assert np.array_equal(back["faces"][key], mesh["faces"][key])
+    for key in ("atom_id", "volume", "centroid"):
+        assert np.array_equal(back["cells"][key], mesh["cells"][key])
+    assert back["cells"]["face_ids"] == mesh["cells"]["face_ids"]
+    # the C++ reader and load_mesh_file agree block by block
+    F = v3d.MeshFile(path)
+    f = v3d.load_mesh_file(path)
+    assert F.kind == f["kind"] == "global_mesh"
+    assert sorted(F.blocks) == sorted(k for k in f if k != "kind")
+    for name in F.blocks:
+        assert F.compressed(name) == (compress and f[name].size > 0)
+        col = F.column(name)
+        assert col.dtype == f[name].dtype and col.shape == f[name].shape
+        assert np.array_equal(col, f[name])
+    res = v3d.tessellate_pairs(box, T, M, cfg)
+    res.save(str(tmp_path / "cells.v3dm"), compress=compress)
+    G = v3d.MeshFile(str(tmp_path / "cells.v3dm"))
+    assert G.kind == "tessellation_result"
+    assert np.array_equal(G.column("volume"), res.volume)
+    assert np.array_equal(G.column("face_normal"), res.face_normal)
+
+def test_mesh_file_rejects_a_raw_block_of_the_wrong_size(tmp_path):
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(1,1,1)))
+    box.add_atoms([v3d.Vec3(0.25,0.5,0.5), v3d.Vec3(0.75,0.5,0.5)])
+    cfg = v3d.Config()
+    T = v3d.plan_neighbors(box, cfg)
+    path = tmp_path / "mesh.v3dm"
+    v3d.save_global_mesh(box, T, np.full(len(T.i), 0.5), cfg, str(path))
+    data = bytearray(path.read_bytes())
+    (directory,) = struct.unpack_from("<Q", data, 24)
+    assert data[directory:directory + 9] == b"vertices\0"
+    (stored,) = struct.unpack_from("<Q", data, directory + 56)
+    struct.pack_into("<Q", data, directory + 56, stored - 8)
+    path.write_bytes(bytes(data))
+    with pytest.raises(ValueError, match="bad size"):
+        v3d.load_mesh_file(str(path))
+    with pytest.raises(RuntimeError, match="bad size"):
+        v3d.MeshFile(str(path)).column("vertices")
+
+def _block_entry(data, name):
+    (nb,) = struct.unpack_from("<I", data, 16)
+    (directory,) = struct.unpack_from("<Q", data, 24)
+    for b in range(nb):
+        if data[directory + 64 * b:].split(b"\0", 1)[0] == name.encode():
+            return directory + 64 * b
+    raise KeyError(name)
+
+def _end_past_index(data):
+    e = _block_entry(data, "face_offsets")
+    rows, offset = struct.unpack_from("<QQ", data, e + 40)
+    (last,) = struct.unpack_from("<q", data, offset + 8 * (rows - 1))
+    struct.pack_into("<q", data, offset + 8 * (rows - 1), last + 1)
+
+def _decreasing_offsets(data):
+    e = _block_entry(data, "cell_face_offsets")
+    (offset,) = struct.unpack_from("<Q", data, e + 48)
+    (end,) = struct.unpack_from("<q", data, offset + 16)
+    struct.pack_into("<q", data, offset + 8, end + 1)
+
+def _drop_last_row(name, row_bytes):
+    def corrupt(data):
+        e = _block_entry(data, name)
+        rows, offset, stored = struct.unpack_from("<QQQ", data, e + 40)
+        struct.pack_into("<QQQ", data, e + 40, rows - 1, offset, stored - row_bytes)
+    return corrupt
+
+@pytest.mark.parametrize("corrupt, message", [
+    (_end_past_index, "face_offsets does not match"),
+    (_decreasing_offsets, "cell_face_offsets does not match"),
+    (_drop_last_row("face_area", 8), "face_area has the wrong number of rows"),
+    (_drop_last_row("cell_centroid", 24), "cell_centroid has the wrong number of rows"),
+])
+def test_read_global_mesh_rejects_inconsistent_columns(tmp_path, corrupt, message):
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(1,1,1)))
+    box.add_atoms([v3d.Vec3(0.25,0.5,0.5), v3d.Vec3(0.75,0.5,0.5)])
+    cfg = v3d.Config()
+    T = v3d.plan_neighbors(box, cfg)
+    path = tmp_path / "mesh.v3dm"
+    v3d.save_global_mesh(box, T, np.full(len(T.i), 0.5), cfg, str(path))
+    data = bytearray(path.read_bytes())
+    corrupt(data)
+    path.write_bytes(bytes(data))
+    with pytest.raises(RuntimeError, match=message):
+        v3d.read_global_mesh(str(path))
@@ -0,0 +1,52 @@
+import numpy as np
+import voronoi3d as v3d
+
+def _random_box(n=120, seed=5):
+    rs = np.random.default_rng(seed)
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(3,3,3)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 3.0, size=(n, 3))])
+    return box
+
+def test_thread_count_does_not_change_results():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    box = _random_box()
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5)
+    cfg.num_threads = 1
+    serial = v3d.tessellate_pairs(box, T, M, cfg)
+    cfg.num_threads = 4
+    threaded = v3d.tessellate_pairs(box, T, M, cfg)
+    assert [c["atom_id"] for c in threaded] == list(range(len(serial)))
+    for a, b in zip(serial, threaded):
+        assert a["volume"] == b["volume"]
+        assert np.array_equal(a["vertices"], b["vertices"])
+        assert a["faces"] == b["faces"]
+
+def test_async_variant_matches_blocking_call():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    box = _random_box(seed=9)
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5)
+    fut = v3d.tessellate_pairs_async(box, T, M, cfg)
+    M[:] = 0.45  # the future works on its own copy of M
+    cells = fut.result(timeout=60)
+    ref = v3d.tessellate_pairs(box, T, np.full(len(T.i), 0.5), cfg)
+    assert np.allclose([c["volume"] for c in cells], [c["volume"] for c in ref])
+
+def test_global_mesh_is_identical_for_any_thread_count():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    box = _random_box(seed=11)
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5)
+    meshes = []
+    for nt in (1, 4):
+        cfg.num_threads = nt
+        meshes.append(v3d.tessellate_pairs_global_mesh(box, T, M, cfg))
+    a, b = meshes
+    assert np.array_equal(a["vertices"], b["vertices"])
+    assert np.array_equal(a["edges"], b["edges"])
+    assert a["faces"]["loops"] == b["faces"]["loops"]
+    assert len(a["edges"]) == len({tuple(e) for e in a["edges"]})
@@ -14,3 +14,260 @@ def test_plan_neighbors_box_simple():
     jj = np.array(T.j, dtype=int)
     assert ((ii==0) & (jj==1)).any()
     assert ((ii==1) & (jj==0)).any()
+
+def test_plan_neighbors_box_table_stays_local():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    n = 10
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(n,n,n)))
+    box.add_atoms([v3d.Vec3(x+0.5, y+0.5, z+0.5) for x in range(n) for y in range(n) for z in range(n)])
+    T = v3d.plan_neighbors(box, cfg)
+    N = n**3
+    # per-atom reach bounds the rows per atom instead of scaling with N
+    assert 0 < T.size < 250*N
+    r2 = np.array(T.r2)
+    assert r2.max() < 5.0**2
+    # nearest neighbors are always present in both orientations
+    ii = np.array(T.i, dtype=int)
+    jj = np.array(T.j, dtype=int)
+    assert ((ii==0) & (jj==1)).any() and ((ii==1) & (jj==0)).any()
+    # CSR offsets index each atom's contiguous block of rows
+    off = np.array(T.offsets, dtype=np.int64)
+    assert off.shape == (N+1,) and off[0] == 0 and off[-1] == T.size
+    assert np.array_equal(np.repeat(np.arange(N), np.diff(off)), ii)
+
+
+def _brute_force_pbc_rows(lat, periodic, frac, cfg, nimg=8):
+    A = np.array([[c.x, c.y, c.z] for c in (lat.to_cart(v3d.Vec3(1,0,0)),
+                                          lat.to_cart(v3d.Vec3(0,1,0)),
+                                          lat.to_cart(v3d.Vec3(0,0,1)))]).T
+    pos = frac @ A.T
+    rng = [range(-nimg, nimg+1) if p else range(0, 1) for p in periodic]
+    images = np.array([(a, b, c) for a in rng[0] for b in rng[1] for c in rng[2]])
+    shifts = images @ A.T
+    dnn = min(np.linalg.norm(pos[j] + shifts - pos[i], axis=1).min()
+              for i in range(len(pos)) for j in range(len(pos)) if i != j)
+    rsearch = cfg.reach_factor*dnn/cfg.min_M + cfg.neighbor_skin
+    rows = set()
+    for i in range(len(pos)):
+        for j in range(len(pos)):
+            if i == j:
+                continue
+            d2 = ((pos[j] + shifts - pos[i])**2).sum(axis=1)
+            for k in np.nonzero((d2 <= rsearch**2) & (d2 > 0))[0]:
+                rows.add((i, j, *map(int, images[k])))
+    return pos, rows
+
+
+def test_plan_neighbors_pbc_skewed_partial_periodicity():
+    cfg = v3d.Config()
+    cfg.min_M = 0.3
+    lat = v3d.Lattice(3.0, 2.5, 4.0, 70.0, 80.0, 110.0)
+    rs = np.random.default_rng(3)
+    frac = rs.uniform(-0.3, 1.3, size=(12, 3))
+    for periodic in [(True, True, True), (True, False, True), (False, False, True)]:
+        pos, expected = _brute_force_pbc_rows(lat, periodic, frac, cfg)
+        pbc = v3d.TriclinicPBC(lat, periodic)
+        pbc.add_atoms([v3d.Vec3(*p) for p in pos])
+        T = v3d.plan_neighbors(pbc, cfg)
+        got = {(int(i), int(j), *map(int, img)) for i, j, img in zip(T.i, T.j, T.img)}
+        assert got == expected
+
+
+def test_neighbor_table_columns_are_views_and_round_trip():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    rs = np.random.default_rng(3)
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(40, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    E = T.size
+    assert T.i.dtype == np.int32 and T.i.shape == (E,)
+    assert T.img.dtype == np.int32 and T.img.shape == (E, 3)
+    assert T.disp.dtype == np.float64 and T.disp.shape == (E, 3)
+    # repeated accesses are distinct views of one buffer owned by the table, and are read-only
+    a, b = T.disp, T.disp
+    assert a is not b and np.shares_memory(a, b)
+    assert a.__array_interface__["data"][0] == b.__array_interface__["data"][0]
+    assert a.base is T and b.base is T
+    assert not T.i.flags.writeable and not a.flags.writeable
+    assert np.allclose((T.disp**2).sum(axis=1), T.r2)
+
+    U = v3d.NeighborTable.from_arrays(T.i, T.j, T.img, T.disp)
+    assert U.size == E
+    assert np.array_equal(U.offsets, T.offsets)
+    assert np.allclose(U.r2, T.r2)
+    M = np.full(E, 0.5)
+    a = v3d.tessellate_pairs(box, T, M, cfg)
+    b = v3d.tessellate_pairs(box, U, M, cfg)
+    assert np.allclose([c["volume"] for c in a], [c["volume"] for c in b])
+
+
+def test_reverse_rows_column_and_native_symmetrize():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    lat = v3d.Lattice(3.0, 3.0, 3.0, 90.0, 90.0, 90.0)
+    pbc = v3d.TriclinicPBC(lat, (True, True, True))
+    rs = np.random.default_rng(9)
+    pbc.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 3.0, size=(80, 3))])
+    T = v3d.plan_neighbors(pbc, cfg)
+    rev = T.rev
+    assert rev.dtype == np.int64 and rev.shape == (T.size,)
+    assert np.all(rev >= 0)
+    assert np.array_equal(T.i[rev], T.j) and np.array_equal(T.j[rev], T.i)
+    assert np.array_equal(T.img[rev], -T.img)
+    M = rs.uniform(0.2, 0.8, size=T.size)
+    S = v3d.symmetrize_M(T, M)
+    lo = np.arange(T.size) < rev
+    assert np.array_equal(S[rev[lo]], 1.0 - S[lo])
+    assert np.array_equal(S[lo], 0.5 * (M[lo] + (1.0 - M[rev[lo]])))
+    D = v3d.symmetrize_M({"i": T.i, "j": T.j, "img": T.img}, M)
+    assert np.array_equal(S, D)
+    # reference: the Python loop symmetrize_M replaced, which wrote 1 - (1 - m) to the lower row
+    ref = M.copy()
+    keys = {(int(a), int(b), *map(int, m)): r for r, (a, b, m) in enumerate(zip(T.i, T.j, T.img))}
+    for r, (a, b, m) in enumerate(zip(T.i, T.j, T.img)):
+        q = keys.get((int(b), int(a), *(-int(x) for x in m)))
+        if q is not None:
+            x = 0.5 * (ref[r] + (1.0 - ref[q]))
+            ref[r], ref[q] = x, 1.0 - x
+    assert np.allclose(S, ref, rtol=0, atol=1e-15)
+
+
+def test_half_table_stores_each_pair_once_and_tessellates_alike():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    lat = v3d.Lattice(3.0, 3.0, 3.0, 90.0, 90.0, 90.0)
+    pbc = v3d.TriclinicPBC(lat, (True, True, True))
+    g = (np.arange(3) + 0.5)
+    base = np.array(np.meshgrid(g, g, g, indexing="ij")).reshape(3, -1).T
+    rs = np.random.default_rng(4)
+    pbc.add_atoms([v3d.Vec3(*p) for p in base + rs.uniform(-0.15, 0.15, size=base.shape)])
+    T = v3d.plan_neighbors(pbc, cfg)
+    H = v3d.plan_neighbors(pbc, cfg, half=True)
+    assert isinstance(H, v3d.HalfNeighborTable) and not hasattr(H, "rev")
+    assert 2 * H.size == T.size
+    assert np.all(H.i < H.j)
+    # the stored orientation takes M, the implicit reverse 1 - M
+    Mh = rs.uniform(0.45, 0.55, size=H.size)
+    key = {(a, b, *m): x for a, b, m, x in zip(H.i, H.j, H.img.tolist(), Mh)}
+    M = np.array([key[(a, b, *m)] if (a, b, *m) in key else 1.0 - key[(b, a, *(-np.asarray(m)).tolist())]
+                  for a, b, m in zip(T.i, T.j, T.img.tolist())])
+    a = v3d.tessellate_pairs(pbc, T, M, cfg)
+    b = v3d.tessellate_pairs(pbc, H, Mh, cfg)
+    assert np.allclose(b.volume, a.volume, rtol=1e-10, atol=0)
+
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(3,3,3)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 3.0, size=(60, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    H = v3d.plan_neighbors(box, cfg, half=True)
+    assert H.size < T.size
+    G = v3d.tessellate_pairs_global_mesh(box, T, np.full(T.size, 0.5), cfg)
+    Gh = v3d.tessellate_pairs_global_mesh(box, H, np.full(H.size, 0.5), cfg)
+    assert len(Gh["faces"]["loops"]) == len(G["faces"]["loops"])
+    assert np.array_equal(Gh["faces"]["j"], G["faces"]["j"])
+    assert np.allclose(Gh["cells"]["volume"], G["cells"]["volume"])
+
+
+def test_half_table_matches_full_table_in_a_partially_periodic_cell():
+    # a slab: periodic in a and b, vacuum along c, so surface cells reach the far walls
+    cfg = v3d.Config()
+    cfg.min_M = 0.25
+    lat = v3d.Lattice(4.0, 4.0, 8.0, 80.0, 95.0, 105.0)
+    pbc = v3d.TriclinicPBC(lat, (True, True, False))
+    g = np.arange(4) + 0.5
+    base = np.array(np.meshgrid(g, g, g, indexing="ij")).reshape(3, -1).T / np.array([4.0, 4.0, 8.0]) + [0, 0, 0.25]
+    rs = np.random.default_rng(8)
+    frac = base + rs.uniform(-0.03, 0.03, size=base.shape)
+    pbc.add_atoms([lat.to_cart(v3d.Vec3(*f)) for f in frac])
+    T = v3d.plan_neighbors(pbc, cfg)
+    H = v3d.plan_neighbors(pbc, cfg, half=True)
+    a = v3d.tessellate_pairs(pbc, T, np.full(T.size, 0.5), cfg)
+    b = v3d.tessellate_pairs(pbc, H, np.full(H.size, 0.5), cfg)
+    assert np.allclose(b.volume, a.volume, rtol=1e-10, atol=1e-12)
+
+
+def test_float32_table_and_result_track_double_path():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    rs = np.random.default_rng(5)
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(3,3,3)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 3.0, size=(120, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    Tf = v3d.plan_neighbors(box, cfg, dtype=np.float32)
+    assert isinstance(Tf, v3d.NeighborTableF32)
+    assert Tf.disp.dtype == np.float32 and Tf.r2.dtype == np.float32
+    assert np.array_equal(Tf.i, T.i) and np.array_equal(Tf.j, T.j)
+    assert Tf.disp.nbytes * 2 == T.disp.nbytes
+    M = np.full(T.size, 0.5)
+    R = v3d.tessellate_pairs(box, T, M, cfg)
+    Rf = v3d.tessellate_pairs(box, Tf, M, cfg)
+    assert isinstance(Rf, v3d.TessellationResultF32)
+    assert Rf.vertices.dtype == np.float32 and Rf.volume.dtype == np.float32
+    assert np.array_equal(Rf.atom_id, R.atom_id)
+    # single-precision storage, double-precision clipping: volumes agree to float rounding
+    assert np.allclose(Rf.volume, R.volume, rtol=1e-5, atol=0)
+    assert abs(float(Rf.volume.astype(np.float64).sum()) - 27.0) < 1e-4
+
+def test_neighbor_planner_refreshes_within_skin_and_rebuilds_beyond():
+    rs = np.random.default_rng(2)
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    cfg.neighbor_skin = 0.3
+    lat = v3d.Lattice(3.0, 3.0, 3.0, 90.0, 90.0, 90.0)
+    base = np.array([(x, y, z) for x in range(6) for y in range(6) for z in range(6)], dtype=float) * 0.5
+    base += rs.normal(0.0, 0.02, size=base.shape)
+
+    def frame(xyz):
+        pbc = v3d.TriclinicPBC(lat, (True, True, True))
+        pbc.add_atoms([v3d.Vec3(*p) for p in np.mod(xyz, 3.0)])
+        return pbc
+
+    planner = v3d.NeighborPlanner(cfg)
+    T0 = planner.update(frame(base))
+    assert planner.last_rebuilt and planner.rebuilds == 1
+    moved = base + rs.normal(0.0, 0.01, size=base.shape)
+    T1 = planner.update(frame(moved))
+    assert not planner.last_rebuilt and planner.refreshes == 1
+    assert T1 is T0  # refreshed in place
+    assert planner.max_displacement < cfg.neighbor_skin / 2
+    fresh = v3d.plan_neighbors(frame(moved), cfg)
+    # same pairs within the fresh search radius, with up-to-date geometry
+    ours = {(a, b, tuple(m)): r for a, b, m, r in zip(T1.i, T1.j, T1.img, T1.r2)}
+    for a, b, m, r in zip(fresh.i, fresh.j, fresh.img, fresh.r2):
+        assert np.isclose(ours[(a, b, tuple(m))], r)
+    planner.update(frame(base + 0.4))  # uniform shift: displacement beyond skin/2
+    assert planner.last_rebuilt and planner.rebuilds == 2
+
+def test_neighbor_planner_box_refresh_matches_fresh_cells_and_replans_beyond_skin():
+    rs = np.random.default_rng(2)
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    cfg.neighbor_skin = 0.5
+    base = np.array([(x, y, z) for x in range(6) for y in range(6) for z in range(6)], dtype=float) * 0.5 + 0.25
+    base += rs.normal(0.0, 0.02, size=base.shape)
+
+    def frame(xyz):
+        box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0, 0, 0), v3d.Vec3(3, 3, 3)))
+        box.add_atoms([v3d.Vec3(*p) for p in np.clip(xyz, 0.0, 3.0)])
+        return box
+
+    planner = v3d.NeighborPlanner(cfg)
+    T0 = planner.update(frame(base))
+    assert planner.last_rebuilt and planner.rebuilds == 1
+    moved = base + rs.normal(0.0, 0.01, size=base.shape)
+    box = frame(moved)
+    T1 = planner.update(box)
+    assert not planner.last_rebuilt and planner.refreshes == 1
+    assert T1 is T0  # refreshed in place
+    pos = np.clip(moved, 0.0, 3.0)
+    i, j = np.asarray(T1.i), np.asarray(T1.j)
+    assert np.allclose(np.asarray(T1.disp), pos[j] - pos[i], rtol=0, atol=1e-12)
+    assert np.allclose(np.asarray(T1.r2), ((pos[j] - pos[i]) ** 2).sum(axis=1), rtol=0, atol=1e-12)
+    # per-atom search radii differ from a fresh plan's, but the cells must not
+    fresh = v3d.plan_neighbors(box, cfg)
+    ours = v3d.tessellate_pairs(box, T1, np.full(T1.size, 0.5), cfg)
+    ref = v3d.tessellate_pairs(box, fresh, np.full(fresh.size, 0.5), cfg)
+    assert np.allclose(ours.volume, ref.volume, rtol=0, atol=1e-12)
+    planner.update(frame(base + 0.3))  # uniform shift: displacement beyond skin/2
+    assert planner.last_rebuilt and planner.rebuilds == 2 and planner.refreshes == 1
@@ -1,4 +1,5 @@
 import numpy as np
+import pytest
 import voronoi3d as v3d
 
 def test_two_atoms_half_box_volume():
@@ -16,3 +17,252 @@ def test_two_atoms_half_box_volume():
     assert np.allclose(vols[0] + vols[1], 1.0, atol=1e-6)
     assert np.isclose(vols[0], 0.5, atol=2e-2)
     assert np.isclose(vols[1], 0.5, atol=2e-2)
+
+def test_random_box_cells_partition_the_box():
+    cfg = v3d.Config()
+    cfg.min_M = 0.45
+    rs = np.random.default_rng(11)
+    pts = rs.uniform(0.0, 2.0, size=(80, 3))
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in pts])
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5, dtype=float)
+    cells = v3d.tessellate_pairs(box, T, M, cfg)
+    vols = np.array([c["volume"] for c in cells])
+    assert (vols > 0).all()
+    assert np.isclose(vols.sum(), 8.0, atol=1e-8)
+    # every face loop references valid vertices of its own cell
+    for c in cells:
+        nv = c["vertices"].shape[0]
+        assert all(0 <= v < nv for loop in c["faces"] for v in loop)
+
+def test_rows_nearest_first_and_security_radius_skips():
+    cfg = v3d.Config()
+    cfg.min_M = 0.3
+    n = 6
+    pbc = v3d.TriclinicPBC(v3d.Lattice(n, n, n, 90, 90, 90), [True, True, True])
+    g = np.arange(n) + 0.5
+    pts = np.stack(np.meshgrid(g, g, g, indexing="ij"), axis=-1).reshape(-1, 3)
+    pbc.add_atoms([v3d.Vec3(*p) for p in pts])
+    T = v3d.plan_neighbors(pbc, cfg)
+    i = np.asarray(T.i); r2 = np.asarray(T.r2)
+    for a in range(len(pts)):
+        assert (np.diff(r2[i == a]) >= 0).all()
+    cells = v3d.tessellate_pairs(pbc, T, np.full(len(T.i), 0.5), cfg)
+    assert np.allclose([c["volume"] for c in cells], 1.0, atol=1e-9)
+    for a, c in enumerate(cells):
+        assert c["rows_used"] + c["rows_skipped"] == int((i == a).sum())
+        assert c["rows_skipped"] > 0
+
+def test_rows_without_a_plane_count_as_skipped():
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    rs = np.random.default_rng(5)
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(40, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    # a zero-length row (atom 0 against itself) yields no plane
+    U = v3d.NeighborTable.from_arrays(
+        np.concatenate([[0], T.i]).astype(np.int32), np.concatenate([[0], T.j]).astype(np.int32),
+        np.concatenate([np.zeros((1, 3)), T.img]).astype(np.int32), np.concatenate([np.zeros((1, 3)), T.disp]))
+    ref = v3d.tessellate_pairs(box, T, np.full(T.size, 0.5), cfg)
+    R = v3d.tessellate_pairs(box, U, np.full(U.size, 0.5), cfg)
+    assert np.array_equal(R.volume, ref.volume)
+    counts = np.bincount(np.asarray(U.i), minlength=40)
+    assert np.array_equal(R.rows_used + R.rows_skipped, counts)
+    assert R.rows_used[0] == ref.rows_used[0] and R.rows_skipped[0] == ref.rows_skipped[0] + 1
+
+def test_flat_result_columns_match_per_cell_view():
+    cfg = v3d.Config()
+    cfg.min_M = 0.45
+    rs = np.random.default_rng(4)
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(30, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    R = v3d.tessellate_pairs(box, T, np.full(T.size, 0.5), cfg)
+    assert len(R) == R.num_cells == 30
+    cvo, cfo, fo = R.cell_vertex_offsets, R.cell_face_offsets, R.face_offsets
+    assert cvo[-1] == R.vertices.shape[0] and cfo[-1] == R.num_faces and fo[-1] == R.face_vertex_indices.shape[0]
+    assert np.isclose(R.volume.sum(), 8.0)
+    assert R.face_normal.shape == (R.num_faces, 3) and np.allclose(np.linalg.norm(R.face_normal, axis=1), 1.0)
+    # face tags are neighbor rows or box walls (-1000..-1005)
+    tags = R.face_tag
+    assert ((tags >= 0) & (tags < T.size) | (tags <= -1000) & (tags >= -1005)).all()
+    c = R[7]
+    assert c["atom_id"] == 7 and np.isclose(c["volume"], R.volume[7])
+    assert np.array_equal(c["vertices"], R.vertices[cvo[7]:cvo[8]])
+    assert len(c["faces"]) == cfo[8] - cfo[7]
+
+def test_stream_chunks_cover_all_atoms_and_match_full_result():
+    rs = np.random.default_rng(7)
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(50, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5)
+    full = v3d.tessellate_pairs(box, T, M, cfg)
+    stream = v3d.tessellate_pairs_stream(box, T, M, cfg, chunk_size=16)
+    assert len(stream) == 4
+    assert sorted(stream.order) == list(range(50))
+    seen = []
+    for batch in stream:
+        assert batch.num_cells <= 16
+        seen.extend(batch.atom_id)
+        assert np.array_equal(batch.volume, full.volume[batch.atom_id])
+    assert seen == list(stream.order)
+
+def test_incremental_update_rebuilds_only_affected_cells():
+    rs = np.random.default_rng(12)
+    cfg = v3d.Config()
+    cfg.min_M = 0.3
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(40, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    M = np.full(len(T.i), 0.5)
+    inc = v3d.IncrementalTessellation(box, T, M, cfg)
+    rev = np.asarray(inc.reverse_rows)
+    r = int(np.nonzero(rev >= 0)[0][0])
+    changed = inc.update(np.array([r]), np.array([0.42]))
+    assert sorted(changed.atom_id) == sorted({int(T.i[r]), int(T.j[r])})
+    assert inc.cells_rebuilt == 2
+    M[r], M[rev[r]] = 0.42, 0.58
+    assert np.array_equal(inc.M, M)
+    ref = v3d.tessellate_pairs(box, T, M, cfg)
+    assert np.allclose(inc.volume, ref.volume, rtol=0, atol=1e-12)
+    assert np.isclose(inc.volume.sum(), 8.0)
+
+def test_incremental_update_that_fails_leaves_the_state_unchanged():
+    rs = np.random.default_rng(12)
+    cfg = v3d.Config()
+    cfg.min_M = 0.3
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(40, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    inc = v3d.IncrementalTessellation(box, T, np.full(len(T.i), 0.5), cfg)
+    M0, V0 = np.array(inc.M), np.array(inc.volume)
+    # the first row is valid: it must not be applied when a later one fails
+    with pytest.raises(IndexError):
+        inc.update(np.array([0, len(T.i)]), np.array([0.42, 0.42]))
+    with pytest.raises(ValueError):
+        inc.update(np.array([0, 1]), np.array([0.42, np.nan]))
+    assert np.array_equal(inc.M, M0)
+    assert np.array_equal(inc.volume, V0)
+    assert inc.cells_rebuilt == 0
+
+def test_tessellate_frames_matches_per_frame_runs():
+    rs = np.random.default_rng(5)
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    bounds = v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2))
+    xyz = np.clip(rs.uniform(0.0, 2.0, size=(1, 30, 3)) + rs.normal(0.0, 0.02, size=(3, 30, 3)), 0.0, 2.0)
+    B = v3d.tessellate_frames(bounds, xyz, cfg, keep_cells=True)
+    assert B.volume.shape == (3, 30) and B.num_faces.shape == (3, 30)
+    assert len(B) == 3
+    for f in range(3):
+        box = v3d.BoxContainer(bounds)
+        box.add_atoms([v3d.Vec3(*p) for p in xyz[f]])
+        T = v3d.plan_neighbors(box, cfg)
+        ref = v3d.tessellate_pairs(box, T, np.full(len(T.i), 0.5), cfg)
+        assert np.array_equal(B.volume[f][ref.atom_id], ref.volume)
+        assert np.array_equal(B[f].volume, ref.volume)
+        assert np.isclose(B.volume[f].sum(), 8.0)
+    assert np.all(B.surface_area > 0)
+
+def test_last_profile_reports_phases_of_the_last_call():
+    cfg = v3d.Config()
+    cfg.min_M = 0.45
+    rs = np.random.default_rng(5)
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in rs.uniform(0.0, 2.0, size=(60, 3))])
+    T = v3d.plan_neighbors(box, cfg)
+    if not v3d.profiling_enabled:
+        assert v3d.last_profile() is None
+        return
+    plan = v3d.last_profile()
+    assert plan.seconds["plan_neighbors"] > 0 and plan.counts["cells"] == 0
+    assert plan.counts["bytes_allocated"] >= len(T.i) * 8
+    R = v3d.tessellate_pairs(box, T, np.full(len(T.i), 0.5), cfg)
+    S = v3d.last_profile()
+    assert S.seconds["plan_neighbors"] == 0 and S.seconds["python_conversion"] > 0
+    assert S.counts["cells"] == R.num_cells
+    if S.counts["fallback_cells"] == 0:  # fallback cells count their seed planes too
+        assert S.counts["cell_planes"] == int(np.sum(R.rows_used))
+        assert np.isclose(S.planes_per_cell, np.mean(R.rows_used))
+    assert S.seconds["clip"] > 0 and S.wall > 0
+
+def test_plane_kernels_match_the_scalar_formula():
+    # the SIMD kernels (VORONOI3D_NATIVE builds) must agree with the scalar expression exactly,
+    # including the padded tail block
+    from voronoi3d import _core
+    rs = np.random.default_rng(19)
+    for n in range(0, 3 * _core.plane_kernel_lanes + 2):
+        nrm = rs.normal(size=3)
+        plane = np.append(nrm / np.linalg.norm(nrm), rs.normal())
+        V = rs.normal(size=(n, 3))
+        ref = (plane[0] * V[:, 0] + plane[1] * V[:, 1]) + plane[2] * V[:, 2] - plane[3]
+        assert np.array_equal(_core._signed_distances(plane, V), ref)
+        P = rs.normal(size=(n, 4))
+        P[:, :3] /= np.linalg.norm(P[:, :3], axis=1)[:, None]
+        P[:, 3] += 2.0
+        x = rs.normal(size=3)
+        above = ((P[:, 0] * x[0] + P[:, 1] * x[1]) + P[:, 2] * x[2] - P[:, 3] > 1e-9).any()
+        assert _core._any_plane_above(P, x, 1e-9) == above
+
+def _cell_planes(pos, i, L):
+    # box walls (in the order of the box wall tags -1000..-1005), then the bisector to every atom
+    rows = []
+    for k in range(3):
+        lo, hi = np.zeros(3), np.zeros(3)
+        lo[k], hi[k] = -1.0, 1.0
+        rows += [np.append(lo, 0.0), np.append(hi, L)]
+    others = [j for j in range(len(pos)) if j != i]
+    for j in others:
+        n = (pos[j] - pos[i]) / np.linalg.norm(pos[j] - pos[i])
+        rows.append(np.append(n, n @ (0.5 * (pos[i] + pos[j]))))
+    return np.array(rows), others
+
+def test_halfspace_intersection_matches_clipped_cells():
+    from voronoi3d import _core
+    rs = np.random.default_rng(4)
+    cfg = v3d.Config()
+    cfg.min_M = 0.4
+    pos = rs.uniform(0.0, 2.0, size=(60, 3))
+    box = v3d.BoxContainer(v3d.BoxBounds(v3d.Vec3(0,0,0), v3d.Vec3(2,2,2)))
+    box.add_atoms([v3d.Vec3(*p) for p in pos])
+    T = v3d.plan_neighbors(box, cfg)
+    R = v3d.tessellate_pairs(box, T, np.full(len(T.i), 0.5), cfg)
+    j = np.array(T.j)
+    for c in range(R.num_cells):
+        i = R[c]["atom_id"]
+        planes, others = _cell_planes(pos, i, 2.0)
+        H = _core._halfspace_intersection(planes, cfg)
+        assert np.isclose(H["volume"], R.volume[c], rtol=1e-12, atol=1e-12)
+        # same vertices and the same neighbors behind the faces
+        Vc = R[c]["vertices"]
+        assert len(H["vertices"]) == len(Vc)
+        d = np.linalg.norm(H["vertices"][:, None, :] - Vc[None, :, :], axis=2)
+        assert d.min(axis=1).max() < 1e-9
+        tags = R.face_tag[R.cell_face_offsets[c]:R.cell_face_offsets[c+1]]
+        clipped = {int(j[t]) if t >= 0 else int(t) for t in tags}
+        assert {others[k - 6] if k >= 6 else -1000 - k for k in H["face_tag"]} == clipped
+        assert all(len(f) >= 3 for f in H["faces"])
+
+def test_halfspace_intersection_on_degenerate_inputs():
+    from voronoi3d import _core
+    cfg = v3d.Config()
+    # simple cubic: every vertex of the central cube lies on four or more planes (the diagonal
+    # bisectors only touch it), which must not leave extra vertices or sliver faces
+    g = np.arange(3) + 0.5
+    pos = np.array(np.meshgrid(g, g, g, indexing="ij")).reshape(3, -1).T
+    planes, others = _cell_planes(pos, 13, 3.0)
+    H = _core._halfspace_intersection(planes, cfg)
+    assert len(H["vertices"]) == 8 and np.isclose(H["volume"], 1.0, rtol=1e-12)
+    assert [len(f) for f in H["faces"]] == [4] * 6
+    assert sorted(others[k - 6] for k in H["face_tag"]) == [4, 10, 12, 14, 16, 22]
+    # coincident planes: each face of the unit cube given twice, plus a plane that cuts nothing
+    cube = np.array([[-1,0,0,0], [1,0,0,1], [0,-1,0,0], [0,1,0,1], [0,0,-1,0], [0,0,1,1]], dtype=float)
+    H = _core._halfspace_intersection(np.vstack([cube, cube, [[1, 0, 0, 5.0]]]), cfg)
+    assert len(H["vertices"]) == 8 and np.isclose(H["volume"], 1.0, rtol=1e-12)
+    assert [len(f) for f in H["faces"]] == [4] * 6
+    assert sorted(k % 6 for k in H["face_tag"]) == list(range(6))
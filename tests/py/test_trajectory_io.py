@@ -0,0 +1,92 @@
+import numpy as np
+import voronoi3d as v3d
+
+def test_trajectory_reader_extxyz_and_lammps_text_agree(tmp_path):
+    rs = np.random.default_rng(2)
+    grid = (np.stack(np.meshgrid(*[np.arange(3)] * 3, indexing="ij"), -1).reshape(-1, 3) + 0.5) / 3
+    frac = grid + rs.uniform(-0.05, 0.05, size=(2, 27, 3))
+    H = np.array([[4.0, 0.0, 0.0], [0.5, 3.5, 0.0], [-0.3, 0.4, 3.0]])   # rows a, b, c
+    xyz = tmp_path / "t.xyz"
+    with open(xyz, "w") as f:
+        for k in range(2):
+            f.write(f"27\nLattice=\"{' '.join(map(str, H.ravel()))}\" Properties=species:S:1:pos:R:3 pbc=\"T T T\"\n")
+            for p in frac[k] @ H:
+                f.write("Ar %.17g %.17g %.17g\n" % tuple(p))
+    dump = tmp_path / "t.dump"
+    xy, xz, yz = H[1, 0], H[2, 0], H[2, 1]
+    with open(dump, "w") as f:
+        for k in range(2):
+            f.write(f"ITEM: TIMESTEP\n{10*k}\nITEM: NUMBER OF ATOMS\n27\nITEM: BOX BOUNDS xy xz yz pp pp pp\n")
+            f.write(f"{min(0, xy, xz, xy+xz)} {4.0 + max(0, xy, xz, xy+xz)} {xy}\n{min(0, yz)} {3.5 + max(0, yz)} {xz}\n0 3.0 {yz}\n")
+            f.write("ITEM: ATOMS id type xs ys zs\n")
+            for i in reversed(range(27)):
+                f.write("%d 1 %.17g %.17g %.17g\n" % (i + 1, *frac[k, i]))
+    rx, rl = v3d.TrajectoryReader(str(xyz)), v3d.TrajectoryReader(str(dump))
+    assert rx.format == v3d.TrajectoryFormat.ExtXYZ and rl.format == v3d.TrajectoryFormat.LammpsText
+    assert len(rx) == len(rl) == 2 and rl.num_atoms(1) == 27
+    fx, fl = rx[-1], rl[1]
+    assert fl.timestep == 10
+    assert np.allclose(fx.positions, frac[1] @ H, atol=1e-12)
+    assert np.allclose(fl.positions, fx.positions, atol=1e-12)
+    assert np.allclose(fl.cell, H)
+    cfg = v3d.Config()
+    for r in (rx, rl):
+        pbc = r.pbc(0)
+        T = v3d.plan_neighbors(pbc, cfg)
+        res = v3d.tessellate_pairs(pbc, T, np.full(len(T.i), 0.5), cfg)
+        assert np.isclose(res.volume.sum(), abs(np.linalg.det(H)), rtol=1e-9)
+
+def _lammps_binary_frame(step, lo, hi, tilt, boundary, columns, rows, chunks, revised=True):
+    # one frame of a LAMMPS binary dump (little-endian); `rows` (natoms x size_one) split in `chunks`
+    import struct
+    out = b""
+    if revised:
+        magic = b"DUMPATOM"
+        out += struct.pack("<q", -len(magic)) + magic + struct.pack("<ii", 1, 2)
+    out += struct.pack("<qqi", step, len(rows), int(tilt is not None))
+    out += struct.pack("<6i", *boundary)
+    out += struct.pack("<6d", lo[0], hi[0], lo[1], hi[1], lo[2], hi[2])
+    if tilt is not None:
+        out += struct.pack("<3d", *tilt)
+    out += struct.pack("<i", rows.shape[1])
+    if revised:
+        unit = b"metal"
+        out += struct.pack("<i", len(unit)) + unit + struct.pack("<b", 0)
+        out += struct.pack("<i", len(columns)) + columns.encode()
+    parts = np.array_split(rows, chunks)
+    out += struct.pack("<i", len(parts))
+    for part in parts:
+        out += struct.pack("<i", part.size) + np.ascontiguousarray(part, dtype="<f8").tobytes()
+    return out
+
+def test_trajectory_reader_lammps_binary(tmp_path):
+    rs = np.random.default_rng(8)
+    H = np.array([[4.0, 0.0, 0.0], [0.5, 3.5, 0.0], [-0.3, 0.4, 3.0]])   # rows a, b, c
+    xy, xz, yz = H[1, 0], H[2, 0], H[2, 1]
+    lo = np.array([1.0 + min(0, xy, xz, xy + xz), -2.0 + min(0, yz), 0.5])
+    hi = np.array([5.0 + max(0, xy, xz, xy + xz), 1.5 + max(0, yz), 3.5])
+    origin = np.array([1.0, -2.0, 0.5])
+    frac = rs.uniform(0.0, 1.0, size=(2, 20, 3))
+    ids = rs.permutation(20) + 1
+    cart = origin + frac[0] @ H
+    # revised header, unscaled x y z with an extra column, ids shuffled, three chunks
+    rows0 = np.column_stack([ids, np.ones(20), cart[ids - 1], np.zeros(20)])
+    # pre-revision header: the default columns id type xs ys zs, orthogonal, z not periodic
+    L = np.array([3.0, 2.5, 4.0])
+    rows1 = np.column_stack([np.arange(1, 21), np.ones(20), frac[1]])
+    path = tmp_path / "t.bin"
+    with open(path, "wb") as f:
+        f.write(_lammps_binary_frame(100, lo, hi, (xy, xz, yz), (0, 0, 0, 0, 0, 0), "id type x y z q", rows0, 3))
+        f.write(_lammps_binary_frame(200, (0, 0, 0), L, None, (0, 0, 0, 0, 1, 1), "", rows1, 1, revised=False))
+    r = v3d.TrajectoryReader(str(path))
+    assert r.format == v3d.TrajectoryFormat.LammpsBinary
+    assert len(r) == 2 and r.num_atoms(0) == 20
+    f0, f1 = r[0], r[1]
+    assert f0.timestep == 100 and f1.timestep == 200
+    assert np.allclose(f0.cell, H, atol=1e-12)
+    assert np.allclose([f0.origin.x, f0.origin.y, f0.origin.z], origin, atol=1e-12)
+    assert tuple(f0.periodic) == (True, True, True)
+    assert np.array_equal(f0.positions, cart)
+    assert np.allclose(f1.cell, np.diag(L))
+    assert tuple(f1.periodic) == (True, True, False)
+    assert np.allclose(f1.positions, frac[1] * L, atol=1e-12)